@@ -0,0 +1,242 @@
+#include "AdmissionController.h"
+#include "mx_logger.h"
+#include "HostStats.h"
+#include "PipelineHandler.h"
+#include <Poco/Environment.h>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <algorithm>
+
+AdmissionController::AdmissionController()
+{
+    m_iCores = std::max(1u, static_cast<unsigned>(Poco::Environment::processorCount()));
+
+    // Prime the CPU counters so the first decision has a baseline
+    HostStats::readCpuTimes(m_lastIdle, m_lastTotal);
+    m_lastSample = std::chrono::steady_clock::now();
+}
+
+void AdmissionController::setConfig(const AdmissionConfig& config)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_config = config;
+}
+
+AdmissionConfig AdmissionController::getConfig() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_config;
+}
+
+///////////////////////////////////////////////    Cost model   //////////////////////////////////////////
+
+PipelineCost AdmissionController::estimateCost(const MediaStreamDevice& device) const
+{
+    AdmissionConfig config;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        config = m_config;
+    }
+
+    PipelineCost cost;
+    const MediaData& input  = device.stinputMediaData;
+    const MediaData& output = device.stoutputMediaData;
+
+    // Scale by pixel rate relative to 1080p25, unknown resolution counts as 1080p25
+    float pixelScale = 1.0f;
+    if (input.stResolution.width > 0 && input.stResolution.height > 0)
+    {
+        pixelScale = (input.stResolution.width * input.stResolution.height) / (1920.0f * 1080.0f);
+    }
+    if (input.stResolution.frameRate > 0.0f)
+    {
+        pixelScale *= input.stResolution.frameRate / 25.0f;
+    }
+
+    float cores = config.fPassthroughCores;
+    float memMB = config.fPassthroughMemMB;
+
+    // The display path, transcodes and ladders decode; other file and network outputs stay compressed
+    const bool bTranscode = PipelineHandler::isTranscode(device);
+    const bool bLadder = PipelineHandler::isLadder(device);
+    if (output.esourceType == eSourceType::SOURCE_TYPE_DISPLAY || bTranscode || bLadder)
+    {
+        cost.bDecodes = true;
+        const float decodeCores = (input.stMediaCodec.evideocodec == eVideoCodec::VIDEO_CODEC_H265) ? config.fDecodeCoresH265 : config.fDecodeCoresH264;
+        cores = decodeCores * pixelScale;
+        memMB = config.fDecodeMemMB * std::max(pixelScale, 0.25f);
+
+        // The encoder weighs against the decode as in the thread budget
+        if (bTranscode)
+        {
+            cores *= PipelineHandler::encodeLoadFactor(device);
+        }
+
+        // One encoder per rendition, by its own pixel rate rather than the source's
+        if (bLadder)
+        {
+            cores += decodeCores * PipelineHandler::ladderEncodeLoad(device);
+        }
+    }
+
+    cost.fCpuPercent = cores * 100.0f / m_iCores;
+    cost.fMemMB = memMB;
+    return cost;
+}
+
+///////////////////////////////////////////////    Decision   //////////////////////////////////////////
+
+eAdmissionDecision AdmissionController::admit(size_t pipelineId, const MediaStreamDevice& device, std::string& reason)
+{
+    PipelineCost cost = estimateCost(device);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto now = std::chrono::steady_clock::now();
+
+    if (!m_config.bEnabled)
+    {
+        m_reservations[pipelineId] = {cost, now};
+        ++m_iAdmitted;
+        return eAdmissionDecision::ADMISSION_ADMIT;
+    }
+
+    if (m_config.iMaxPipelines > 0 && m_reservations.size() >= m_config.iMaxPipelines)
+    {
+        ++m_iRejected;
+        reason = "pipeline limit reached (" + std::to_string(m_config.iMaxPipelines) + ")";
+        return eAdmissionDecision::ADMISSION_REJECT;
+    }
+
+    // Without /proc the measured load is unknown, fall back to the sum of estimates
+    unsigned long long idle = 0, total = 0;
+    float load = 0.0f;
+    if (HostStats::readCpuTimes(idle, total))
+    {
+        load = sampleCpuPercent() + settlingCpuPercent();
+    }
+    else
+    {
+        load = committedCpuPercent();
+    }
+
+    float memUsedPercent = 0.0f;
+    float memCostPercent = 0.0f;
+    unsigned long memTotalKB = 0, memAvailableKB = 0;
+    if (HostStats::readMemInfo(memTotalKB, memAvailableKB) && memTotalKB > 0)
+    {
+        memUsedPercent = 100.0f * (memTotalKB - memAvailableKB) / memTotalKB;
+        memCostPercent = 100.0f * (cost.fMemMB * 1024.0f) / memTotalKB;
+    }
+
+    const float cpuBudget = 100.0f - m_config.fCpuHeadroomPercent;
+    const float memBudget = 100.0f - m_config.fMemHeadroomPercent;
+    const bool  bMemFits  = memUsedPercent + memCostPercent <= memBudget;
+
+    if (bMemFits && load + cost.fCpuPercent <= cpuBudget)
+    {
+        m_reservations[pipelineId] = {cost, now};
+        ++m_iAdmitted;
+        return eAdmissionDecision::ADMISSION_ADMIT;
+    }
+
+    if (bMemFits && cost.bDecodes && load + cost.fCpuPercent * m_config.fDowngradeFactor <= cpuBudget)
+    {
+        cost.fCpuPercent *= m_config.fDowngradeFactor;
+        m_reservations[pipelineId] = {cost, now};
+        ++m_iDowngraded;
+        reason = "CPU at " + std::to_string(static_cast<int>(load)) + "%, admitted with reduced decode";
+        return eAdmissionDecision::ADMISSION_DOWNGRADE;
+    }
+
+    ++m_iDeferred;
+    std::ostringstream oss;
+    oss << "host saturated: cpu " << static_cast<int>(load) << "% + " << cost.fCpuPercent << "% (budget " << cpuBudget
+        << "%), mem " << static_cast<int>(memUsedPercent) << "% (budget " << memBudget << "%)";
+    reason = oss.str();
+    return eAdmissionDecision::ADMISSION_DEFER;
+}
+
+void AdmissionController::release(size_t pipelineId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_reservations.erase(pipelineId);
+}
+
+AdmissionSnapshot AdmissionController::getSnapshot()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    AdmissionSnapshot snapshot;
+    snapshot.fCpuPercent          = sampleCpuPercent();
+    snapshot.fCommittedCpuPercent = committedCpuPercent();
+    snapshot.fSettlingCpuPercent  = settlingCpuPercent();
+    snapshot.iPipelines           = m_reservations.size();
+    snapshot.iAdmitted            = m_iAdmitted;
+    snapshot.iDowngraded          = m_iDowngraded;
+    snapshot.iDeferred            = m_iDeferred;
+    snapshot.iRejected            = m_iRejected;
+
+    unsigned long memTotalKB = 0, memAvailableKB = 0;
+    if (HostStats::readMemInfo(memTotalKB, memAvailableKB) && memTotalKB > 0)
+    {
+        snapshot.fMemUsedPercent = 100.0f * (memTotalKB - memAvailableKB) / memTotalKB;
+    }
+    return snapshot;
+}
+
+///////////////////////////////////////////////    Host sampling   //////////////////////////////////////////
+
+float AdmissionController::sampleCpuPercent()
+{
+    // Back-to-back admissions reuse the last reading, a short delta is mostly noise
+    const auto now = std::chrono::steady_clock::now();
+    if (now - m_lastSample < std::chrono::milliseconds(500))
+    {
+        return m_fLastCpuPercent;
+    }
+
+    unsigned long long idle = 0, total = 0;
+    if (!HostStats::readCpuTimes(idle, total))
+    {
+        return m_fLastCpuPercent;
+    }
+
+    if (total > m_lastTotal)
+    {
+        const unsigned long long deltaTotal = total - m_lastTotal;
+        const unsigned long long deltaIdle  = idle - m_lastIdle;
+        m_fLastCpuPercent = 100.0f * (deltaTotal - std::min(deltaIdle, deltaTotal)) / deltaTotal;
+    }
+
+    m_lastIdle = idle;
+    m_lastTotal = total;
+    m_lastSample = now;
+    return m_fLastCpuPercent;
+}
+
+float AdmissionController::settlingCpuPercent() const
+{
+    const auto now = std::chrono::steady_clock::now();
+    const auto window = std::chrono::milliseconds(m_config.iSettleWindowMs);
+
+    float settling = 0.0f;
+    for (const auto& [id, reservation] : m_reservations)
+    {
+        if (now - reservation.admittedAt < window)
+        {
+            settling += reservation.cost.fCpuPercent;
+        }
+    }
+    return settling;
+}
+
+float AdmissionController::committedCpuPercent() const
+{
+    float committed = 0.0f;
+    for (const auto& [id, reservation] : m_reservations)
+    {
+        committed += reservation.cost.fCpuPercent;
+    }
+    return committed;
+}
@@ -0,0 +1,100 @@
+#ifndef ADMISSION_CONTROLLER_H
+#define ADMISSION_CONTROLLER_H
+
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include "Struct.h"
+
+// Tunables for pipeline admission. CPU figures are percent of the whole host
+// (all cores), memory figures are MB.
+struct AdmissionConfig
+{
+    bool   bEnabled{true};
+    float  fCpuHeadroomPercent{15.0f};      // keep this much CPU free after admitting
+    float  fMemHeadroomPercent{10.0f};      // keep this much RAM free after admitting
+    size_t iMaxPipelines{0};                // 0 = no hard limit
+
+    // Cost model, in cores for a 1080p25 stream
+    float  fDecodeCoresH264{0.25f};
+    float  fDecodeCoresH265{0.40f};
+    float  fPassthroughCores{0.02f};
+    float  fDowngradeFactor{0.5f};          // decode cost left after skipping non-reference frames
+    float  fDecodeMemMB{48.0f};
+    float  fPassthroughMemMB{8.0f};
+
+    // Deferral
+    int    iDeferRetryMs{2000};
+    int    iMaxDeferAttempts{5};
+    int    iSettleWindowMs{5000};           // new pipelines not yet visible in the CPU sample
+};
+
+// Cost estimate for a single pipeline
+struct PipelineCost
+{
+    float fCpuPercent{0.0f};
+    float fMemMB{0.0f};
+    bool  bDecodes{false};
+};
+
+// Host view used for the last decision
+struct AdmissionSnapshot
+{
+    float  fCpuPercent{0.0f};
+    float  fMemUsedPercent{0.0f};
+    float  fCommittedCpuPercent{0.0f};      // estimated cost of all admitted pipelines
+    float  fSettlingCpuPercent{0.0f};       // admitted recently, not yet reflected in fCpuPercent
+    size_t iPipelines{0};
+    size_t iAdmitted{0};
+    size_t iDowngraded{0};
+    size_t iDeferred{0};
+    size_t iRejected{0};
+};
+
+class AdmissionController
+{
+public:
+    AdmissionController();
+
+    void setConfig(const AdmissionConfig& config);
+    AdmissionConfig getConfig() const;
+
+    // Decide whether a new pipeline fits; ADMIT and DOWNGRADE reserve its cost
+    eAdmissionDecision admit(size_t pipelineId, const MediaStreamDevice& device, std::string& reason);
+
+    // Return a pipeline's reserved cost once it is stopped or terminated
+    void release(size_t pipelineId);
+
+    PipelineCost estimateCost(const MediaStreamDevice& device) const;
+    AdmissionSnapshot getSnapshot();
+
+private:
+    struct Reservation
+    {
+        PipelineCost cost;
+        std::chrono::steady_clock::time_point admittedAt;
+    };
+
+    float sampleCpuPercent();
+    float settlingCpuPercent() const;
+    float committedCpuPercent() const;
+
+    mutable std::mutex  m_mutex;
+    AdmissionConfig     m_config;
+    unsigned            m_iCores{1};
+
+    std::unordered_map<size_t, Reservation> m_reservations;
+
+    unsigned long long  m_lastIdle{0};
+    unsigned long long  m_lastTotal{0};
+    float               m_fLastCpuPercent{0.0f};
+    std::chrono::steady_clock::time_point m_lastSample;
+
+    size_t m_iAdmitted{0};
+    size_t m_iDowngraded{0};
+    size_t m_iDeferred{0};
+    size_t m_iRejected{0};
+};
+
+#endif // ADMISSION_CONTROLLER_H
@@ -0,0 +1,549 @@
+#include "AnalyticsScheduler.h"
+#include "mx_logger.h"
+#include <gst/app/gstappsrc.h>
+#include <gst/app/gstappsink.h>
+#include <Poco/Environment.h>
+#include <algorithm>
+#include <ctime>
+
+#define ANALYTICS_TICK_MS              10
+#define ANALYTICS_REBALANCE_MS         1000
+#define ANALYTICS_DECODE_TIMEOUT_MS    100     // a keyframe normally decodes well within this
+#define ANALYTICS_DRAIN_TIMEOUT_MS     500
+#define ANALYTICS_CPU_RECOVER_RATIO    0.9f    // raise the budget again below this share of the limit
+#define ANALYTICS_CPU_RECOVER_STEP     1.1
+#define ANALYTICS_MIN_BUDGET_FPS       1.0
+
+AnalyticsScheduler::AnalyticsScheduler(FrameSubscriber subscriber)
+    : m_subscriber(std::move(subscriber))
+{
+    m_iCores = std::max(1u, static_cast<unsigned>(Poco::Environment::processorCount()));
+    m_fBudgetFps = m_config.fMaxFramesPerSec;
+}
+
+AnalyticsScheduler::~AnalyticsScheduler()
+{
+    stop();
+}
+
+void AnalyticsScheduler::setConfig(const AnalyticsBudgetConfig& config)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_config = config;
+    m_fBudgetFps = config.fMaxFramesPerSec;
+    assignRatesLocked();
+}
+
+AnalyticsBudgetConfig AnalyticsScheduler::getConfig() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_config;
+}
+
+void AnalyticsScheduler::setCallback(AnalyticsCallback callback)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_callback = std::move(callback);
+}
+
+///////////////////////////////////////////////    Cameras   //////////////////////////////////////////
+
+bool AnalyticsScheduler::addCamera(size_t pipelineId, const AnalyticsCameraConfig& config)
+{
+    // Display pipelines decode anyway; otherwise tap keyframes and decode the sampled ones
+    FrameTapConfig tapConfig;
+    tapConfig.iMaxQueued = 1;
+    tapConfig.eDrop = eFrameTapDrop::FRAME_TAP_DROP_OLDEST;
+    tapConfig.bKeyframesOnly = (config.eMode == eAnalyticsSampling::ANALYTICS_SAMPLE_KEYFRAME);
+    tapConfig.ePoint = eFrameTapPoint::FRAME_TAP_DECODED;
+
+    bool bDecodedTap = true;
+    FrameTapPtr tap = m_subscriber(pipelineId, tapConfig);
+    if (!tap)
+    {
+        bDecodedTap = false;
+        tapConfig.ePoint = eFrameTapPoint::FRAME_TAP_ENCODED;
+        tapConfig.bKeyframesOnly = true;
+        tap = m_subscriber(pipelineId, tapConfig);
+    }
+    if (!tap)
+    {
+        MX_LOG_WARN("AnalyticsScheduler", ("pipeline " + std::to_string(pipelineId) + " not found, camera not added").c_str());
+        return false;
+    }
+
+    auto camera = std::make_shared<Camera>();
+    camera->pipelineId = pipelineId;
+    camera->config = config;
+    camera->tap = tap;
+    camera->bDecodedTap = bDecodedTap;
+    camera->nextDue = std::chrono::steady_clock::now();
+
+    CameraPtr replaced;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& slot = m_cameras[pipelineId];
+        replaced = slot;
+        slot = camera;
+        assignRatesLocked();
+        ensureThreadsLocked();
+    }
+    if (replaced)
+    {
+        replaced->tap->close();
+    }
+
+    MX_LOG_INFO("AnalyticsScheduler", ("pipeline " + std::to_string(pipelineId) + " added, " +
+                (bDecodedTap ? "decoded frames" : "keyframes decoded on demand")).c_str());
+    return true;
+}
+
+void AnalyticsScheduler::removeCamera(size_t pipelineId)
+{
+    CameraPtr camera;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_cameras.find(pipelineId);
+        if (it == m_cameras.end())
+        {
+            return;
+        }
+        camera = it->second;
+        m_cameras.erase(it);
+        assignRatesLocked();
+    }
+    camera->tap->close();
+}
+
+///////////////////////////////////////////////    Budget   //////////////////////////////////////////
+
+void AnalyticsScheduler::assignRatesLocked()
+{
+    // Requested rate: the interval, capped by what the tap can deliver
+    std::vector<Camera*> open;
+    for (auto& [id, camera] : m_cameras)
+    {
+        double wanted = camera->fTapFps;
+        if (camera->config.eMode == eAnalyticsSampling::ANALYTICS_SAMPLE_INTERVAL && camera->config.iIntervalMs > 0)
+        {
+            wanted = std::min(wanted, 1000.0 / camera->config.iIntervalMs);
+        }
+        camera->fRequestedFps = wanted;
+        camera->fAssignedFps = 0.0;
+        open.push_back(camera.get());
+    }
+
+    // Max-min fair by weight: settle cameras that want less than their share, split the rest
+    double remaining = m_fBudgetFps;
+    while (!open.empty() && remaining > 0.0)
+    {
+        double weights = 0.0;
+        for (Camera* camera : open)
+        {
+            weights += std::max(camera->config.fWeight, 0.01f);
+        }
+        const double share = remaining / weights;
+
+        bool bSettled = false;
+        for (auto it = open.begin(); it != open.end();)
+        {
+            Camera* camera = *it;
+            if (camera->fRequestedFps <= share * std::max(camera->config.fWeight, 0.01f))
+            {
+                camera->fAssignedFps = camera->fRequestedFps;
+                remaining -= camera->fRequestedFps;
+                it = open.erase(it);
+                bSettled = true;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        if (!bSettled)
+        {
+            for (Camera* camera : open)
+            {
+                camera->fAssignedFps = share * std::max(camera->config.fWeight, 0.01f);
+            }
+            break;
+        }
+    }
+}
+
+void AnalyticsScheduler::rebalanceLocked(std::chrono::steady_clock::time_point now)
+{
+    const double elapsed = std::chrono::duration<double>(now - m_lastRebalance).count();
+    if (elapsed <= 0.0)
+    {
+        return;
+    }
+
+    // Tap rates tell how many frames (or keyframes) a camera can actually offer
+    for (auto& [id, camera] : m_cameras)
+    {
+        const uint64_t offered = camera->tap->getStats().iOffered;
+        const double fps = (offered - camera->lastOffered) / elapsed;
+        camera->lastOffered = offered;
+        if (fps > 0.0)
+        {
+            camera->fTapFps = 0.5 * camera->fTapFps + 0.5 * fps;
+        }
+    }
+
+    // CPU limit: scale the frame budget by how far over the limit the workers are
+    const uint64_t cpuNs = m_workerCpuNs.load(std::memory_order_relaxed);
+    m_fCpuPercent = static_cast<float>(100.0 * (cpuNs - m_lastCpuNs) / (elapsed * 1e9 * m_iCores));
+    m_lastCpuNs = cpuNs;
+    m_lastRebalance = now;
+
+    if (m_config.fMaxCpuPercent > 0.0f && m_fCpuPercent > m_config.fMaxCpuPercent)
+    {
+        m_fBudgetFps = std::max(ANALYTICS_MIN_BUDGET_FPS, m_fBudgetFps * m_config.fMaxCpuPercent / m_fCpuPercent);
+    }
+    else if (m_config.fMaxCpuPercent <= 0.0f || m_fCpuPercent < m_config.fMaxCpuPercent * ANALYTICS_CPU_RECOVER_RATIO)
+    {
+        m_fBudgetFps = std::min(m_config.fMaxFramesPerSec, m_fBudgetFps * ANALYTICS_CPU_RECOVER_STEP);
+    }
+
+    assignRatesLocked();
+}
+
+///////////////////////////////////////////////    Threads   //////////////////////////////////////////
+
+void AnalyticsScheduler::ensureThreadsLocked()
+{
+    if (m_bRunning)
+    {
+        return;
+    }
+    m_bRunning = true;
+
+    const unsigned workers = m_config.iWorkers > 0 ? m_config.iWorkers : std::max(1u, m_iCores / 2);
+    for (unsigned i = 0; i < workers; ++i)
+    {
+        m_workers.emplace_back(&AnalyticsScheduler::workerLoop, this);
+    }
+    m_schedulerThread = std::thread(&AnalyticsScheduler::schedulerLoop, this);
+}
+
+void AnalyticsScheduler::stop()
+{
+    std::unordered_map<size_t, CameraPtr> cameras;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bRunning = false;
+        cameras.swap(m_cameras);
+    }
+    m_cv.notify_all();
+    m_jobCv.notify_all();
+
+    if (m_schedulerThread.joinable())
+    {
+        m_schedulerThread.join();
+    }
+    for (std::thread& worker : m_workers)
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+    m_workers.clear();
+
+    for (auto& [id, camera] : cameras)
+    {
+        camera->tap->close();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (Job& job : m_jobs)
+    {
+        gst_sample_unref(job.sample);
+    }
+    m_jobs.clear();
+}
+
+void AnalyticsScheduler::schedulerLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_bRunning)
+    {
+        m_cv.wait_for(lock, std::chrono::milliseconds(ANALYTICS_TICK_MS));
+        if (!m_bRunning)
+        {
+            break;
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now - m_lastRebalance >= std::chrono::milliseconds(ANALYTICS_REBALANCE_MS))
+        {
+            rebalanceLocked(now);
+        }
+
+        const size_t maxPending = m_config.iMaxPendingJobs > 0 ? m_config.iMaxPendingJobs : 2 * m_workers.size();
+        bool bQueued = false;
+
+        for (auto it = m_cameras.begin(); it != m_cameras.end();)
+        {
+            CameraPtr camera = it->second;
+            if (camera->tap->isClosed())
+            {
+                // Pipeline went away; its share goes back to the others on the next rebalance
+                MX_LOG_INFO("AnalyticsScheduler", ("pipeline " + std::to_string(camera->pipelineId) + " closed, camera removed").c_str());
+                it = m_cameras.erase(it);
+                continue;
+            }
+            ++it;
+
+            if (camera->fAssignedFps <= 0.0 || camera->bBusy || now < camera->nextDue)
+            {
+                continue;
+            }
+
+            // The tap keeps only the latest frame; nothing there yet means wait for the next one
+            GstSample* sample = camera->tap->pull(0);
+            if (!sample)
+            {
+                continue;
+            }
+
+            const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(1.0 / camera->fAssignedFps));
+            camera->nextDue = now + period;
+
+            if (m_jobs.size() >= maxPending)
+            {
+                camera->iSkipped.fetch_add(1, std::memory_order_relaxed);
+                gst_sample_unref(sample);
+                continue;
+            }
+
+            camera->bBusy = true;
+            m_jobs.push_back({camera, sample});
+            bQueued = true;
+        }
+
+        if (bQueued)
+        {
+            m_jobCv.notify_all();
+        }
+    }
+}
+
+void AnalyticsScheduler::workerLoop()
+{
+    std::unordered_map<std::string, KeyframeDecoder> decoders;
+
+    while (true)
+    {
+        Job job;
+        AnalyticsCallback callback;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_jobCv.wait(lock, [this] { return !m_bRunning || !m_jobs.empty(); });
+            if (!m_bRunning)
+            {
+                break;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+            callback = m_callback;
+        }
+
+        const uint64_t startNs = threadCpuNs();
+
+        GstSample* frame = job.camera->bDecodedTap ? gst_sample_ref(job.sample) : decodeKeyframe(decoders, job.sample);
+        gst_sample_unref(job.sample);
+
+        if (frame)
+        {
+            if (callback)
+            {
+                callback(job.camera->pipelineId, frame);
+            }
+            gst_sample_unref(frame);
+            job.camera->iDelivered.fetch_add(1, std::memory_order_relaxed);
+            m_iDelivered.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            job.camera->iDecodeErrors.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        m_workerCpuNs.fetch_add(threadCpuNs() - startNs, std::memory_order_relaxed);
+        job.camera->bBusy = false;
+    }
+
+    for (auto& [codec, decoder] : decoders)
+    {
+        destroyDecoder(decoder);
+    }
+}
+
+///////////////////////////////////////////////    Keyframe decode   //////////////////////////////////////////
+
+bool AnalyticsScheduler::createDecoder(const std::string& codec, KeyframeDecoder& decoder)
+{
+    const char* decoderName = nullptr;
+    if (codec == "video/x-h264")
+    {
+        decoderName = "avdec_h264";
+    }
+    else if (codec == "video/x-h265")
+    {
+        decoderName = "avdec_h265";
+    }
+    else
+    {
+        MX_LOG_WARN("AnalyticsScheduler", ("no keyframe decoder for " + codec).c_str());
+        return false;
+    }
+
+    std::string outputCaps;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        outputCaps = m_config.sOutputCaps;
+    }
+
+    decoder.pipeline = gst_pipeline_new("analytics-decoder");
+    decoder.appsrc = gst_element_factory_make("appsrc", "src");
+    GstElement* avdec = gst_element_factory_make(decoderName, "decode");
+    GstElement* convert = gst_element_factory_make("videoconvert", "convert");
+    GstElement* filter = gst_element_factory_make("capsfilter", "filter");
+    decoder.appsink = gst_element_factory_make("appsink", "sink");
+
+    if (!decoder.pipeline || !decoder.appsrc || !avdec || !convert || !filter || !decoder.appsink)
+    {
+        MX_LOG_ERROR("AnalyticsScheduler", ("failed to create keyframe decoder for " + codec).c_str());
+        // Elements not yet in the bin are still floating; sink them before dropping them
+        for (GstElement* element : {decoder.appsrc, avdec, convert, filter, decoder.appsink})
+        {
+            if (element)
+            {
+                gst_object_unref(gst_object_ref_sink(element));
+            }
+        }
+        if (decoder.pipeline)
+        {
+            gst_object_unref(decoder.pipeline);
+        }
+        decoder = KeyframeDecoder();
+        return false;
+    }
+
+    // One thread: each job is a single frame, frame threading would only add delay
+    g_object_set(avdec, "max-threads", 1, nullptr);
+    g_object_set(decoder.appsrc, "format", GST_FORMAT_TIME, "is-live", FALSE, nullptr);
+    g_object_set(decoder.appsink, "sync", FALSE, "max-buffers", 2, nullptr);
+
+    GstCaps* caps = gst_caps_from_string(outputCaps.c_str());
+    g_object_set(filter, "caps", caps, nullptr);
+    gst_caps_unref(caps);
+
+    gst_bin_add_many(GST_BIN(decoder.pipeline), decoder.appsrc, avdec, convert, filter, decoder.appsink, nullptr);
+    if (!gst_element_link_many(decoder.appsrc, avdec, convert, filter, decoder.appsink, nullptr) ||
+        gst_element_set_state(decoder.pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+    {
+        MX_LOG_ERROR("AnalyticsScheduler", ("failed to start keyframe decoder for " + codec).c_str());
+        destroyDecoder(decoder);
+        return false;
+    }
+    return true;
+}
+
+void AnalyticsScheduler::destroyDecoder(KeyframeDecoder& decoder)
+{
+    if (decoder.pipeline)
+    {
+        gst_element_set_state(decoder.pipeline, GST_STATE_NULL);
+        gst_object_unref(decoder.pipeline);
+    }
+    decoder = KeyframeDecoder();
+}
+
+GstSample* AnalyticsScheduler::decodeKeyframe(std::unordered_map<std::string, KeyframeDecoder>& decoders, GstSample* sample)
+{
+    GstCaps* caps = gst_sample_get_caps(sample);
+    if (!caps)
+    {
+        return nullptr;
+    }
+    const std::string codec = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+
+    auto it = decoders.find(codec);
+    if (it == decoders.end())
+    {
+        KeyframeDecoder decoder;
+        if (!createDecoder(codec, decoder))
+        {
+            return nullptr;
+        }
+        it = decoders.emplace(codec, decoder).first;
+    }
+    KeyframeDecoder& decoder = it->second;
+
+    // Cameras share the decoder; a new camera's caps renegotiate it on the next push
+    if (gst_app_src_push_sample(GST_APP_SRC(decoder.appsrc), sample) != GST_FLOW_OK)
+    {
+        destroyDecoder(decoder);
+        decoders.erase(it);
+        return nullptr;
+    }
+
+    GstSample* frame = gst_app_sink_try_pull_sample(GST_APP_SINK(decoder.appsink), ANALYTICS_DECODE_TIMEOUT_MS * GST_MSECOND);
+    if (!frame)
+    {
+        // Streams with frame reordering hold the picture back; drain with EOS, then reset
+        gst_app_src_end_of_stream(GST_APP_SRC(decoder.appsrc));
+        frame = gst_app_sink_try_pull_sample(GST_APP_SINK(decoder.appsink), ANALYTICS_DRAIN_TIMEOUT_MS * GST_MSECOND);
+        gst_element_set_state(decoder.pipeline, GST_STATE_READY);
+        gst_element_set_state(decoder.pipeline, GST_STATE_PLAYING);
+    }
+    return frame;
+}
+
+uint64_t AnalyticsScheduler::threadCpuNs()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+///////////////////////////////////////////////    Snapshot   //////////////////////////////////////////
+
+AnalyticsSnapshot AnalyticsScheduler::getSnapshot()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    AnalyticsSnapshot snapshot;
+    snapshot.fBudgetFps   = m_fBudgetFps;
+    snapshot.fCpuPercent  = m_fCpuPercent;
+    snapshot.iWorkers     = m_workers.size();
+    snapshot.iPendingJobs = m_jobs.size();
+
+    const auto now = std::chrono::steady_clock::now();
+    const double elapsed = std::chrono::duration<double>(now - m_snapshotTime).count();
+    const uint64_t delivered = m_iDelivered.load(std::memory_order_relaxed);
+    if (elapsed > 0.0)
+    {
+        snapshot.fDeliveredFps = (delivered - m_snapshotDelivered) / elapsed;
+    }
+    m_snapshotDelivered = delivered;
+    m_snapshotTime = now;
+
+    for (const auto& [id, camera] : m_cameras)
+    {
+        AnalyticsCameraStats stats;
+        stats.pipelineId    = id;
+        stats.bDecodedTap   = camera->bDecodedTap;
+        stats.fRequestedFps = camera->fRequestedFps;
+        stats.fAssignedFps  = camera->fAssignedFps;
+        stats.iDelivered    = camera->iDelivered.load(std::memory_order_relaxed);
+        stats.iSkipped      = camera->iSkipped.load(std::memory_order_relaxed);
+        stats.iDecodeErrors = camera->iDecodeErrors.load(std::memory_order_relaxed);
+        snapshot.vCameras.push_back(stats);
+    }
+    return snapshot;
+}
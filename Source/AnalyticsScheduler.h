@@ -0,0 +1,167 @@
+#ifndef ANALYTICS_SCHEDULER_H
+#define ANALYTICS_SCHEDULER_H
+
+#include <gst/gst.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Enum.h"
+#include "FrameTap.h"
+
+struct AnalyticsBudgetConfig
+{
+    double      fMaxFramesPerSec{200.0};    // all cameras together
+    float       fMaxCpuPercent{0.0f};       // decode + consumer time, percent of the host; 0 = no limit
+    unsigned    iWorkers{0};                // 0 = half the cores; read when the pool starts
+    size_t      iMaxPendingJobs{0};         // 0 = two per worker; a full queue skips the slot
+    std::string sOutputCaps{"video/x-raw,format=RGB"};  // format of frames the scheduler decodes
+};
+
+struct AnalyticsCameraConfig
+{
+    eAnalyticsSampling eMode{eAnalyticsSampling::ANALYTICS_SAMPLE_INTERVAL};
+    int                iIntervalMs{1000};   // interval mode: wanted spacing between samples
+    float              fWeight{1.0f};       // share of the budget relative to other cameras
+};
+
+struct AnalyticsCameraStats
+{
+    size_t   pipelineId{0};
+    bool     bDecodedTap{false};    // frames come from the display decoder, no extra decode
+    double   fRequestedFps{0.0};
+    double   fAssignedFps{0.0};
+    uint64_t iDelivered{0};
+    uint64_t iSkipped{0};           // due slots lost to a full worker queue
+    uint64_t iDecodeErrors{0};
+};
+
+struct AnalyticsSnapshot
+{
+    double   fBudgetFps{0.0};       // after the CPU limit
+    double   fDeliveredFps{0.0};    // since the previous snapshot
+    float    fCpuPercent{0.0f};     // worker CPU, percent of the host, since the previous rebalance
+    size_t   iWorkers{0};
+    size_t   iPendingJobs{0};
+    std::vector<AnalyticsCameraStats> vCameras;
+};
+
+// Runs on a worker thread; the frame is only borrowed for the call
+using AnalyticsCallback = std::function<void(size_t pipelineId, GstSample* frame)>;
+
+// How the scheduler reaches a pipeline's frame taps (the pipeline manager)
+using FrameSubscriber = std::function<FrameTapPtr(size_t pipelineId, const FrameTapConfig& config)>;
+
+// Hands out sampling slots to cameras under a global frames-per-second and CPU
+// budget, and runs the sampled frames through a worker pool.
+//
+// The budget is split max-min fair by weight: cameras that want less than their
+// share keep what they asked for, the rest is divided among the others. It is
+// recomputed when cameras come and go and once a second, when the CPU limit
+// is also applied.
+//
+// Display pipelines already decode, so their decoded frames are tapped directly.
+// Other pipelines are tapped for keyframes only, and a worker decodes just the
+// keyframes that get a slot. Such a camera is sampled at most at its keyframe rate.
+class AnalyticsScheduler
+{
+public:
+    explicit AnalyticsScheduler(FrameSubscriber subscriber);
+    ~AnalyticsScheduler();
+
+    AnalyticsScheduler(const AnalyticsScheduler&) = delete;
+    AnalyticsScheduler& operator=(const AnalyticsScheduler&) = delete;
+
+    void setConfig(const AnalyticsBudgetConfig& config);
+    AnalyticsBudgetConfig getConfig() const;
+    void setCallback(AnalyticsCallback callback);
+
+    // False if the pipeline does not exist. Adding a camera again replaces its config.
+    bool addCamera(size_t pipelineId, const AnalyticsCameraConfig& config);
+    void removeCamera(size_t pipelineId);
+
+    AnalyticsSnapshot getSnapshot();
+
+    // Stops the scheduler and worker threads and drops all cameras
+    void stop();
+
+private:
+    struct Camera
+    {
+        size_t                pipelineId{0};
+        AnalyticsCameraConfig config;
+        FrameTapPtr           tap;
+        bool                  bDecodedTap{false};
+        double                fRequestedFps{0.0};
+        double                fAssignedFps{0.0};
+        std::chrono::steady_clock::time_point nextDue{};
+        std::atomic<bool>     bBusy{false};     // a job is queued or running
+        std::atomic<uint64_t> iDelivered{0};
+        std::atomic<uint64_t> iSkipped{0};
+        std::atomic<uint64_t> iDecodeErrors{0};
+
+        // Frame rate seen on the tap, keyframes only for encoded taps
+        uint64_t              lastOffered{0};
+        double                fTapFps{1.0};
+    };
+    using CameraPtr = std::shared_ptr<Camera>;
+
+    struct Job
+    {
+        CameraPtr  camera;
+        GstSample* sample{nullptr};
+    };
+
+    // Per worker, per codec: appsrc ! avdec ! videoconvert ! capsfilter ! appsink
+    struct KeyframeDecoder
+    {
+        GstElement* pipeline{nullptr};
+        GstElement* appsrc{nullptr};
+        GstElement* appsink{nullptr};
+    };
+
+    void ensureThreadsLocked();
+    void schedulerLoop();
+    void workerLoop();
+    void rebalanceLocked(std::chrono::steady_clock::time_point now);
+    void assignRatesLocked();
+    GstSample* decodeKeyframe(std::unordered_map<std::string, KeyframeDecoder>& decoders, GstSample* sample);
+    bool createDecoder(const std::string& codec, KeyframeDecoder& decoder);
+    static void destroyDecoder(KeyframeDecoder& decoder);
+    static uint64_t threadCpuNs();
+
+    FrameSubscriber         m_subscriber;
+
+    mutable std::mutex      m_mutex;
+    std::condition_variable m_cv;           // scheduler wakeup
+    std::condition_variable m_jobCv;        // worker wakeup
+    AnalyticsBudgetConfig   m_config;
+    AnalyticsCallback       m_callback;
+    std::unordered_map<size_t, CameraPtr> m_cameras;
+    std::deque<Job>         m_jobs;
+    bool                    m_bRunning{false};
+    std::thread             m_schedulerThread;
+    std::vector<std::thread> m_workers;
+    unsigned                m_iCores{1};
+
+    // Budget state, guarded by m_mutex
+    double                  m_fBudgetFps{0.0};
+    float                   m_fCpuPercent{0.0f};
+    std::chrono::steady_clock::time_point m_lastRebalance{std::chrono::steady_clock::now()};
+    uint64_t                m_lastCpuNs{0};
+
+    std::atomic<uint64_t>   m_workerCpuNs{0};
+    std::atomic<uint64_t>   m_iDelivered{0};
+    uint64_t                m_snapshotDelivered{0};
+    std::chrono::steady_clock::time_point m_snapshotTime{std::chrono::steady_clock::now()};
+};
+
+#endif // ANALYTICS_SCHEDULER_H
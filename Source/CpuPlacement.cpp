@@ -0,0 +1,280 @@
+#include "CpuPlacement.h"
+#include "mx_logger.h"
+#include <Poco/Environment.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#define NUMA_SYSFS_ROOT "/sys/devices/system/node/node"
+
+CpuPlacement::CpuPlacement()
+{
+    loadTopology();
+    buildSlotsLocked();
+}
+
+void CpuPlacement::setConfig(const PlacementConfig& config)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const bool bResize = config.iCoresPerPipeline != m_config.iCoresPerPipeline;
+    m_config = config;
+
+    // Existing pipelines keep their cores; only rebuild the slots when nothing is placed
+    if (bResize && m_assigned.empty())
+    {
+        buildSlotsLocked();
+    }
+}
+
+PlacementConfig CpuPlacement::getConfig() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_config;
+}
+
+///////////////////////////////////////////////    Topology   //////////////////////////////////////////
+
+std::vector<int> CpuPlacement::parseCpuList(const std::string& list)
+{
+    // Kernel cpulist format: "0-7,16-23"
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ','))
+    {
+        int first = -1, last = -1;
+        if (sscanf(range.c_str(), "%d-%d", &first, &last) == 2)
+        {
+            for (int cpu = first; cpu <= last; ++cpu)
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        else if (sscanf(range.c_str(), "%d", &first) == 1)
+        {
+            cpus.push_back(first);
+        }
+    }
+    return cpus;
+}
+
+std::vector<int> CpuPlacement::allowedCpus()
+{
+    std::vector<int> cpus;
+#ifdef __linux__
+    // cpuset cgroups, taskset and containers narrow this below the host's cores
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (sched_getaffinity(getpid(), sizeof(mask), &mask) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &mask))
+            {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    return cpus;
+}
+
+void CpuPlacement::loadTopology()
+{
+    // Pinning to a core outside the process mask fails with EINVAL, so only allowed cores count
+    const std::vector<int> allowed = allowedCpus();
+    auto usable = [&allowed](std::vector<int> cpus)
+    {
+        if (!allowed.empty())
+        {
+            cpus.erase(std::remove_if(cpus.begin(), cpus.end(),
+                                      [&allowed](int cpu) { return !std::binary_search(allowed.begin(), allowed.end(), cpu); }),
+                       cpus.end());
+        }
+        return cpus;
+    };
+
+    for (int node = 0; ; ++node)
+    {
+        std::ifstream file(NUMA_SYSFS_ROOT + std::to_string(node) + "/cpulist");
+        if (!file.is_open())
+        {
+            break;
+        }
+        std::string list;
+        std::getline(file, list);
+        std::vector<int> cpus = usable(parseCpuList(list));
+        if (!cpus.empty())
+        {
+            m_nodes.push_back(std::move(cpus));
+            m_nodeIds.push_back(node);
+        }
+    }
+
+    if (m_nodes.empty())
+    {
+        std::vector<int> cpus = allowed;
+        if (cpus.empty())
+        {
+            cpus.resize(std::max(1u, static_cast<unsigned>(Poco::Environment::processorCount())));
+            for (size_t i = 0; i < cpus.size(); ++i)
+            {
+                cpus[i] = static_cast<int>(i);
+            }
+        }
+        m_nodes.push_back(std::move(cpus));
+        m_nodeIds.push_back(0);
+    }
+
+    MX_LOG_INFO("CpuPlacement", ("NUMA nodes: " + std::to_string(m_nodes.size())).c_str());
+}
+
+void CpuPlacement::buildSlotsLocked()
+{
+    m_slots.clear();
+    m_iNextSlot = 0;
+
+    for (size_t node = 0; node < m_nodes.size(); ++node)
+    {
+        const std::vector<int>& cpus = m_nodes[node];
+        const size_t size = std::max<size_t>(1, std::min<size_t>(m_config.iCoresPerPipeline, cpus.size()));
+
+        // A short tail joins the previous slot rather than forming an undersized one
+        for (size_t i = 0; i + size <= cpus.size(); i += size)
+        {
+            Slot slot;
+            slot.node = static_cast<int>(node);
+            const size_t end = (i + 2 * size > cpus.size()) ? cpus.size() : i + size;
+            slot.cpus.assign(cpus.begin() + i, cpus.begin() + end);
+            m_slots.push_back(std::move(slot));
+        }
+    }
+}
+
+///////////////////////////////////////////////    Placement   //////////////////////////////////////////
+
+size_t CpuPlacement::chooseSlotLocked()
+{
+    size_t best = 0;
+    switch (m_config.ePolicy)
+    {
+    case eAffinityPolicy::AFFINITY_ROUND_ROBIN:
+        best = m_iNextSlot;
+        m_iNextSlot = (m_iNextSlot + 1) % m_slots.size();
+        break;
+
+    case eAffinityPolicy::AFFINITY_PACK:
+        // Least used slot, lowest node first: node 0 fills up before node 1 is touched
+        for (size_t i = 1; i < m_slots.size(); ++i)
+        {
+            if (m_slots[i].users < m_slots[best].users)
+            {
+                best = i;
+            }
+        }
+        break;
+
+    case eAffinityPolicy::AFFINITY_SPREAD:
+    default:
+    {
+        // Node with the fewest pipelines per core, then its least used slot
+        std::vector<size_t> nodeUsers(m_nodes.size(), 0);
+        for (const Slot& slot : m_slots)
+        {
+            nodeUsers[slot.node] += slot.users;
+        }
+        size_t node = 0;
+        for (size_t n = 1; n < m_nodes.size(); ++n)
+        {
+            if (nodeUsers[n] * m_nodes[node].size() < nodeUsers[node] * m_nodes[n].size())
+            {
+                node = n;
+            }
+        }
+        bool bFound = false;
+        for (size_t i = 0; i < m_slots.size(); ++i)
+        {
+            if (m_slots[i].node == static_cast<int>(node) && (!bFound || m_slots[i].users < m_slots[best].users))
+            {
+                best = i;
+                bFound = true;
+            }
+        }
+        break;
+    }
+    }
+    return best;
+}
+
+PipelinePlacement CpuPlacement::place(size_t pipelineId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    PipelinePlacement placement;
+    placement.pipelineId = pipelineId;
+    if (m_config.ePolicy == eAffinityPolicy::AFFINITY_NONE || m_slots.empty())
+    {
+        return placement;
+    }
+
+    // A re-placed pipeline gives up its old slot first
+    if (auto it = m_assigned.find(pipelineId); it != m_assigned.end())
+    {
+        --m_slots[it->second].users;
+        m_assigned.erase(it);
+    }
+
+    const size_t index = chooseSlotLocked();
+    Slot& slot = m_slots[index];
+    ++slot.users;
+    m_assigned[pipelineId] = index;
+
+    placement.iNumaNode = m_nodeIds[slot.node];
+    placement.vCpuSet = slot.cpus;
+    return placement;
+}
+
+void CpuPlacement::release(size_t pipelineId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (auto it = m_assigned.find(pipelineId); it != m_assigned.end())
+    {
+        --m_slots[it->second].users;
+        m_assigned.erase(it);
+    }
+}
+
+PlacementSnapshot CpuPlacement::getSnapshot() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    PlacementSnapshot snapshot;
+    snapshot.ePolicy = m_config.ePolicy;
+    snapshot.iNumaNodes = m_nodes.size();
+    snapshot.vPipelinesPerNode.assign(m_nodes.size(), 0);
+    for (const auto& cpus : m_nodes)
+    {
+        snapshot.iCores += cpus.size();
+    }
+    for (const auto& [id, index] : m_assigned)
+    {
+        const Slot& slot = m_slots[index];
+        ++snapshot.vPipelinesPerNode[slot.node];
+        snapshot.placements.push_back({id, m_nodeIds[slot.node], slot.cpus});
+    }
+    return snapshot;
+}
+
+std::string CpuPlacement::formatCpuSet(const std::vector<int>& cpus)
+{
+    std::ostringstream oss;
+    for (size_t i = 0; i < cpus.size(); ++i)
+    {
+        oss << (i ? "," : "") << cpus[i];
+    }
+    return oss.str();
+}
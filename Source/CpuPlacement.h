@@ -0,0 +1,76 @@
+#ifndef CPU_PLACEMENT_H
+#define CPU_PLACEMENT_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "Struct.h"
+
+struct PlacementConfig
+{
+    eAffinityPolicy ePolicy{eAffinityPolicy::AFFINITY_NONE};
+    unsigned        iCoresPerPipeline{2};   // size of each core set, never crosses a NUMA node
+};
+
+// Where one pipeline's streaming threads run
+struct PipelinePlacement
+{
+    size_t           pipelineId{0};
+    int              iNumaNode{-1};
+    std::vector<int> vCpuSet;
+};
+
+struct PlacementSnapshot
+{
+    eAffinityPolicy ePolicy{eAffinityPolicy::AFFINITY_NONE};
+    size_t          iNumaNodes{0};
+    size_t          iCores{0};
+    std::vector<size_t> vPipelinesPerNode;
+    std::vector<PipelinePlacement> placements;
+};
+
+// Assigns each pipeline a core set from the host NUMA topology. The topology is
+// read once from /sys/devices/system/node; hosts without it are one node. Only
+// cores in the process's affinity mask are used, so a cpuset or taskset limit holds.
+class CpuPlacement
+{
+public:
+    CpuPlacement();
+
+    // Applies to pipelines placed after the call
+    void setConfig(const PlacementConfig& config);
+    PlacementConfig getConfig() const;
+
+    // Empty vCpuSet when placement is off
+    PipelinePlacement place(size_t pipelineId);
+    void release(size_t pipelineId);
+
+    PlacementSnapshot getSnapshot() const;
+
+    static std::string formatCpuSet(const std::vector<int>& cpus);
+
+private:
+    struct Slot
+    {
+        int              node{0};
+        std::vector<int> cpus;
+        size_t           users{0};
+    };
+
+    void   loadTopology();
+    void   buildSlotsLocked();
+    size_t chooseSlotLocked();
+    static std::vector<int> parseCpuList(const std::string& list);
+    static std::vector<int> allowedCpus();
+
+    mutable std::mutex m_mutex;
+    PlacementConfig    m_config;
+    std::vector<std::vector<int>> m_nodes;    // allowed cores per NUMA node, nodes without any left out
+    std::vector<int>   m_nodeIds;             // kernel node number of each m_nodes entry
+    std::vector<Slot>  m_slots;               // node-major order
+    size_t             m_iNextSlot{0};        // round-robin cursor
+    std::unordered_map<size_t, size_t> m_assigned;  // pipeline -> slot
+};
+
+#endif // CPU_PLACEMENT_H
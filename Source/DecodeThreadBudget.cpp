@@ -0,0 +1,147 @@
+#include "DecodeThreadBudget.h"
+#include <Poco/Environment.h>
+#include <algorithm>
+
+DecodeThreadBudget::DecodeThreadBudget()
+{
+    m_iCores = std::max(1u, static_cast<unsigned>(Poco::Environment::processorCount()));
+}
+
+void DecodeThreadBudget::setConfig(const DecodeBudgetConfig& config)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_config = config;
+    rebalanceLocked();
+}
+
+DecodeBudgetConfig DecodeThreadBudget::getConfig() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_config;
+}
+
+float DecodeThreadBudget::weightFor(const MediaStreamDevice& device, int priority)
+{
+    const MediaData& input = device.stinputMediaData;
+
+    float weight = 1.0f;
+    if (input.stResolution.width > 0 && input.stResolution.height > 0)
+    {
+        weight = (input.stResolution.width * input.stResolution.height) / (1920.0f * 1080.0f);
+    }
+    if (input.stResolution.frameRate > 0.0f)
+    {
+        weight *= input.stResolution.frameRate / 25.0f;
+    }
+    if (input.stMediaCodec.evideocodec == eVideoCodec::VIDEO_CODEC_H265)
+    {
+        weight *= 1.5f;
+    }
+
+    // Each priority step is worth a quarter of a 1080p25 stream
+    weight *= std::max(0.25f, 1.0f + 0.25f * priority);
+    return std::max(weight, 0.05f);
+}
+
+DecodeThreadMap DecodeThreadBudget::add(size_t pipelineId, const MediaStreamDevice& device, int priority, float loadFactor)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_decoders[pipelineId].weight = weightFor(device, priority) * std::max(loadFactor, 0.1f);
+    rebalanceLocked();
+    return currentLocked();
+}
+
+DecodeThreadMap DecodeThreadBudget::remove(size_t pipelineId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_decoders.erase(pipelineId) > 0)
+    {
+        rebalanceLocked();
+    }
+    return currentLocked();
+}
+
+DecodeThreadMap DecodeThreadBudget::current() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return currentLocked();
+}
+
+DecodeThreadMap DecodeThreadBudget::currentLocked() const
+{
+    DecodeThreadMap threads;
+    for (const auto& [id, decoder] : m_decoders)
+    {
+        threads[id] = decoder.threads;
+    }
+    return threads;
+}
+
+unsigned DecodeThreadBudget::budgetLocked() const
+{
+    return m_config.iTotalThreads > 0 ? m_config.iTotalThreads : m_iCores;
+}
+
+void DecodeThreadBudget::rebalanceLocked()
+{
+    if (!m_config.bEnabled)
+    {
+        for (auto& [id, decoder] : m_decoders)
+        {
+            decoder.threads = 0;
+        }
+        return;
+    }
+
+    const unsigned minThreads = std::max(1u, m_config.iMinPerDecoder);
+    const unsigned maxThreads = std::max(minThreads, m_config.iMaxPerDecoder);
+
+    // Everyone gets the minimum, even past the budget; a decoder cannot run on zero threads
+    unsigned assigned = 0;
+    for (auto& [id, decoder] : m_decoders)
+    {
+        decoder.threads = minThreads;
+        assigned += minThreads;
+    }
+
+    // Hand out the rest one at a time to the decoder with the most weight per thread
+    const unsigned budget = budgetLocked();
+    while (assigned < budget)
+    {
+        Decoder* best = nullptr;
+        float bestShare = 0.0f;
+        for (auto& [id, decoder] : m_decoders)
+        {
+            if (decoder.threads >= maxThreads)
+            {
+                continue;
+            }
+            const float share = decoder.weight / decoder.threads;
+            if (!best || share > bestShare)
+            {
+                best = &decoder;
+                bestShare = share;
+            }
+        }
+        if (!best)
+        {
+            break;
+        }
+        ++best->threads;
+        ++assigned;
+    }
+}
+
+DecodeBudgetSnapshot DecodeThreadBudget::getSnapshot() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    DecodeBudgetSnapshot snapshot;
+    snapshot.iBudget = budgetLocked();
+    for (const auto& [id, decoder] : m_decoders)
+    {
+        snapshot.allocations.push_back({id, decoder.threads, decoder.weight});
+        snapshot.iAssigned += decoder.threads;
+    }
+    return snapshot;
+}
@@ -0,0 +1,72 @@
+#ifndef DECODE_THREAD_BUDGET_H
+#define DECODE_THREAD_BUDGET_H
+
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include "Struct.h"
+
+// Host-wide limit on libav decoder threads, shared out across display pipelines
+struct DecodeBudgetConfig
+{
+    bool     bEnabled{true};
+    unsigned iTotalThreads{0};          // 0 = one per core
+    unsigned iMinPerDecoder{1};
+    unsigned iMaxPerDecoder{4};         // frame threading past this adds latency for little gain
+};
+
+struct DecodeThreadAllocation
+{
+    size_t   pipelineId{0};
+    unsigned iThreads{0};
+    float    fWeight{0.0f};
+    unsigned iRunning{0};               // share the live decoder runs with; reaches iThreads at its next keyframe
+};
+
+struct DecodeBudgetSnapshot
+{
+    unsigned iBudget{0};
+    unsigned iAssigned{0};              // can exceed iBudget when every decoder is at its minimum
+    std::vector<DecodeThreadAllocation> allocations;
+};
+
+// Thread counts per pipeline after a change; 0 leaves the decoder on its own default
+using DecodeThreadMap = std::unordered_map<size_t, unsigned>;
+
+class DecodeThreadBudget
+{
+public:
+    DecodeThreadBudget();
+
+    void setConfig(const DecodeBudgetConfig& config);
+    DecodeBudgetConfig getConfig() const;
+
+    // Add or remove a decoder and rebalance; the result covers every registered decoder.
+    // loadFactor scales the decode weight for pipelines that also encode.
+    DecodeThreadMap add(size_t pipelineId, const MediaStreamDevice& device, int priority, float loadFactor = 1.0f);
+    DecodeThreadMap remove(size_t pipelineId);
+    DecodeThreadMap current() const;
+
+    DecodeBudgetSnapshot getSnapshot() const;
+
+    // Relative decode load: pixel rate against 1080p25, scaled by request priority
+    static float weightFor(const MediaStreamDevice& device, int priority);
+
+private:
+    struct Decoder
+    {
+        float    weight{1.0f};
+        unsigned threads{0};
+    };
+
+    unsigned budgetLocked() const;
+    void rebalanceLocked();
+    DecodeThreadMap currentLocked() const;
+
+    mutable std::mutex m_mutex;
+    DecodeBudgetConfig m_config;
+    unsigned           m_iCores{1};
+    std::unordered_map<size_t, Decoder> m_decoders;
+};
+
+#endif // DECODE_THREAD_BUDGET_H
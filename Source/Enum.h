@@ -78,6 +78,87 @@ enum class eContainerFormat
 	CONTAINER_FORMAT_WebM
 };
 
+// What request submission does when the submission queue is full
+enum class eBackpressurePolicy
+{
+	BACKPRESSURE_REJECT = 0,		// fail the request immediately with ResourceError
+	BACKPRESSURE_BLOCK,				// wait up to the configured timeout for space
+	BACKPRESSURE_SHED_LOWEST		// evict the lowest priority queued request if the new one outranks it
+};
+
+// Outcome of resource admission for a new pipeline
+enum class eAdmissionDecision
+{
+	ADMISSION_ADMIT = 0,
+	ADMISSION_DOWNGRADE,		// admit with reduced decode cost
+	ADMISSION_DEFER,			// retry later, the host is temporarily saturated
+	ADMISSION_REJECT
+};
+
+// Optional queue points inside a pipeline
+enum class eQueueStage
+{
+	QUEUE_STAGE_DEPAY = 0,		// depayloader -> parser: decouples the network thread
+	QUEUE_STAGE_PARSER,			// parser -> decoder/muxer/network sink
+	QUEUE_STAGE_DECODER,		// decoder -> display sink
+	QUEUE_STAGE_COUNT
+};
+
+// What a full queue does with new data; matches the queue element's "leaky" values
+enum class eQueueLeaky
+{
+	QUEUE_LEAKY_NONE = 0,		// block upstream, never drop
+	QUEUE_LEAKY_UPSTREAM,		// drop the incoming buffer
+	QUEUE_LEAKY_DOWNSTREAM		// drop the oldest queued buffer
+};
+
+// Where a frame tap reads from
+enum class eFrameTapPoint
+{
+	FRAME_TAP_ENCODED = 0,		// parsed access units (parser src)
+	FRAME_TAP_DECODED,			// raw frames (decoder src), display pipelines only
+	FRAME_TAP_COUNT
+};
+
+// What a full frame tap queue gives up
+enum class eFrameTapDrop
+{
+	FRAME_TAP_DROP_OLDEST = 0,	// keep the newest frames
+	FRAME_TAP_DROP_NEWEST		// keep what is queued, refuse new frames
+};
+
+// What a pipeline does with the camera's audio, per output type
+enum class eAudioRoute
+{
+	AUDIO_ROUTE_NONE = 0,		// not requested or not carried: the audio stream is not even set up
+	AUDIO_ROUTE_PASSTHROUGH,	// compressed audio into the muxer or sink as received
+	AUDIO_ROUTE_TRANSCODE,		// decode and re-encode to AAC or Opus for the output
+	AUDIO_ROUTE_PLAYBACK		// decode to an audio sink next to the display
+};
+
+// Live view latency trade-off
+enum class eLatencyProfile
+{
+	LATENCY_PROFILE_STANDARD = 0,	// rtspsrc defaults, clock-synced display
+	LATENCY_PROFILE_LOW				// small jitterbuffer, late packets dropped, unsynced display
+};
+
+// How pipelines' streaming threads are pinned to cores
+enum class eAffinityPolicy
+{
+	AFFINITY_NONE = 0,			// leave scheduling to the OS
+	AFFINITY_ROUND_ROBIN,		// rotate through core sets in NUMA node order
+	AFFINITY_PACK,				// fill the lowest NUMA node before using the next
+	AFFINITY_SPREAD				// balance pipelines across NUMA nodes
+};
+
+// When the analytics scheduler takes a frame from a camera
+enum class eAnalyticsSampling
+{
+	ANALYTICS_SAMPLE_INTERVAL = 0,	// at most one frame per configured interval
+	ANALYTICS_SAMPLE_KEYFRAME		// every keyframe, budget permitting
+};
+
 // Pipeline status enum to represent both normal status and errors
 enum class PipelineStatus
 {
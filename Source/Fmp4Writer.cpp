@@ -0,0 +1,258 @@
+#include "Fmp4Writer.h"
+#include <cstring>
+
+namespace
+{
+    // Big-endian box builder; open() reserves the size field, close() patches it
+    class BoxBuffer
+    {
+    public:
+        explicit BoxBuffer(std::vector<uint8_t>& out) : m_out(out) {}
+
+        void u8(uint8_t v) { m_out.push_back(v); }
+        void u16(uint16_t v) { u8(v >> 8); u8(v & 0xFF); }
+        void u32(uint32_t v) { u16(v >> 16); u16(v & 0xFFFF); }
+        void u64(uint64_t v) { u32(static_cast<uint32_t>(v >> 32)); u32(static_cast<uint32_t>(v)); }
+        void zeros(size_t n) { m_out.insert(m_out.end(), n, 0); }
+        void fourcc(const char* code) { m_out.insert(m_out.end(), code, code + 4); }
+        void bytes(const uint8_t* data, size_t size) { m_out.insert(m_out.end(), data, data + size); }
+
+        size_t open(const char* type)
+        {
+            const size_t at = m_out.size();
+            u32(0);
+            fourcc(type);
+            return at;
+        }
+
+        size_t openFull(const char* type, uint8_t version, uint32_t flags)
+        {
+            const size_t at = open(type);
+            u32((static_cast<uint32_t>(version) << 24) | (flags & 0xFFFFFF));
+            return at;
+        }
+
+        void close(size_t at)
+        {
+            const uint32_t size = static_cast<uint32_t>(m_out.size() - at);
+            m_out[at] = size >> 24;
+            m_out[at + 1] = (size >> 16) & 0xFF;
+            m_out[at + 2] = (size >> 8) & 0xFF;
+            m_out[at + 3] = size & 0xFF;
+        }
+
+        void patch32(size_t at, uint32_t v)
+        {
+            m_out[at] = v >> 24;
+            m_out[at + 1] = (v >> 16) & 0xFF;
+            m_out[at + 2] = (v >> 8) & 0xFF;
+            m_out[at + 3] = v & 0xFF;
+        }
+
+        size_t size() const { return m_out.size(); }
+
+    private:
+        std::vector<uint8_t>& m_out;
+    };
+
+    void matrix(BoxBuffer& b)
+    {
+        const uint32_t unity[9] = { 0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000 };
+        for (uint32_t v : unity)
+        {
+            b.u32(v);
+        }
+    }
+
+    // ISO/IEC 14496-12 sample_flags
+    const uint32_t kSyncSampleFlags    = 0x02000000;    // depends on no other sample
+    const uint32_t kNonSyncSampleFlags = 0x01010000;    // depends on others, non-sync
+}
+
+std::vector<uint8_t> Fmp4Writer::initSegment(const Fmp4TrackInfo& track)
+{
+    std::vector<uint8_t> out;
+    BoxBuffer b(out);
+
+    size_t ftyp = b.open("ftyp");
+    b.fourcc("iso6");
+    b.u32(0);
+    b.fourcc("iso6");
+    b.fourcc("cmfc");
+    b.fourcc("mp41");
+    b.close(ftyp);
+
+    size_t moov = b.open("moov");
+    {
+        size_t mvhd = b.openFull("mvhd", 0, 0);
+        b.u32(0);                   // creation
+        b.u32(0);                   // modification
+        b.u32(1000);                // timescale
+        b.u32(0);                   // duration: fragmented, unknown
+        b.u32(0x00010000);          // rate 1.0
+        b.u16(0x0100);              // volume 1.0
+        b.zeros(10);
+        matrix(b);
+        b.zeros(24);
+        b.u32(2);                   // next track id
+        b.close(mvhd);
+
+        size_t trak = b.open("trak");
+        {
+            size_t tkhd = b.openFull("tkhd", 0, 0x000003);     // enabled, in movie
+            b.u32(0);
+            b.u32(0);
+            b.u32(1);               // track id
+            b.u32(0);
+            b.u32(0);               // duration
+            b.zeros(8);
+            b.u16(0);               // layer
+            b.u16(0);               // alternate group
+            b.u16(0);               // volume: video
+            b.u16(0);
+            matrix(b);
+            b.u32(static_cast<uint32_t>(track.iWidth) << 16);
+            b.u32(static_cast<uint32_t>(track.iHeight) << 16);
+            b.close(tkhd);
+
+            size_t mdia = b.open("mdia");
+            {
+                size_t mdhd = b.openFull("mdhd", 0, 0);
+                b.u32(0);
+                b.u32(0);
+                b.u32(FMP4_TIMESCALE);
+                b.u32(0);
+                b.u16(0x55C4);      // "und"
+                b.u16(0);
+                b.close(mdhd);
+
+                size_t hdlr = b.openFull("hdlr", 0, 0);
+                b.u32(0);
+                b.fourcc("vide");
+                b.zeros(12);
+                const char name[] = "VideoHandler";
+                b.bytes(reinterpret_cast<const uint8_t*>(name), sizeof(name));
+                b.close(hdlr);
+
+                size_t minf = b.open("minf");
+                {
+                    size_t vmhd = b.openFull("vmhd", 0, 1);
+                    b.zeros(8);     // graphics mode, opcolor
+                    b.close(vmhd);
+
+                    size_t dinf = b.open("dinf");
+                    size_t dref = b.openFull("dref", 0, 0);
+                    b.u32(1);
+                    size_t url = b.openFull("url ", 0, 1);         // media in the same file
+                    b.close(url);
+                    b.close(dref);
+                    b.close(dinf);
+
+                    size_t stbl = b.open("stbl");
+                    {
+                        size_t stsd = b.openFull("stsd", 0, 0);
+                        b.u32(1);
+                        size_t entry = b.open(track.sCodec == "hvc1" ? "hvc1" : "avc1");
+                        b.zeros(6);
+                        b.u16(1);           // data reference index
+                        b.zeros(16);
+                        b.u16(static_cast<uint16_t>(track.iWidth));
+                        b.u16(static_cast<uint16_t>(track.iHeight));
+                        b.u32(0x00480000);  // 72 dpi
+                        b.u32(0x00480000);
+                        b.u32(0);
+                        b.u16(1);           // frame count
+                        b.zeros(32);        // compressor name
+                        b.u16(0x0018);      // depth
+                        b.u16(0xFFFF);
+                        size_t config = b.open(track.sCodec == "hvc1" ? "hvcC" : "avcC");
+                        b.bytes(track.codecData.data(), track.codecData.size());
+                        b.close(config);
+                        b.close(entry);
+                        b.close(stsd);
+
+                        // Samples live in the fragments; the tables stay empty
+                        const char* empty[] = { "stts", "stsc", "stco" };
+                        for (const char* type : empty)
+                        {
+                            size_t box = b.openFull(type, 0, 0);
+                            b.u32(0);
+                            b.close(box);
+                        }
+                        size_t stsz = b.openFull("stsz", 0, 0);
+                        b.u32(0);
+                        b.u32(0);
+                        b.close(stsz);
+                    }
+                    b.close(stbl);
+                }
+                b.close(minf);
+            }
+            b.close(mdia);
+        }
+        b.close(trak);
+
+        size_t mvex = b.open("mvex");
+        size_t trex = b.openFull("trex", 0, 0);
+        b.u32(1);                   // track id
+        b.u32(1);                   // sample description index
+        b.u32(0);
+        b.u32(0);
+        b.u32(0);
+        b.close(trex);
+        b.close(mvex);
+    }
+    b.close(moov);
+    return out;
+}
+
+std::vector<uint8_t> Fmp4Writer::mediaSegment(uint32_t sequence, uint64_t baseDecodeTime,
+                                              const std::vector<Fmp4Sample>& samples)
+{
+    uint64_t payloadSize = 0;
+    for (const Fmp4Sample& sample : samples)
+    {
+        payloadSize += sample.iSize;
+    }
+
+    std::vector<uint8_t> out;
+    out.reserve(payloadSize + 128 + samples.size() * 16);
+    BoxBuffer b(out);
+
+    size_t moof = b.open("moof");
+    size_t mfhd = b.openFull("mfhd", 0, 0);
+    b.u32(sequence);
+    b.close(mfhd);
+
+    size_t traf = b.open("traf");
+    size_t tfhd = b.openFull("tfhd", 0, 0x020000);         // default-base-is-moof
+    b.u32(1);
+    b.close(tfhd);
+
+    size_t tfdt = b.openFull("tfdt", 1, 0);
+    b.u64(baseDecodeTime);
+    b.close(tfdt);
+
+    // data offset, duration, size, flags, signed composition offsets
+    size_t trun = b.openFull("trun", 1, 0x000001 | 0x000100 | 0x000200 | 0x000400 | 0x000800);
+    b.u32(static_cast<uint32_t>(samples.size()));
+    const size_t dataOffsetAt = b.size();
+    b.u32(0);
+    for (const Fmp4Sample& sample : samples)
+    {
+        b.u32(sample.iDuration);
+        b.u32(sample.iSize);
+        b.u32(sample.bKeyframe ? kSyncSampleFlags : kNonSyncSampleFlags);
+        b.u32(static_cast<uint32_t>(sample.iCompositionOffset));
+    }
+    b.close(trun);
+    b.close(traf);
+    b.close(moof);
+
+    // Offsets are from the start of moof to the first payload byte, past the mdat header
+    b.patch32(dataOffsetAt, static_cast<uint32_t>(b.size() - moof + 8));
+
+    b.u32(static_cast<uint32_t>(payloadSize + 8));
+    b.fourcc("mdat");
+    return out;
+}
@@ -0,0 +1,41 @@
+#ifndef FMP4_WRITER_H
+#define FMP4_WRITER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define FMP4_TIMESCALE  90000
+
+struct Fmp4TrackInfo
+{
+    std::string          sCodec;        // "avc1" or "hvc1"
+    std::vector<uint8_t> codecData;     // avcC / hvcC payload (the parser's codec_data)
+    int                  iWidth{0};
+    int                  iHeight{0};
+};
+
+struct Fmp4Sample
+{
+    uint32_t iDuration{0};              // FMP4_TIMESCALE ticks
+    uint32_t iSize{0};
+    int32_t  iCompositionOffset{0};     // pts - dts, ticks
+    bool     bKeyframe{false};
+};
+
+// Box writer for single-track CMAF video: one init segment (ftyp + moov with
+// an empty sample table and mvex), then self-contained moof + mdat fragments.
+// Samples are length-prefixed access units as the parser emits them with
+// stream-format avc / hvc1, so no payload is rewritten.
+class Fmp4Writer
+{
+public:
+    static std::vector<uint8_t> initSegment(const Fmp4TrackInfo& track);
+
+    // moof and the mdat header, with room reserved for the payload: append the
+    // samples' data after it, back to back in decode order
+    static std::vector<uint8_t> mediaSegment(uint32_t sequence, uint64_t baseDecodeTime,
+                                             const std::vector<Fmp4Sample>& samples);
+};
+
+#endif // FMP4_WRITER_H
@@ -0,0 +1,174 @@
+#include "FrameTap.h"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+FrameTapPtr FrameTap::create(size_t id, const FrameTapConfig& config, FrameCallback callback)
+{
+    FrameTapPtr tap = std::make_shared<FrameTap>(id, config, std::move(callback));
+    if (tap->m_callback)
+    {
+        tap->m_deliveryThread = std::thread(&FrameTap::deliveryLoop, std::weak_ptr<FrameTap>(tap));
+    }
+    return tap;
+}
+
+FrameTap::FrameTap(size_t id, const FrameTapConfig& config, FrameCallback callback)
+    : m_id(id), m_config(config), m_callback(std::move(callback))
+{
+}
+
+FrameTap::~FrameTap()
+{
+    close();
+}
+
+void FrameTap::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_bClosed.exchange(true))
+        {
+            return;
+        }
+        for (GstSample* sample : m_queue)
+        {
+            gst_sample_unref(sample);
+        }
+        m_queue.clear();
+    }
+    m_cv.notify_all();
+
+    if (m_deliveryThread.joinable() && m_deliveryThread.get_id() != std::this_thread::get_id())
+    {
+        m_deliveryThread.join();
+    }
+    else if (m_deliveryThread.joinable())
+    {
+        // Closed from inside its own callback; the loop holds a reference until it returns
+        m_deliveryThread.detach();
+    }
+}
+
+void FrameTap::offer(GstSample* sample)
+{
+    if (m_config.bKeyframesOnly && isDelta(sample))
+    {
+        return;
+    }
+
+    m_iOffered.fetch_add(1, std::memory_order_relaxed);
+
+    std::vector<GstSample*> evicted;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_bClosed)
+        {
+            return;
+        }
+
+        if (m_bAwaitKeyframe)
+        {
+            if (isDelta(sample))
+            {
+                m_iDropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            m_bAwaitKeyframe = false;
+        }
+
+        if (m_queue.size() >= std::max<size_t>(1, m_config.iMaxQueued))
+        {
+            m_iDropped.fetch_add(1, std::memory_order_relaxed);
+            if (m_config.eDrop == eFrameTapDrop::FRAME_TAP_DROP_NEWEST)
+            {
+                m_bAwaitKeyframe = m_config.bResyncOnDrop;
+                return;
+            }
+            evicted.push_back(m_queue.front());
+            m_queue.pop_front();
+
+            // The queued delta units referenced what was just dropped
+            if (m_config.bResyncOnDrop)
+            {
+                while (!m_queue.empty() && isDelta(m_queue.front()))
+                {
+                    m_iDropped.fetch_add(1, std::memory_order_relaxed);
+                    evicted.push_back(m_queue.front());
+                    m_queue.pop_front();
+                }
+                if (m_queue.empty() && isDelta(sample))
+                {
+                    m_iDropped.fetch_add(1, std::memory_order_relaxed);
+                    m_bAwaitKeyframe = true;
+                }
+            }
+        }
+        if (!m_bAwaitKeyframe)
+        {
+            m_queue.push_back(gst_sample_ref(sample));
+        }
+    }
+    m_cv.notify_one();
+
+    // Outside the lock: the last unref may hand the buffer back to the decoder pool
+    for (GstSample* dropped : evicted)
+    {
+        gst_sample_unref(dropped);
+    }
+}
+
+bool FrameTap::isDelta(GstSample* sample)
+{
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    return buffer && GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+}
+
+GstSample* FrameTap::pull(int timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_cv.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return m_bClosed || !m_queue.empty(); }) ||
+        m_queue.empty())
+    {
+        return nullptr;
+    }
+
+    GstSample* sample = m_queue.front();
+    m_queue.pop_front();
+    m_iDelivered.fetch_add(1, std::memory_order_relaxed);
+    return sample;
+}
+
+void FrameTap::deliveryLoop(std::weak_ptr<FrameTap> weak)
+{
+    // Dispatch holds its own reference, so a callback that drops the last owner does not
+    // free the tap or its callback under itself; the tap is destroyed on this thread when
+    // the reference goes at the end of the round, and the next lock() fails.
+    for (;;)
+    {
+        FrameTapPtr self = weak.lock();
+        if (!self || self->m_bClosed)
+        {
+            return;
+        }
+
+        GstSample* sample = self->pull(100);
+        if (sample)
+        {
+            self->m_callback(sample);
+            gst_sample_unref(sample);
+        }
+    }
+}
+
+FrameTapStats FrameTap::getStats() const
+{
+    FrameTapStats stats;
+    stats.iOffered   = m_iOffered.load(std::memory_order_relaxed);
+    stats.iDelivered = m_iDelivered.load(std::memory_order_relaxed);
+    stats.iDropped   = m_iDropped.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    stats.iQueued = m_queue.size();
+    return stats;
+}
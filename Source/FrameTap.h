@@ -0,0 +1,90 @@
+#ifndef FRAME_TAP_H
+#define FRAME_TAP_H
+
+#include <gst/gst.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "Enum.h"
+
+struct FrameTapConfig
+{
+    eFrameTapPoint ePoint{eFrameTapPoint::FRAME_TAP_ENCODED};
+    size_t         iMaxQueued{4};   // decoded frames hold decoder pool buffers, keep this small
+    eFrameTapDrop  eDrop{eFrameTapDrop::FRAME_TAP_DROP_OLDEST};
+    bool           bKeyframesOnly{false};   // encoded taps: only deliver keyframes
+    bool           bResyncOnDrop{false};    // encoded taps: after a drop, skip delta units up to the next keyframe
+    int            iRendition{-1};          // encoded taps on a ladder: rendition index, -1 = main stream
+};
+
+struct FrameTapStats
+{
+    uint64_t iOffered{0};
+    uint64_t iDelivered{0};
+    uint64_t iDropped{0};
+    size_t   iQueued{0};
+};
+
+class FrameTap;
+using FrameTapPtr = std::shared_ptr<FrameTap>;
+
+// Called on the tap's own thread. The sample is only borrowed for the call;
+// gst_sample_ref it to keep it longer.
+using FrameCallback = std::function<void(GstSample* sample)>;
+
+// One consumer's view of a pipeline's frames. Samples share the pipeline's buffers
+// (no copy). The pipeline thread only takes a short lock to queue a reference, and
+// a full queue drops per the policy, so a slow consumer never stalls the pipeline.
+class FrameTap
+{
+public:
+    // Callback taps need create(): the delivery thread keeps the tap alive while it dispatches
+    static FrameTapPtr create(size_t id, const FrameTapConfig& config, FrameCallback callback = nullptr);
+
+    FrameTap(size_t id, const FrameTapConfig& config, FrameCallback callback = nullptr);
+    ~FrameTap();
+
+    FrameTap(const FrameTap&) = delete;
+    FrameTap& operator=(const FrameTap&) = delete;
+
+    // Pull mode (no callback): next sample, owned by the caller; nullptr on timeout or close
+    GstSample* pull(int timeoutMs);
+
+    // Stops delivery and releases queued samples; the pipeline forgets the tap on its next frame
+    void close();
+    bool isClosed() const { return m_bClosed.load(); }
+
+    size_t id() const { return m_id; }
+    const FrameTapConfig& config() const { return m_config; }
+    FrameTapStats getStats() const;
+
+    // Streaming thread: queue a reference to sample
+    void offer(GstSample* sample);
+
+private:
+    static void deliveryLoop(std::weak_ptr<FrameTap> weak);
+    static bool isDelta(GstSample* sample);
+
+    const size_t            m_id;
+    const FrameTapConfig    m_config;
+    FrameCallback           m_callback;
+
+    mutable std::mutex      m_mutex;
+    std::condition_variable m_cv;
+    std::deque<GstSample*>  m_queue;
+    bool                    m_bAwaitKeyframe{false};    // bResyncOnDrop: a drop broke the reference chain
+    std::atomic<bool>       m_bClosed{false};
+    std::thread             m_deliveryThread;
+
+    std::atomic<uint64_t>   m_iOffered{0};
+    std::atomic<uint64_t>   m_iDelivered{0};
+    std::atomic<uint64_t>   m_iDropped{0};
+};
+
+#endif // FRAME_TAP_H
@@ -0,0 +1,322 @@
+#include "HlsOutput.h"
+#include "mx_logger.h"
+#include <gst/app/gstappsink.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#define HLS_STORE_SPARE_SEGMENTS    2       // kept past the playlist window for slow clients
+#define HLS_DEFAULT_FRAME_TICKS     3000    // 30 fps, when a duration cannot be derived
+
+///////////////////////////////////////////////    Segment store   //////////////////////////////////////////
+
+HlsSegmentStore::HlsSegmentStore(const HlsStoreConfig& config)
+    : m_config(config)
+{
+    m_config.iPlaylistSegments = std::max(m_config.iPlaylistSegments, 2);
+    m_iTargetDuration = static_cast<unsigned>(std::ceil(std::max(m_config.iTargetMs, 1000) / 1000.0));
+}
+
+void HlsSegmentStore::setInit(SegmentBytes init)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_init = std::move(init);
+    ++m_iGeneration;
+    m_iEvicted += m_segments.size();
+    m_segments.clear();
+    m_iBytes = 0;
+    rebuildPlaylistLocked();
+}
+
+void HlsSegmentStore::addSegment(SegmentBytes data, double durationSec)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Segment segment;
+    segment.sequence = m_iNextSequence++;
+    segment.durationSec = durationSec;
+    segment.data = std::move(data);
+
+    char entry[64];
+    snprintf(entry, sizeof(entry), "#EXTINF:%.3f,\nseg_%llu.m4s\n", durationSec,
+             static_cast<unsigned long long>(segment.sequence));
+    segment.entry = entry;
+
+    m_iTargetDuration = std::max(m_iTargetDuration, static_cast<unsigned>(std::lround(durationSec)));
+    m_iBytes += segment.data->size();
+    m_segments.push_back(std::move(segment));
+
+    const size_t maxSegments = static_cast<size_t>(m_config.iPlaylistSegments) + HLS_STORE_SPARE_SEGMENTS;
+    while (m_segments.size() > 1 && (m_segments.size() > maxSegments || m_iBytes > m_config.iMaxBytes))
+    {
+        m_iBytes -= m_segments.front().data->size();
+        m_segments.pop_front();
+        ++m_iEvicted;
+    }
+    rebuildPlaylistLocked();
+}
+
+void HlsSegmentStore::rebuildPlaylistLocked()
+{
+    if (!m_init || m_segments.empty())
+    {
+        m_sPlaylist.clear();
+        return;
+    }
+
+    // Only the last iPlaylistSegments are advertised; the spare ones stay fetchable
+    const size_t listed = std::min(m_segments.size(), static_cast<size_t>(m_config.iPlaylistSegments));
+    const size_t first = m_segments.size() - listed;
+
+    std::string playlist;
+    playlist.reserve(160 + listed * 32);
+    playlist += "#EXTM3U\n#EXT-X-VERSION:7\n";
+    playlist += "#EXT-X-TARGETDURATION:" + std::to_string(m_iTargetDuration) + "\n";
+    playlist += "#EXT-X-MEDIA-SEQUENCE:" + std::to_string(m_segments[first].sequence) + "\n";
+    playlist += "#EXT-X-DISCONTINUITY-SEQUENCE:" + std::to_string(m_iGeneration - 1) + "\n";
+    playlist += "#EXT-X-INDEPENDENT-SEGMENTS\n";
+    playlist += "#EXT-X-MAP:URI=\"init_" + std::to_string(m_iGeneration) + ".mp4\"\n";
+    for (size_t i = first; i < m_segments.size(); ++i)
+    {
+        playlist += m_segments[i].entry;
+    }
+    m_sPlaylist = std::move(playlist);
+}
+
+std::string HlsSegmentStore::playlist() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sPlaylist;
+}
+
+SegmentBytes HlsSegmentStore::get(const std::string& name) const
+{
+    unsigned generation = 0;
+    unsigned long long sequence = 0;
+    char tail = 0;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (sscanf(name.c_str(), "init_%u.mp%c", &generation, &tail) == 2 && tail == '4')
+    {
+        return generation == m_iGeneration ? m_init : nullptr;
+    }
+    if (sscanf(name.c_str(), "seg_%llu.m4%c", &sequence, &tail) == 2 && tail == 's' && !m_segments.empty())
+    {
+        const uint64_t front = m_segments.front().sequence;
+        if (sequence >= front && sequence - front < m_segments.size())
+        {
+            return m_segments[sequence - front].data;
+        }
+    }
+    return nullptr;
+}
+
+HlsStoreSnapshot HlsSegmentStore::snapshot() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    HlsStoreSnapshot snapshot;
+    snapshot.iSegments = m_segments.size();
+    snapshot.iBytes = m_iBytes;
+    snapshot.iFirstSequence = m_segments.empty() ? 0 : m_segments.front().sequence;
+    snapshot.iLastSequence = m_segments.empty() ? 0 : m_segments.back().sequence;
+    snapshot.iEvicted = m_iEvicted;
+    snapshot.iInitGeneration = m_iGeneration;
+    return snapshot;
+}
+
+///////////////////////////////////////////////    Packager   //////////////////////////////////////////
+
+HlsPackager::HlsPackager(std::shared_ptr<HlsSegmentStore> store, int targetMs)
+    : m_store(std::move(store)),
+      m_iTargetTicks(static_cast<uint64_t>(std::max(targetMs, 100)) * FMP4_TIMESCALE / 1000)
+{
+}
+
+HlsPackager::~HlsPackager()
+{
+    detach();
+}
+
+GstElement* HlsPackager::createSink(eVideoCodec codec, const char* name)
+{
+    const char* caps = codec == eVideoCodec::VIDEO_CODEC_H264 ? "video/x-h264,stream-format=avc,alignment=au" :
+                      (codec == eVideoCodec::VIDEO_CODEC_H265 ? "video/x-h265,stream-format=hvc1,alignment=au" : nullptr);
+    if (!caps)
+    {
+        MX_LOG_ERROR("HlsPackager", "HLS output supports H.264 and H.265 only");
+        return nullptr;
+    }
+
+    GstElement* appsink = gst_element_factory_make("appsink", name);
+    if (!appsink)
+    {
+        return nullptr;
+    }
+
+    // Length-prefixed access units with codec_data: samples go into mdat as they are
+    GstCaps* sinkCaps = gst_caps_from_string(caps);
+    g_object_set(G_OBJECT(appsink), "caps", sinkCaps, "emit-signals", TRUE, "sync", FALSE, NULL);
+    gst_caps_unref(sinkCaps);
+
+    m_appsink = appsink;
+    m_signalId = g_signal_connect(appsink, "new-sample", G_CALLBACK(&HlsPackager::onNewSample), this);
+    return appsink;
+}
+
+void HlsPackager::detach()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_appsink && m_signalId)
+    {
+        g_signal_handler_disconnect(m_appsink, m_signalId);
+    }
+    m_appsink = nullptr;
+    m_signalId = 0;
+    clearLocked();
+    if (m_caps)
+    {
+        gst_caps_unref(m_caps);
+        m_caps = nullptr;
+    }
+}
+
+GstFlowReturn HlsPackager::onNewSample(GstElement* appsink, gpointer data)
+{
+    GstSample* sample = gst_app_sink_pull_sample(GST_APP_SINK(appsink));
+    if (sample)
+    {
+        static_cast<HlsPackager*>(data)->push(sample);
+        gst_sample_unref(sample);
+    }
+    return GST_FLOW_OK;
+}
+
+void HlsPackager::push(GstSample* sample)
+{
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    GstCaps* caps = gst_sample_get_caps(sample);
+    if (!buffer || !caps)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_caps || !gst_caps_is_equal(caps, m_caps))
+    {
+        // New codec data needs a new init segment, and the fragment in progress refers to the old one
+        clearLocked();
+        m_bHaveBase = false;
+        if (!updateTrackLocked(caps))
+        {
+            return;
+        }
+    }
+
+    const GstClockTime dts = GST_BUFFER_DTS_IS_VALID(buffer) ? GST_BUFFER_DTS(buffer) : GST_BUFFER_PTS(buffer);
+    if (!GST_CLOCK_TIME_IS_VALID(dts))
+    {
+        return;
+    }
+    const bool bKeyframe = !GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+
+    // Fragments, and so the stream, start on a keyframe
+    if (!m_bHaveBase)
+    {
+        if (!bKeyframe)
+        {
+            return;
+        }
+        m_base = dts;
+        m_bHaveBase = true;
+    }
+    if (dts < m_base)
+    {
+        return;
+    }
+
+    Pending pending;
+    pending.dts = gst_util_uint64_scale(dts - m_base, FMP4_TIMESCALE, GST_SECOND);
+    if (GST_BUFFER_PTS_IS_VALID(buffer) && GST_BUFFER_PTS(buffer) >= m_base)
+    {
+        const uint64_t pts = gst_util_uint64_scale(GST_BUFFER_PTS(buffer) - m_base, FMP4_TIMESCALE, GST_SECOND);
+        pending.cto = static_cast<int32_t>(static_cast<int64_t>(pts) - static_cast<int64_t>(pending.dts));
+    }
+    pending.bKeyframe = bKeyframe;
+
+    if (bKeyframe && !m_pending.empty() && pending.dts - m_pending.front().dts >= m_iTargetTicks)
+    {
+        flushLocked(pending.dts);
+    }
+    pending.buffer = gst_buffer_ref(buffer);
+    m_pending.push_back(pending);
+}
+
+bool HlsPackager::updateTrackLocked(GstCaps* caps)
+{
+    const GstStructure* s = gst_caps_get_structure(caps, 0);
+    const GValue* codecData = gst_structure_get_value(s, "codec_data");
+    if (!codecData)
+    {
+        MX_LOG_WARN("HlsPackager", "Stream caps carry no codec_data, waiting for the parser");
+        return false;
+    }
+
+    Fmp4TrackInfo track;
+    track.sCodec = gst_structure_has_name(s, "video/x-h265") ? "hvc1" : "avc1";
+    gst_structure_get_int(s, "width", &track.iWidth);
+    gst_structure_get_int(s, "height", &track.iHeight);
+
+    GstBuffer* codecBuffer = gst_value_get_buffer(codecData);
+    GstMapInfo map;
+    if (!codecBuffer || !gst_buffer_map(codecBuffer, &map, GST_MAP_READ))
+    {
+        return false;
+    }
+    track.codecData.assign(map.data, map.data + map.size);
+    gst_buffer_unmap(codecBuffer, &map);
+
+    gst_caps_replace(&m_caps, caps);
+    m_sCodec = track.sCodec;
+    m_store->setInit(std::make_shared<const std::vector<uint8_t>>(Fmp4Writer::initSegment(track)));
+    MX_LOG_INFO("HlsPackager", ("Init segment for " + m_sCodec + " " + std::to_string(track.iWidth) + "x" +
+                                std::to_string(track.iHeight)).c_str());
+    return true;
+}
+
+void HlsPackager::flushLocked(uint64_t nextDts)
+{
+    std::vector<Fmp4Sample> samples(m_pending.size());
+    for (size_t i = 0; i < m_pending.size(); ++i)
+    {
+        const uint64_t end = i + 1 < m_pending.size() ? m_pending[i + 1].dts : nextDts;
+        uint64_t duration = end > m_pending[i].dts ? end - m_pending[i].dts : 0;
+        if (duration == 0)
+        {
+            duration = i > 0 ? samples[i - 1].iDuration : HLS_DEFAULT_FRAME_TICKS;
+        }
+        samples[i].iDuration = static_cast<uint32_t>(duration);
+        samples[i].iSize = static_cast<uint32_t>(gst_buffer_get_size(m_pending[i].buffer));
+        samples[i].iCompositionOffset = m_pending[i].cto;
+        samples[i].bKeyframe = m_pending[i].bKeyframe;
+    }
+
+    std::vector<uint8_t> fragment = Fmp4Writer::mediaSegment(m_iSequence++, m_pending.front().dts, samples);
+    for (const Pending& pending : m_pending)
+    {
+        const size_t at = fragment.size();
+        fragment.resize(at + gst_buffer_get_size(pending.buffer));
+        gst_buffer_extract(pending.buffer, 0, fragment.data() + at, fragment.size() - at);
+    }
+
+    const double durationSec = static_cast<double>(nextDts - m_pending.front().dts) / FMP4_TIMESCALE;
+    clearLocked();
+    m_store->addSegment(std::make_shared<const std::vector<uint8_t>>(std::move(fragment)), durationSec);
+}
+
+void HlsPackager::clearLocked()
+{
+    for (Pending& pending : m_pending)
+    {
+        gst_buffer_unref(pending.buffer);
+    }
+    m_pending.clear();
+}
@@ -0,0 +1,122 @@
+#ifndef HLS_OUTPUT_H
+#define HLS_OUTPUT_H
+
+#include <gst/gst.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Enum.h"
+#include "Fmp4Writer.h"
+
+using SegmentBytes = std::shared_ptr<const std::vector<uint8_t>>;
+
+struct HlsStoreConfig
+{
+    int    iTargetMs{2000};             // segments are cut at the first keyframe past this
+    int    iPlaylistSegments{6};        // live window advertised in the playlist
+    size_t iMaxBytes{32 * 1024 * 1024}; // store cap; the oldest segments go first
+};
+
+struct HlsStoreSnapshot
+{
+    size_t   iSegments{0};
+    size_t   iBytes{0};
+    uint64_t iFirstSequence{0};
+    uint64_t iLastSequence{0};
+    uint64_t iEvicted{0};
+    unsigned iInitGeneration{0};
+};
+
+// Bounded in-memory segment store for one stream. The playlist is kept as a
+// cached text that is patched as segments come and go, so serving it is a
+// string copy. A couple of segments past the advertised window stay readable
+// for clients that fetched the playlist just before it moved.
+class HlsSegmentStore
+{
+public:
+    explicit HlsSegmentStore(const HlsStoreConfig& config);
+
+    // A new init segment (caps change) starts a new generation and drops the old segments
+    void setInit(SegmentBytes init);
+    void addSegment(SegmentBytes data, double durationSec);
+
+    // Resource names are the ones the playlist refers to: init_<gen>.mp4, seg_<seq>.m4s
+    std::string playlist() const;
+    SegmentBytes get(const std::string& name) const;
+
+    HlsStoreSnapshot snapshot() const;
+
+private:
+    struct Segment
+    {
+        uint64_t     sequence{0};
+        double       durationSec{0.0};
+        SegmentBytes data;
+        std::string  entry;             // its playlist lines
+    };
+
+    void rebuildPlaylistLocked();
+
+    HlsStoreConfig      m_config;
+    mutable std::mutex  m_mutex;
+    SegmentBytes        m_init;
+    unsigned            m_iGeneration{0};
+    std::deque<Segment> m_segments;
+    size_t              m_iBytes{0};
+    uint64_t            m_iNextSequence{0};
+    uint64_t            m_iEvicted{0};
+    unsigned            m_iTargetDuration{1};   // never decreases, as the spec requires
+    std::string         m_sPlaylist;
+};
+
+// Cuts the parser's access units (stream-format avc / hvc1, alignment au) into
+// CMAF fragments on keyframes and stores them. No decode, no re-encode: the
+// payload bytes are only copied once, into the fragment.
+class HlsPackager
+{
+public:
+    explicit HlsPackager(std::shared_ptr<HlsSegmentStore> store, int targetMs);
+    ~HlsPackager();
+
+    HlsPackager(const HlsPackager&) = delete;
+    HlsPackager& operator=(const HlsPackager&) = delete;
+
+    // appsink with the caps to negotiate; its new-sample signal drives the packager
+    GstElement* createSink(eVideoCodec codec, const char* name = "sink");
+    void detach();
+
+    std::shared_ptr<HlsSegmentStore> store() const { return m_store; }
+
+private:
+    struct Pending
+    {
+        GstBuffer* buffer{nullptr};
+        uint64_t   dts{0};              // ticks since the stream base
+        int32_t    cto{0};
+        bool       bKeyframe{false};
+    };
+
+    static GstFlowReturn onNewSample(GstElement* appsink, gpointer data);
+    void push(GstSample* sample);
+    bool updateTrackLocked(GstCaps* caps);
+    void flushLocked(uint64_t nextDts);
+    void clearLocked();
+
+    std::shared_ptr<HlsSegmentStore> m_store;
+    const uint64_t      m_iTargetTicks;
+    std::mutex          m_mutex;
+    GstElement*         m_appsink{nullptr};
+    gulong              m_signalId{0};
+    GstCaps*            m_caps{nullptr};
+    std::string         m_sCodec;
+    bool                m_bHaveBase{false};
+    GstClockTime        m_base{0};
+    std::vector<Pending> m_pending;     // current fragment, starts on a keyframe
+    uint32_t            m_iSequence{1};
+};
+
+#endif // HLS_OUTPUT_H
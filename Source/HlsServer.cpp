@@ -0,0 +1,350 @@
+#include "HlsServer.h"
+#include "mx_logger.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#define HLS_REQUEST_MAX_BYTES   8192
+#define HLS_ACCEPT_POLL_MS      200
+#define HLS_MAX_QUEUED_CONNS    256
+
+HlsServer& HlsServer::instance()
+{
+    static HlsServer server;
+    return server;
+}
+
+HlsServer::~HlsServer()
+{
+    stop();
+}
+
+void HlsServer::setConfig(const HlsServerConfig& config)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_config = config;
+}
+
+HlsServerConfig HlsServer::getConfig() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_config;
+}
+
+bool HlsServer::publish(const std::string& name, std::shared_ptr<HlsSegmentStore> store)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!startLocked())
+    {
+        return false;
+    }
+    m_streams[name] = std::move(store);
+    MX_LOG_INFO("HlsServer", ("Publishing /hls/" + name + "/index.m3u8").c_str());
+    return true;
+}
+
+void HlsServer::unpublish(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_streams.erase(name);
+    m_masters.erase(name);
+}
+
+bool HlsServer::publishMaster(const std::string& name, const std::string& playlist)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!startLocked())
+    {
+        return false;
+    }
+    m_masters[name] = playlist;
+    MX_LOG_INFO("HlsServer", ("Publishing /hls/" + name + "/master.m3u8").c_str());
+    return true;
+}
+
+HlsServerSnapshot HlsServer::getSnapshot()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    HlsServerSnapshot snapshot;
+    snapshot.bRunning = m_bRunning;
+    snapshot.iPort = m_bRunning ? m_config.iPort : 0;
+    snapshot.iStreams = m_streams.size();
+    snapshot.iRequests = m_iRequests;
+    snapshot.iNotFound = m_iNotFound;
+    snapshot.iBytesSent = m_iBytesSent;
+    return snapshot;
+}
+
+///////////////////////////////////////////////    Server   //////////////////////////////////////////
+
+bool HlsServer::startLocked()
+{
+    if (m_bRunning)
+    {
+        return true;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(m_config.iPort));
+    if (inet_pton(AF_INET, m_config.sAddress.c_str(), &addr.sin_addr) != 1)
+    {
+        MX_LOG_ERROR("HlsServer", ("Invalid listen address " + m_config.sAddress).c_str());
+        return false;
+    }
+
+    m_listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    const int reuse = 1;
+    if (m_listenFd < 0 || setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+        bind(m_listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(m_listenFd, SOMAXCONN) != 0)
+    {
+        MX_LOG_ERROR("HlsServer", ("Cannot listen on " + m_config.sAddress + ":" + std::to_string(m_config.iPort) +
+                                   ": " + strerror(errno)).c_str());
+        if (m_listenFd >= 0)
+        {
+            close(m_listenFd);
+            m_listenFd = -1;
+        }
+        return false;
+    }
+
+    m_bRunning = true;
+    m_acceptThread = std::thread(&HlsServer::acceptLoop, this);
+    const unsigned workers = std::max(m_config.iWorkers, 1u);
+    for (unsigned i = 0; i < workers; ++i)
+    {
+        m_workers.emplace_back(&HlsServer::workerLoop, this);
+    }
+
+    MX_LOG_INFO("HlsServer", ("HLS server listening on " + m_config.sAddress + ":" + std::to_string(m_config.iPort)).c_str());
+    return true;
+}
+
+void HlsServer::stop()
+{
+    std::thread acceptThread;
+    std::vector<std::thread> workers;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_bRunning)
+        {
+            return;
+        }
+        m_bRunning = false;
+        m_streams.clear();
+        m_masters.clear();
+        acceptThread = std::move(m_acceptThread);
+        workers.swap(m_workers);
+    }
+    m_cv.notify_all();
+
+    if (acceptThread.joinable())
+    {
+        acceptThread.join();
+    }
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (int fd : m_connections)
+    {
+        close(fd);
+    }
+    m_connections.clear();
+    close(m_listenFd);
+    m_listenFd = -1;
+    MX_LOG_INFO("HlsServer", "HLS server stopped");
+}
+
+void HlsServer::acceptLoop()
+{
+    pollfd pfd{m_listenFd, POLLIN, 0};
+    while (m_bRunning)
+    {
+        if (poll(&pfd, 1, HLS_ACCEPT_POLL_MS) <= 0 || !(pfd.revents & POLLIN))
+        {
+            continue;
+        }
+        const int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        timeval timeout{};
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            timeout.tv_sec = m_config.iIoTimeoutMs / 1000;
+            timeout.tv_usec = (m_config.iIoTimeoutMs % 1000) * 1000;
+            if (m_connections.size() >= HLS_MAX_QUEUED_CONNS)
+            {
+                close(fd);
+                continue;
+            }
+        }
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_connections.push_back(fd);
+        }
+        m_cv.notify_one();
+    }
+}
+
+void HlsServer::workerLoop()
+{
+    while (true)
+    {
+        int fd = -1;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] { return !m_bRunning || !m_connections.empty(); });
+            if (!m_bRunning)
+            {
+                return;
+            }
+            fd = m_connections.front();
+            m_connections.pop_front();
+        }
+        handle(fd);
+        close(fd);
+    }
+}
+
+///////////////////////////////////////////////    Requests   //////////////////////////////////////////
+
+void HlsServer::handle(int fd)
+{
+    // Only the request line matters; headers are read up to the blank line and ignored
+    std::string request;
+    char chunk[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < HLS_REQUEST_MAX_BYTES)
+    {
+        const ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0)
+        {
+            return;
+        }
+        request.append(chunk, static_cast<size_t>(n));
+    }
+    ++m_iRequests;
+
+    char method[8] = {0};
+    char target[512] = {0};
+    if (sscanf(request.c_str(), "%7s %511s", method, target) != 2)
+    {
+        respond(fd, 400, "Bad Request", "text/plain", "no-store", nullptr, 0, false);
+        return;
+    }
+    const bool bHead = strcmp(method, "HEAD") == 0;
+    if (!bHead && strcmp(method, "GET") != 0)
+    {
+        respond(fd, 405, "Method Not Allowed", "text/plain", "no-store", nullptr, 0, false);
+        return;
+    }
+
+    // /hls/<name>/<resource>, query string ignored
+    std::string path(target);
+    path = path.substr(0, path.find('?'));
+    const std::string prefix = "/hls/";
+    const size_t slash = path.find('/', prefix.size());
+    if (path.compare(0, prefix.size(), prefix) != 0 || slash == std::string::npos)
+    {
+        ++m_iNotFound;
+        respond(fd, 404, "Not Found", "text/plain", "no-store", nullptr, 0, bHead);
+        return;
+    }
+    const std::string name = path.substr(prefix.size(), slash - prefix.size());
+    const std::string resource = path.substr(slash + 1);
+
+    std::shared_ptr<HlsSegmentStore> store;
+    std::string master;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_streams.find(name);
+        if (it != m_streams.end())
+        {
+            store = it->second;
+        }
+        auto masterIt = m_masters.find(name);
+        if (resource == "master.m3u8" && masterIt != m_masters.end())
+        {
+            master = masterIt->second;
+        }
+    }
+
+    if (!master.empty())
+    {
+        respond(fd, 200, "OK", "application/vnd.apple.mpegurl", "no-cache", master.data(), master.size(), bHead);
+        return;
+    }
+    if (store && resource == "index.m3u8")
+    {
+        const std::string playlist = store->playlist();
+        if (!playlist.empty())
+        {
+            respond(fd, 200, "OK", "application/vnd.apple.mpegurl", "no-cache", playlist.data(), playlist.size(), bHead);
+            return;
+        }
+    }
+    else if (store)
+    {
+        // Segments never change once published, so clients and proxies may keep them
+        if (SegmentBytes data = store->get(resource))
+        {
+            const bool bInit = resource.compare(0, 5, "init_") == 0;
+            respond(fd, 200, "OK", bInit ? "video/mp4" : "video/iso.segment", "max-age=60",
+                    data->data(), data->size(), bHead);
+            return;
+        }
+    }
+
+    ++m_iNotFound;
+    respond(fd, 404, "Not Found", "text/plain", "no-store", nullptr, 0, bHead);
+}
+
+void HlsServer::respond(int fd, int status, const char* reason, const char* contentType,
+                        const char* cacheControl, const void* body, size_t size, bool bHead)
+{
+    // Browser players load from other origins
+    char header[512];
+    const int length = snprintf(header, sizeof(header),
+                                "HTTP/1.1 %d %s\r\n"
+                                "Content-Type: %s\r\n"
+                                "Content-Length: %zu\r\n"
+                                "Cache-Control: %s\r\n"
+                                "Access-Control-Allow-Origin: *\r\n"
+                                "Connection: close\r\n\r\n",
+                                status, reason, contentType, size, cacheControl);
+    if (!sendAll(fd, header, static_cast<size_t>(length)) || bHead || size == 0)
+    {
+        return;
+    }
+    sendAll(fd, body, size);
+}
+
+bool HlsServer::sendAll(int fd, const void* data, size_t size)
+{
+    const char* at = static_cast<const char*>(data);
+    while (size > 0)
+    {
+        const ssize_t n = send(fd, at, size, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            return false;
+        }
+        at += n;
+        size -= static_cast<size_t>(n);
+        m_iBytesSent += static_cast<uint64_t>(n);
+    }
+    return true;
+}
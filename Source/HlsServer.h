@@ -0,0 +1,87 @@
+#ifndef HLS_SERVER_H
+#define HLS_SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "HlsOutput.h"
+
+struct HlsServerConfig
+{
+    std::string sAddress{"0.0.0.0"};
+    int         iPort{8080};        // read when the server starts
+    unsigned    iWorkers{4};        // concurrent requests; every response closes its connection
+    int         iIoTimeoutMs{5000}; // a stalled client gives its worker back after this
+};
+
+struct HlsServerSnapshot
+{
+    bool     bRunning{false};
+    int      iPort{0};
+    size_t   iStreams{0};
+    uint64_t iRequests{0};
+    uint64_t iNotFound{0};
+    uint64_t iBytesSent{0};
+};
+
+// Process-wide HTTP endpoint for the HLS outputs. Every pipeline publishes its
+// segment store under /hls/<pipeline id>/, and requests are answered from
+// memory: index.m3u8, init_<gen>.mp4 and seg_<seq>.m4s, plus master.m3u8 for a
+// pipeline that publishes a rendition ladder. A viewer costs a few
+// reads of already-built segments, never a pipeline.
+class HlsServer
+{
+public:
+    static HlsServer& instance();
+
+    void setConfig(const HlsServerConfig& config);
+    HlsServerConfig getConfig() const;
+
+    // Starts the server on first use
+    bool publish(const std::string& name, std::shared_ptr<HlsSegmentStore> store);
+    void unpublish(const std::string& name);
+
+    // Multivariant playlist served as /hls/<name>/master.m3u8, for rendition ladders
+    bool publishMaster(const std::string& name, const std::string& playlist);
+
+    HlsServerSnapshot getSnapshot();
+
+    // Closes the listening socket and joins the threads; published streams are dropped
+    void stop();
+
+private:
+    HlsServer() = default;
+    ~HlsServer();
+
+    bool startLocked();
+    void acceptLoop();
+    void workerLoop();
+    void handle(int fd);
+    bool sendAll(int fd, const void* data, size_t size);
+    void respond(int fd, int status, const char* reason, const char* contentType,
+                 const char* cacheControl, const void* body, size_t size, bool bHead);
+
+    mutable std::mutex      m_mutex;
+    HlsServerConfig         m_config;
+    std::unordered_map<std::string, std::shared_ptr<HlsSegmentStore>> m_streams;
+    std::unordered_map<std::string, std::string> m_masters;
+
+    int                     m_listenFd{-1};
+    std::atomic<bool>       m_bRunning{false};
+    std::thread             m_acceptThread;
+    std::vector<std::thread> m_workers;
+    std::deque<int>         m_connections;
+    std::condition_variable m_cv;
+
+    std::atomic<uint64_t>   m_iRequests{0};
+    std::atomic<uint64_t>   m_iNotFound{0};
+    std::atomic<uint64_t>   m_iBytesSent{0};
+};
+
+#endif // HLS_SERVER_H
@@ -0,0 +1,53 @@
+#include "HostStats.h"
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+bool HostStats::readCpuTimes(unsigned long long& idle, unsigned long long& total)
+{
+    // Aggregate "cpu" line: user nice system idle iowait irq softirq steal
+    std::ifstream stat("/proc/stat");
+    if (!stat.is_open())
+    {
+        return false;
+    }
+
+    std::string line;
+    std::getline(stat, line);
+
+    unsigned long long user = 0, nice = 0, system = 0, idleTime = 0, iowait = 0, irq = 0, softirq = 0, steal = 0;
+    if (sscanf(line.c_str(), "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+               &user, &nice, &system, &idleTime, &iowait, &irq, &softirq, &steal) < 4)
+    {
+        return false;
+    }
+
+    idle  = idleTime + iowait;
+    total = user + nice + system + idleTime + iowait + irq + softirq + steal;
+    return true;
+}
+
+bool HostStats::readMemInfo(unsigned long& totalKB, unsigned long& availableKB)
+{
+    totalKB = 0;
+    availableKB = 0;
+    std::ifstream meminfo("/proc/meminfo");
+    if (!meminfo.is_open())
+    {
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(meminfo, line))
+    {
+        if (line.find("MemTotal:") == 0)
+        {
+            sscanf(line.c_str(), "MemTotal: %lu", &totalKB);
+        }
+        else if (line.find("MemAvailable:") == 0)
+        {
+            sscanf(line.c_str(), "MemAvailable: %lu", &availableKB);
+        }
+    }
+    return totalKB > 0;
+}
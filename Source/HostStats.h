@@ -0,0 +1,16 @@
+#ifndef HOST_STATS_H
+#define HOST_STATS_H
+
+// Host counters from /proc, shared by admission control and the system info log.
+// Both return false where /proc is not available (non-Linux hosts).
+class HostStats
+{
+public:
+    // Aggregate jiffies from the "cpu" line of /proc/stat; idle includes iowait
+    static bool readCpuTimes(unsigned long long& idle, unsigned long long& total);
+
+    // MemTotal and MemAvailable from /proc/meminfo, in kB
+    static bool readMemInfo(unsigned long& totalKB, unsigned long& availableKB);
+};
+
+#endif // HOST_STATS_H
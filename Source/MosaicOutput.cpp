@@ -0,0 +1,411 @@
+#include "MosaicOutput.h"
+#include "mx_logger.h"
+#include <gst/app/gstappsrc.h>
+#include <algorithm>
+
+#define MOSAIC_DEFAULT_GRID     4
+#define MOSAIC_APPSRC_BUFFERS   2       // decoded frames hold the camera decoder's pool buffers
+
+MosaicLayout MosaicLayout::grid(int columns, int rows, int width, int height)
+{
+    MosaicLayout layout;
+    layout.iWidth = width;
+    layout.iHeight = height;
+    columns = std::max(columns, 1);
+    rows = std::max(rows, 1);
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int column = 0; column < columns; ++column)
+        {
+            // Edges come from the running product so the last tile closes the surface exactly
+            MosaicTile tile;
+            tile.iX = column * width / columns;
+            tile.iY = row * height / rows;
+            tile.iWidth = (column + 1) * width / columns - tile.iX;
+            tile.iHeight = (row + 1) * height / rows - tile.iY;
+            layout.vTiles.push_back(tile);
+        }
+    }
+    return layout;
+}
+
+MosaicOutput& MosaicOutput::instance()
+{
+    static MosaicOutput output;
+    return output;
+}
+
+MosaicOutput::~MosaicOutput()
+{
+    stop();
+}
+
+///////////////////////////////////////////////    Walls   //////////////////////////////////////////
+
+bool MosaicOutput::setLayout(const std::string& wall, const MosaicLayout& layout)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_walls.find(wall);
+    if (it == m_walls.end())
+    {
+        Wall created;
+        created.layout = layout;
+        if (!buildWallLocked(wall, created))
+        {
+            return false;
+        }
+        m_walls.emplace(wall, std::move(created));
+        return true;
+    }
+
+    Wall& existing = it->second;
+    existing.layout = layout;
+    applyOutputLocked(existing);
+    for (auto& [tile, feeder] : existing.tiles)
+    {
+        applyTileLocked(existing, tile, feeder->pad);
+    }
+    MX_LOG_INFO("MosaicOutput", ("wall " + wall + " laid out with " + std::to_string(layout.vTiles.size()) + " tiles").c_str());
+    return true;
+}
+
+Resolution MosaicOutput::tileSize(const std::string& wall, int tile) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Resolution size;
+    auto it = m_walls.find(wall);
+    if (it != m_walls.end() && tile >= 0 && tile < static_cast<int>(it->second.layout.vTiles.size()))
+    {
+        size.width = it->second.layout.vTiles[tile].iWidth;
+        size.height = it->second.layout.vTiles[tile].iHeight;
+    }
+    return size;
+}
+
+bool MosaicOutput::buildWallLocked(const std::string& name, Wall& wall)
+{
+    wall.pipeline = gst_pipeline_new(("mosaic-" + name).c_str());
+    wall.compositor = gst_element_factory_make("compositor", "compositor");
+    wall.capsfilter = gst_element_factory_make("capsfilter", "surface");
+    GstElement* convert = gst_element_factory_make("videoconvert", "convert");
+    GstElement* sink = gst_element_factory_make("autovideosink", "display");
+
+    if (!wall.pipeline || !wall.compositor || !wall.capsfilter || !convert || !sink)
+    {
+        MX_LOG_ERROR("MosaicOutput", ("failed to create wall " + name).c_str());
+        // Elements not yet in the bin are still floating; sink them before dropping them
+        for (GstElement* element : {wall.compositor, wall.capsfilter, convert, sink})
+        {
+            if (element)
+            {
+                gst_object_unref(gst_object_ref_sink(element));
+            }
+        }
+        if (wall.pipeline)
+        {
+            gst_object_unref(wall.pipeline);
+        }
+        wall = Wall();
+        return false;
+    }
+
+    // A camera that stops sending keeps its last picture instead of holding the whole wall back
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(wall.compositor), "ignore-inactive-pads"))
+    {
+        g_object_set(wall.compositor, "ignore-inactive-pads", TRUE, nullptr);
+    }
+
+    // Nothing else in the process pops this bus; log what matters and drop the rest
+    GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(wall.pipeline));
+    gst_bus_set_sync_handler(bus, &MosaicOutput::busHandler, g_strdup(name.c_str()), g_free);
+    gst_object_unref(bus);
+
+    gst_bin_add_many(GST_BIN(wall.pipeline), wall.compositor, wall.capsfilter, convert, sink, nullptr);
+    applyOutputLocked(wall);
+    if (!gst_element_link_many(wall.compositor, wall.capsfilter, convert, sink, nullptr) ||
+        gst_element_set_state(wall.pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+    {
+        MX_LOG_ERROR("MosaicOutput", ("failed to start wall " + name).c_str());
+        destroy(wall);
+        return false;
+    }
+
+    MX_LOG_INFO("MosaicOutput", ("wall " + name + " started, " + std::to_string(wall.layout.iWidth) + "x" +
+                std::to_string(wall.layout.iHeight) + " with " + std::to_string(wall.layout.vTiles.size()) + " tiles").c_str());
+    return true;
+}
+
+void MosaicOutput::applyOutputLocked(Wall& wall)
+{
+    const MosaicLayout& layout = wall.layout;
+    const int fps = std::max(layout.iFrameRate, 1);
+
+    // A new surface size renegotiates downstream of the compositor only
+    GstCaps* caps = gst_caps_new_simple("video/x-raw",
+                                        "width", G_TYPE_INT, std::max(layout.iWidth, 16),
+                                        "height", G_TYPE_INT, std::max(layout.iHeight, 16),
+                                        "framerate", GST_TYPE_FRACTION, fps, 1, nullptr);
+    g_object_set(wall.capsfilter, "caps", caps, nullptr);
+    gst_caps_unref(caps);
+
+    // One frame of slack for late cameras before a surface goes out without their update
+    g_object_set(wall.compositor, "latency", static_cast<guint64>(GST_SECOND / fps), nullptr);
+    gst_util_set_object_arg(G_OBJECT(wall.compositor), "background", layout.sBackground.c_str());
+}
+
+void MosaicOutput::applyTileLocked(const Wall& wall, int tile, GstPad* pad)
+{
+    if (tile < 0 || tile >= static_cast<int>(wall.layout.vTiles.size()))
+    {
+        // Off the layout: keep feeding so it can come back without a resubscribe, just do not draw it
+        g_object_set(pad, "alpha", 0.0, nullptr);
+        return;
+    }
+
+    // The compositor scales each input to its tile; nothing is scaled in the camera pipelines
+    const MosaicTile& placement = wall.layout.vTiles[tile];
+    g_object_set(pad, "xpos", placement.iX, "ypos", placement.iY, "width", placement.iWidth, "height", placement.iHeight,
+                 "zorder", static_cast<guint>(std::max(placement.iZOrder, 0)), "alpha", 1.0, nullptr);
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(pad), "sizing-policy"))
+    {
+        gst_util_set_object_arg(G_OBJECT(pad), "sizing-policy", placement.bKeepAspect ? "keep-aspect-ratio" : "none");
+    }
+}
+
+void MosaicOutput::removeWall(const std::string& wall)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_walls.find(wall);
+    if (it == m_walls.end())
+    {
+        return;
+    }
+    for (auto& [tile, feeder] : it->second.tiles)
+    {
+        release(it->second.pipeline, it->second.compositor, feeder);
+    }
+    destroy(it->second);
+    m_walls.erase(it);
+    MX_LOG_INFO("MosaicOutput", ("wall " + wall + " removed").c_str());
+}
+
+void MosaicOutput::destroy(Wall& wall)
+{
+    if (wall.pipeline)
+    {
+        gst_element_set_state(wall.pipeline, GST_STATE_NULL);
+        gst_object_unref(wall.pipeline);
+    }
+    wall = Wall();
+}
+
+void MosaicOutput::stop()
+{
+    std::vector<std::string> names;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& entry : m_walls)
+        {
+            names.push_back(entry.first);
+        }
+    }
+    for (const std::string& name : names)
+    {
+        removeWall(name);
+    }
+}
+
+std::vector<MosaicSnapshot> MosaicOutput::getSnapshot()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<MosaicSnapshot> snapshots;
+    for (const auto& [name, wall] : m_walls)
+    {
+        MosaicSnapshot snapshot;
+        snapshot.sName = name;
+        snapshot.bRunning = wall.pipeline != nullptr;
+        snapshot.stLayout = wall.layout;
+        for (const auto& [tile, feeder] : wall.tiles)
+        {
+            MosaicTileSnapshot entry;
+            entry.iTile = tile;
+            entry.pipelineId = feeder->pipelineId;
+            entry.iFramesFed = feeder->iFed.load(std::memory_order_relaxed);
+            snapshot.vTiles.push_back(entry);
+        }
+        snapshots.push_back(std::move(snapshot));
+    }
+    return snapshots;
+}
+
+///////////////////////////////////////////////    Tiles   //////////////////////////////////////////
+
+bool MosaicOutput::attach(const std::string& wall, int tile, size_t pipelineId, TileSubscriber subscriber)
+{
+    if (tile < 0)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_walls.find(wall);
+    if (it == m_walls.end())
+    {
+        Wall created;
+        created.layout = MosaicLayout::grid(MOSAIC_DEFAULT_GRID, MOSAIC_DEFAULT_GRID, created.layout.iWidth, created.layout.iHeight);
+        if (!buildWallLocked(wall, created))
+        {
+            return false;
+        }
+        it = m_walls.emplace(wall, std::move(created)).first;
+    }
+    Wall& target = it->second;
+
+    auto previous = target.tiles.find(tile);
+    if (previous != target.tiles.end())
+    {
+        release(target.pipeline, target.compositor, previous->second);
+        target.tiles.erase(previous);
+    }
+
+    auto feeder = std::make_shared<Feeder>();
+    feeder->pipelineId = pipelineId;
+    feeder->appsrc = gst_element_factory_make("appsrc", ("tile_" + std::to_string(tile)).c_str());
+    if (!feeder->appsrc)
+    {
+        return false;
+    }
+
+    // Frames are stamped with the wall's clock on arrival: each camera's timestamps belong to its own pipeline
+    g_object_set(feeder->appsrc, "is-live", TRUE, "format", GST_FORMAT_TIME, "do-timestamp", TRUE, nullptr);
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(feeder->appsrc), "leaky-type"))
+    {
+        g_object_set(feeder->appsrc, "max-buffers", static_cast<guint64>(MOSAIC_APPSRC_BUFFERS), nullptr);
+        gst_util_set_object_arg(G_OBJECT(feeder->appsrc), "leaky-type", "downstream");
+    }
+
+    gst_bin_add(GST_BIN(target.pipeline), feeder->appsrc);
+    feeder->pad = gst_element_request_pad_simple(target.compositor, "sink_%u");
+    GstPad* srcPad = gst_element_get_static_pad(feeder->appsrc, "src");
+    const bool bLinked = feeder->pad && gst_pad_link(srcPad, feeder->pad) == GST_PAD_LINK_OK;
+    gst_object_unref(srcPad);
+    if (!bLinked)
+    {
+        MX_LOG_ERROR("MosaicOutput", ("cannot link tile " + std::to_string(tile) + " of wall " + wall).c_str());
+        release(target.pipeline, target.compositor, feeder);
+        return false;
+    }
+    applyTileLocked(target, tile, feeder->pad);
+    gst_element_sync_state_with_parent(feeder->appsrc);
+
+    // The feeder outlives its tap: the tap is closed, joining its thread, before the feeder goes
+    Feeder* raw = feeder.get();
+    feeder->tap = subscriber([raw](GstSample* sample) { feed(raw, sample); });
+    if (!feeder->tap)
+    {
+        release(target.pipeline, target.compositor, feeder);
+        return false;
+    }
+    target.tiles[tile] = feeder;
+
+    MX_LOG_INFO("MosaicOutput", ("pipeline " + std::to_string(pipelineId) + " on tile " + std::to_string(tile) +
+                                 " of wall " + wall).c_str());
+    return true;
+}
+
+void MosaicOutput::detach(const std::string& wall, int tile, size_t pipelineId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_walls.find(wall);
+    if (it == m_walls.end())
+    {
+        return;
+    }
+    auto entry = it->second.tiles.find(tile);
+    if (entry == it->second.tiles.end() || entry->second->pipelineId != pipelineId)
+    {
+        return;
+    }
+    release(it->second.pipeline, it->second.compositor, entry->second);
+    it->second.tiles.erase(entry);
+}
+
+void MosaicOutput::release(GstElement* pipeline, GstElement* compositor, const std::shared_ptr<Feeder>& feeder)
+{
+    if (feeder->tap)
+    {
+        feeder->tap->close();
+    }
+    if (feeder->appsrc)
+    {
+        gst_element_set_state(feeder->appsrc, GST_STATE_NULL);
+        gst_bin_remove(GST_BIN(pipeline), feeder->appsrc);
+        feeder->appsrc = nullptr;
+    }
+    if (feeder->pad)
+    {
+        gst_element_release_request_pad(compositor, feeder->pad);
+        gst_object_unref(feeder->pad);
+        feeder->pad = nullptr;
+    }
+    if (feeder->caps)
+    {
+        gst_caps_unref(feeder->caps);
+        feeder->caps = nullptr;
+    }
+}
+
+void MosaicOutput::feed(Feeder* feeder, GstSample* sample)
+{
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    GstCaps* caps = gst_sample_get_caps(sample);
+    if (!buffer || !caps)
+    {
+        return;
+    }
+
+    // A camera's profile switch or resolution change reaches the compositor as new caps
+    if (!feeder->caps || !gst_caps_is_equal(feeder->caps, caps))
+    {
+        gst_caps_replace(&feeder->caps, caps);
+        g_object_set(feeder->appsrc, "caps", caps, nullptr);
+    }
+
+    // Shallow copy: the picture is shared with the camera pipeline, only the timestamps are dropped
+    GstBuffer* copy = gst_buffer_copy(buffer);
+    GST_BUFFER_PTS(copy) = GST_CLOCK_TIME_NONE;
+    GST_BUFFER_DTS(copy) = GST_CLOCK_TIME_NONE;
+    gst_app_src_push_buffer(GST_APP_SRC(feeder->appsrc), copy);
+    feeder->iFed.fetch_add(1, std::memory_order_relaxed);
+}
+
+GstBusSyncReply MosaicOutput::busHandler(GstBus* bus, GstMessage* msg, gpointer data)
+{
+    const std::string wall = static_cast<const gchar*>(data);
+    if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR || GST_MESSAGE_TYPE(msg) == GST_MESSAGE_WARNING)
+    {
+        GError* error = nullptr;
+        gchar* debug = nullptr;
+        const bool bError = GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR;
+        if (bError)
+        {
+            gst_message_parse_error(msg, &error, &debug);
+        }
+        else
+        {
+            gst_message_parse_warning(msg, &error, &debug);
+        }
+        const std::string text = "wall " + wall + ": " + (error ? error->message : "unknown");
+        if (bError)
+        {
+            MX_LOG_ERROR("MosaicOutput", text.c_str());
+        }
+        else
+        {
+            MX_LOG_WARN("MosaicOutput", text.c_str());
+        }
+        g_clear_error(&error);
+        g_free(debug);
+    }
+    return GST_BUS_DROP;
+}
@@ -0,0 +1,123 @@
+#ifndef MOSAIC_OUTPUT_H
+#define MOSAIC_OUTPUT_H
+
+#include <gst/gst.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "FrameTap.h"
+#include "Struct.h"
+
+// One tile of a wall, in surface pixels
+struct MosaicTile
+{
+    int  iX{0};
+    int  iY{0};
+    int  iWidth{0};                 // 0 = the camera's own size
+    int  iHeight{0};
+    int  iZOrder{0};
+    bool bKeepAspect{true};         // letterbox inside the tile instead of stretching
+};
+
+struct MosaicLayout
+{
+    int         iWidth{1920};
+    int         iHeight{1080};
+    int         iFrameRate{25};     // the surface is composed at this rate whatever the cameras send
+    std::string sBackground{"black"};
+    std::vector<MosaicTile> vTiles; // cameras on tiles past the end are hidden, not dropped
+
+    // columns x rows equal tiles covering width x height
+    static MosaicLayout grid(int columns, int rows, int width, int height);
+};
+
+struct MosaicTileSnapshot
+{
+    int      iTile{-1};
+    size_t   pipelineId{0};
+    uint64_t iFramesFed{0};
+};
+
+struct MosaicSnapshot
+{
+    std::string  sName;
+    bool         bRunning{false};
+    MosaicLayout stLayout;
+    std::vector<MosaicTileSnapshot> vTiles;
+};
+
+// How a tile gets its camera's pictures (the handler's decoded frame tap)
+using TileSubscriber = std::function<FrameTapPtr(FrameCallback callback)>;
+
+// Process-wide display walls. Each wall is one pipeline: an appsrc per tile into
+// a compositor, and a single videoconvert ! autovideosink, so a 16-camera wall has
+// one window, one sink thread and one clock sync instead of sixteen. Cameras keep
+// their own ingest/decode pipelines and feed their tile from the decoded frame tap.
+// Layout changes only set compositor pad properties; no pipeline is rebuilt.
+class MosaicOutput
+{
+public:
+    static MosaicOutput& instance();
+
+    // Creates the wall on first use; a running wall is re-laid out in place
+    bool setLayout(const std::string& wall, const MosaicLayout& layout);
+
+    // Surface size of a tile, for picking the camera's stream profile; 0x0 if unknown
+    Resolution tileSize(const std::string& wall, int tile) const;
+
+    // Places a camera on a tile, replacing the tile's previous camera. A wall without
+    // a layout is created as a 4x4 grid.
+    bool attach(const std::string& wall, int tile, size_t pipelineId, TileSubscriber subscriber);
+
+    // Only detaches when the tile still belongs to pipelineId
+    void detach(const std::string& wall, int tile, size_t pipelineId);
+
+    void removeWall(const std::string& wall);
+    std::vector<MosaicSnapshot> getSnapshot();
+
+    // Tears every wall down
+    void stop();
+
+private:
+    MosaicOutput() = default;
+    ~MosaicOutput();
+
+    // Feeds one compositor pad from a camera's tap; the tap is closed before the feeder goes
+    struct Feeder
+    {
+        size_t               pipelineId{0};
+        GstElement*          appsrc{nullptr};
+        GstPad*              pad{nullptr};      // compositor request pad
+        FrameTapPtr          tap;
+        GstCaps*             caps{nullptr};     // last caps set on the appsrc
+        std::atomic<uint64_t> iFed{0};
+    };
+
+    struct Wall
+    {
+        MosaicLayout         layout;
+        GstElement*          pipeline{nullptr};
+        GstElement*          compositor{nullptr};
+        GstElement*          capsfilter{nullptr};
+        std::unordered_map<int, std::shared_ptr<Feeder>> tiles;
+    };
+
+    bool buildWallLocked(const std::string& name, Wall& wall);
+    void applyOutputLocked(Wall& wall);
+    void applyTileLocked(const Wall& wall, int tile, GstPad* pad);
+    void release(GstElement* pipeline, GstElement* compositor, const std::shared_ptr<Feeder>& feeder);
+    static void destroy(Wall& wall);
+    static void feed(Feeder* feeder, GstSample* sample);
+    static GstBusSyncReply busHandler(GstBus* bus, GstMessage* msg, gpointer data);
+
+    mutable std::mutex   m_mutex;
+    std::unordered_map<std::string, Wall> m_walls;
+};
+
+#endif // MOSAIC_OUTPUT_H
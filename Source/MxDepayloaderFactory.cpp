@@ -115,6 +115,19 @@ GstElement *CMx_DepayloaderFactory::createDepayloaderforAudio(const gchar *pipel
 	{
 		depayloader = gst_element_factory_make("rtpg726depay", "audio depay");
 	}
+	else if(eAudioCodec::AUDIO_CODEC_AAC == audiocodec)
+	{
+		// Cameras send AAC as MPEG4-GENERIC (RFC 3640)
+		depayloader = gst_element_factory_make("rtpmp4gdepay", "audio depay");
+	}
+	else if(eAudioCodec::AUDIO_CODEC_MP3 == audiocodec)
+	{
+		depayloader = gst_element_factory_make("rtpmpadepay", "audio depay");
+	}
+	else if(eAudioCodec::AUDIO_CODEC_OPUS == audiocodec)
+	{
+		depayloader = gst_element_factory_make("rtpopusdepay", "audio depay");
+	}
 	
 	if (depayloader)
 	{
@@ -1,8 +1,60 @@
 #include "PipelineHandler.h"
+#include "Mx_MediaType.h"
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <sstream>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
-PipelineHandler::PipelineHandler(const MediaStreamDevice& streamDevice)   : config(streamDevice) 
+// Low-latency live view
+#define LOW_LATENCY_JITTERBUFFER_MS 100
+#define AVDEC_THREAD_TYPE_SLICE     2   // slice threading adds no frame delay, frame threading adds one per thread
+
+// Embedded RTSP server output
+#define RTSP_OUTPUT_TAP_QUEUE           30      // access units, about a second at 25-30 fps
+
+// Transcoding
+#define ENCODER_LOAD_WEIGHT             2.0f    // one encoder against one decode, for thread budget and split
+#define TRANSCODE_GOP_SECONDS           2       // keyframe spacing, also the HLS segment granularity
+#define TRANSCODE_DEFAULT_PRESET        "veryfast"
+#define LADDER_QUEUE_FRAMES             3       // raw frames per rendition branch; a slow encoder drops, never stalls the tee
+
+// Audio
+#define AUDIO_QUEUE_TIME_NS             (2 * GST_SECOND)   // audio waiting on video keyframes at the muxer
+#define OPUS_SAMPLE_RATE                48000
+
+// RTP/UDP output
+#define RTP_OUTPUT_PAYLOAD_TYPE         96
+#define RTP_OUTPUT_MIN_MTU              576
+
+// Segmented recording
+#define SEGMENT_FINALIZE_TIMEOUT_MS     3000
+#define SEGMENT_MOOV_UPDATE_NS          (1 * GST_SECOND)   // open MP4 segment stays playable to within this
+
+// QoS overload levels
+#define QOS_LEVEL_FULL              0
+#define QOS_LEVEL_SKIP_NONREF       1   // decoder skip-frame=1
+#define QOS_LEVEL_KEYFRAMES_ONLY    2   // delta units dropped ahead of the decoder
+
+// A window is overloaded when sinks drop this share of buffers or run this late on average
+#define QOS_WINDOW_MS               1000
+#define QOS_DROP_RATIO_THRESHOLD    0.10
+#define QOS_LATENESS_THRESHOLD_MS   100.0
+
+// Hysteresis: time between degrade steps, and quiet time before stepping back up.
+// The recover hold doubles (up to the cap) when a recovery is followed by overload.
+#define QOS_DEGRADE_HOLD_MS         2000
+#define QOS_RECOVER_HOLD_MS         5000
+#define QOS_RECOVER_HOLD_MAX_MS     60000
+
+PipelineHandler::PipelineHandler(const MediaStreamDevice& streamDevice, const PipelineBuildOptions& options)
+    : config(streamDevice), m_buildOptions(options), m_bKeyframeOnly(streamDevice.bKeyframeOnly)
 {
     //gst_init(nullptr, nullptr);
 
@@ -26,12 +78,31 @@ PipelineHandler::PipelineHandler(const MediaStreamDevice& streamDevice)   : conf
         #endif
     }
 
+    m_preEvent.setFinishedCallback([this](const SegmentInfo& segment)
+    {
+        if (m_segmentCallback)
+        {
+            m_segmentCallback(m_pipelineId, segment);
+        }
+    });
+
     buildPipeline();
 }
 
 PipelineHandler::~PipelineHandler() 
 {
     terminate();
+    stopSegmentWorker();
+
+    std::lock_guard<std::mutex> lock(m_tapMutex);
+    for (TapPoint* tapPoint : tapPointsLocked())
+    {
+        for (FrameTapPtr& tap : tapPoint->taps)
+        {
+            tap->close();
+        }
+        tapPoint->taps.clear();
+    }
 }
 
 //bool PipelineHandler::buildPipeline() 
@@ -46,8 +117,15 @@ PipelineHandler::~PipelineHandler()
 void PipelineHandler::buildPipeline()
 {
 
-    // Get input and output configurations from PipelineManager
-    MediaStreamDevice device = config;
+    // A wall tile picks its stream for the tile it is drawn on unless told otherwise
+    if (!config.sMosaic.empty() && config.stTileSize.width <= 0 && config.stTileSize.height <= 0)
+    {
+        config.stTileSize = MosaicOutput::instance().tileSize(config.sMosaic, config.iMosaicTile);
+    }
+
+    // Get input and output configurations from PipelineManager, with the chosen stream profile applied
+    m_iActiveProfile = StreamProfileSelector::select(config, m_iActiveProfile);
+    MediaStreamDevice device = StreamProfileSelector::resolve(config, m_iActiveProfile);
     MediaData inputData = device.stinputMediaData;
     MediaData outputData = device.stoutputMediaData;
 
@@ -79,7 +157,26 @@ void PipelineHandler::buildPipeline()
         g_object_set(G_OBJECT(source), "protocols", 4, NULL); // 4 = GST_RTSP_LOWER_TRANS_TCP
         g_object_set(G_OBJECT(source), "retry", 3, NULL);
         g_object_set(G_OBJECT(source), "timeout", 5000000, NULL); // 5 seconds in microseconds
+
+        const bool bLowLatency = device.elatencyProfile == eLatencyProfile::LATENCY_PROFILE_LOW;
+        const int latencyMs = device.iLatencyMs > 0 ? device.iLatencyMs : (bLowLatency ? LOW_LATENCY_JITTERBUFFER_MS : 0);
+        if (latencyMs > 0)
+        {
+            g_object_set(G_OBJECT(source), "latency", static_cast<guint>(latencyMs), NULL);
+        }
+        if (bLowLatency)
+        {
+            g_object_set(G_OBJECT(source), "drop-on-latency", TRUE, NULL);
+        }
+
+        // NTP capture time from RTCP sender reports, read by the latency meter (GStreamer 1.22+)
+        if (g_object_class_find_property(G_OBJECT_GET_CLASS(source), "add-reference-timestamp-meta"))
+        {
+            g_object_set(G_OBJECT(source), "add-reference-timestamp-meta", TRUE, NULL);
+        }
         g_signal_connect(source, "pad-added", G_CALLBACK(on_pad_added), this);
+        g_signal_connect(source, "select-stream", G_CALLBACK(&PipelineHandler::onSelectStream), this);
+        g_signal_connect(source, "no-more-pads", G_CALLBACK(&PipelineHandler::onNoMorePads), this);
         std::cerr << "successfully create rtspsrc element\n";
     }
     else
@@ -96,14 +193,16 @@ void PipelineHandler::buildPipeline()
         depay = CMx_DepayloaderFactory::createDepayloader("pipeliene", inputData.stMediaCodec.codecname);
     }
 
-    //for audio parser G711-alaw
-    if (device.stinputMediaData.stMediaCodec.eaudiocodec != eAudioCodec::AUDIO_CODEC_NONE)
-        audiodepay = CMx_DepayloaderFactory::createDepayloaderforAudio("pipeliene", device.stinputMediaData.stMediaCodec.eaudiocodec);
-    // audiodepay = gst_element_factory_make("rtppcmadepay", "audio depay");
+    // Audio is only received when the output wants it; the branch itself is built before the sink is linked
+    audiodepay = m_audioTail = nullptr;
+    eAudioCodec audioTarget = eAudioCodec::AUDIO_CODEC_NONE;
+    m_eAudioRoute = audioRoute(device, audioTarget);
 
 
-     // Step 3: Add Parser for Compressed Formats
-    parser = CMx_ParseFactory::createParser("pipeliene", inputData.stMediaCodec.codecname);
+     // Step 3: Add Parser for Compressed Formats. A same-codec RTSP relay skips it: the depayloader
+    // already emits whole access units, and rtspclientsink payloads them as they are.
+    m_bPassthrough = isPassthroughRelay(device);
+    parser = m_bPassthrough ? nullptr : CMx_ParseFactory::createParser("pipeliene", inputData.stMediaCodec.codecname);
 
     // Step 4: Add Muxer if Output is a Container Format
     if (outputData.stFileSource.econtainerFormat == eContainerFormat::CONTAINER_FORMAT_MP4)
@@ -111,7 +210,21 @@ void PipelineHandler::buildPipeline()
         muxer = gst_element_factory_make("mp4mux", "muxer");
         // g_object_set(G_OBJECT(muxer), "faststart", true, NULL);
         // g_object_set(G_OBJECT(muxer), "fragment-duration", 1000000, NULL);
-        g_object_set(G_OBJECT(muxer), "faststart", TRUE, "fragment-duration", 1000, "streamable", TRUE, "reserved-max-duration", 3000000000, NULL);
+        if (outputData.stFileSource.bSegmented)
+        {
+            // Every segment gets its moov when it closes; the reserved moov, rewritten
+            // periodically, keeps the open one playable if the process dies
+            const int segmentSeconds = outputData.stFileSource.iSegmentSeconds;
+            if (segmentSeconds > 0)
+            {
+                g_object_set(G_OBJECT(muxer), "reserved-max-duration", static_cast<guint64>(2 * segmentSeconds) * GST_SECOND,
+                             "reserved-moov-update-period", static_cast<guint64>(SEGMENT_MOOV_UPDATE_NS), NULL);
+            }
+        }
+        else
+        {
+            g_object_set(G_OBJECT(muxer), "faststart", TRUE, "fragment-duration", 1000, "streamable", TRUE, "reserved-max-duration", 3000000000, NULL);
+        }
 
     }
     else if (outputData.stFileSource.econtainerFormat == eContainerFormat::CONTAINER_FORMAT_MKV)
@@ -120,15 +233,94 @@ void PipelineHandler::buildPipeline()
     }
 
 
-    gst_bin_add_many(GST_BIN(pipeline), source, depay, parser, audiodepay, NULL);
-    gst_element_link(depay, parser);
-    prevElement = parser;
+    if (m_bPassthrough)
+    {
+        gst_bin_add_many(GST_BIN(pipeline), source, depay, NULL);
+        prevElement = insertQueue(eQueueStage::QUEUE_STAGE_DEPAY, depay);
+        MX_LOG_INFO("PipelineHandler", "Relay passthrough: output codec matches input, parser skipped");
+    }
+    else
+    {
+        gst_bin_add_many(GST_BIN(pipeline), source, depay, parser, NULL);
+        gst_element_link(insertQueue(eQueueStage::QUEUE_STAGE_DEPAY, depay), parser);
+        prevElement = parser;
+    }
+
+    // Step 4b: Re-encode when the output asks for another codec, bitrate or size. Display
+    // pipelines create their own decoder below, and nothing here survives a rebuild.
+    // A rendition ladder decodes once and fans out to one encoder per rendition.
+    decoder = convert = parser2 = nullptr;
+    m_renditions.clear();
+    m_bTranscode = !m_bPassthrough && isTranscode(device);
+    m_bLadder = !m_bPassthrough && isLadder(device);
+    m_fEncodeLoad = encodeLoadFactor(device);
+    if ((m_bTranscode && !buildTranscodeStage(device)) || (m_bLadder && !buildLadder(device)))
+    {
+        std::string errorMsg = m_bLadder ? "Failed to create rendition ladder" : "Failed to create transcode stage";
+        MX_LOG_ERROR("PipelineHandler", errorMsg.c_str());
+        handleError(errorMsg);
+        return;
+    }
 
     //Configuration is modify than changes accordingly3
     //MediaConfigurationChanges();
 
     // Step 5: Identify Sink Element
-    if (outputData.esourceType == eSourceType::SOURCE_TYPE_FILE)
+    if (m_bLadder)
+    {
+        // Every rendition branch ends in its own sink
+        sink = nullptr;
+    }
+    else if (outputData.esourceType == eSourceType::SOURCE_TYPE_NETWORK && outputData.stNetworkStreaming.bServe)
+    {
+        // Viewers attach to the RTSP server mount, which taps the access units; the ingest
+        // branch itself only needs to be drained
+        sink = gst_element_factory_make("fakesink", "sink");
+        g_object_set(G_OBJECT(sink), "sync", FALSE, "async", FALSE, NULL);
+    }
+    else if (outputData.esourceType == eSourceType::SOURCE_TYPE_NETWORK &&
+             outputData.stNetworkStreaming.estreamingProtocol == eStreamingProtocol::STREAMING_PROTOCOL_RTP)
+    {
+        sink = createRtpOutput(outputCodec(device), outputData.stNetworkStreaming);
+        if (!sink)
+        {
+            std::string errorMsg = "Failed to create RTP output";
+            MX_LOG_ERROR("PipelineHandler", errorMsg.c_str());
+            handleError(errorMsg);
+            return;
+        }
+    }
+    else if (outputData.esourceType == eSourceType::SOURCE_TYPE_NETWORK &&
+             outputData.stNetworkStreaming.estreamingProtocol == eStreamingProtocol::STREAMING_PROTOCOL_HTTP)
+    {
+        const NetworkStreaming& network = outputData.stNetworkStreaming;
+        HlsStoreConfig storeConfig;
+        storeConfig.iTargetMs = network.iHlsSegmentMs;
+        storeConfig.iPlaylistSegments = network.iHlsPlaylistSegments;
+        storeConfig.iMaxBytes = network.iHlsStoreMaxBytes;
+        m_hls = std::make_unique<HlsPackager>(std::make_shared<HlsSegmentStore>(storeConfig), network.iHlsSegmentMs);
+        sink = m_hls->createSink(outputCodec(device));
+        if (!sink)
+        {
+            m_hls.reset();
+            std::string errorMsg = "Failed to create HLS output";
+            MX_LOG_ERROR("PipelineHandler", errorMsg.c_str());
+            handleError(errorMsg);
+            return;
+        }
+    }
+    else if (outputData.esourceType == eSourceType::SOURCE_TYPE_FILE && outputData.stFileSource.bSegmented)
+    {
+        sink = createSegmentSink(outputData.stFileSource);
+        if (!sink)
+        {
+            std::string errorMsg = "Failed to create splitmuxsink element";
+            MX_LOG_ERROR("PipelineHandler", errorMsg.c_str());
+            handleError(errorMsg);
+            return;
+        }
+    }
+    else if (outputData.esourceType == eSourceType::SOURCE_TYPE_FILE)
     {
         sink = gst_element_factory_make("filesink", "sink");
         g_object_set(G_OBJECT(sink), "location", "output_new.mp4", NULL);
@@ -151,8 +343,41 @@ void PipelineHandler::buildPipeline()
         {
             decoder = gst_element_factory_make("avdec_h265", "decode");
         }
+
+        // Admission control downgrade: skip-frame 1 drops B/non-reference frames in libav
+        if (decoder && m_buildOptions.bReducedDecode)
+        {
+            g_object_set(G_OBJECT(decoder), "skip-frame", 1, NULL);
+            MX_LOG_INFO("PipelineHandler", "Decoder running in reduced mode, non-reference frames skipped");
+        }
+
+        if (decoder && m_buildOptions.iDecodeThreads > 0)
+        {
+            g_object_set(G_OBJECT(decoder), "max-threads", m_buildOptions.iDecodeThreads, NULL);
+        }
+
+        // Frame threading holds back one frame per thread; older libav plugins lack thread-type
+        if (decoder && device.elatencyProfile == eLatencyProfile::LATENCY_PROFILE_LOW &&
+            g_object_class_find_property(G_OBJECT_GET_CLASS(decoder), "thread-type"))
+        {
+            g_object_set(G_OBJECT(decoder), "thread-type", AVDEC_THREAD_TYPE_SLICE, NULL);
+        }
+
+        // libav has no keyframe-only skip mode, so keyframe-only display and the QoS
+        // keyframes-only level drop delta units on the decoder input instead
+        if (decoder)
+        {
+            m_gatePad = gst_element_get_static_pad(decoder, "sink");
+            if (m_gatePad)
+            {
+                m_gateProbeId = gst_pad_add_probe(m_gatePad, GST_PAD_PROBE_TYPE_BUFFER,
+                                                  &PipelineHandler::decodeGateProbe, this, nullptr);
+            }
+        }
         
-        sink = gst_element_factory_make("autovideosink", "display");
+        // A wall tile is rendered by the wall's single sink; this one only terminates the branch
+        const bool bMosaic = !device.sMosaic.empty();
+        sink = gst_element_factory_make(bMosaic ? "fakesink" : "autovideosink", "display");
         if (!sink) {
             std::string errorMsg = "Failed to create autovideosink element";
             MX_LOG_ERROR("PipelineHandler", errorMsg.c_str());
@@ -160,41 +385,116 @@ void PipelineHandler::buildPipeline()
             return;
         }
         
-        // Set sync property to true for live sources
-        if (inputData.esourceType == eSourceType::SOURCE_TYPE_NETWORK) {
+        // Set sync property to true for live sources; low latency shows frames as soon as they are decoded
+        if (bMosaic) {
+            g_object_set(G_OBJECT(sink), "sync", FALSE, "async", FALSE, NULL);
+        }
+        else if (device.elatencyProfile == eLatencyProfile::LATENCY_PROFILE_LOW) {
+            g_object_set(G_OBJECT(sink), "sync", FALSE, NULL);
+        }
+        else if (inputData.esourceType == eSourceType::SOURCE_TYPE_NETWORK) {
             g_object_set(G_OBJECT(sink), "sync", TRUE, NULL);
+            m_bSinkSync = true;
         }
         
         std::cerr << "successfully create autovideosink element\n";
     }
+    // Step 7b: Audio branch. Without one the camera's audio is never set up (select-stream).
+    if (m_eAudioRoute != eAudioRoute::AUDIO_ROUTE_NONE && !buildAudioBranch(device, audioTarget))
+    {
+        MX_LOG_WARN("PipelineHandler", ("pipeline " + std::to_string(m_pipelineId) + ": audio branch unavailable, recording video only").c_str());
+        m_eAudioRoute = eAudioRoute::AUDIO_ROUTE_NONE;
+    }
+
     // Step 8: Add Elements to Pipeline
-    if (outputData.esourceType == eSourceType::SOURCE_TYPE_FILE)
+    if (m_bLadder)
+    {
+        // Linked by buildLadder
+    }
+    else if (outputData.esourceType == eSourceType::SOURCE_TYPE_FILE && outputData.stFileSource.bSegmented)
+    {
+        // The muxer belongs to splitmuxsink, which starts a new one per segment
+        gst_bin_add(GST_BIN(pipeline), sink);
+        GstElement* tail = insertQueue(eQueueStage::QUEUE_STAGE_PARSER, encodedOutput());
+        gst_element_link(tail, sink);
+
+        addSegmentPad(tail);
+
+        // splitmuxsink cuts on video keyframes and carries the audio over into the next segment
+        if (m_audioTail && !gst_element_link_pads(m_audioTail, "src", sink, "audio_%u"))
+        {
+            MX_LOG_WARN("PipelineHandler", "audio could not be linked to the segment muxer");
+        }
+        addSegmentPad(m_audioTail);
+    }
+    else if (outputData.esourceType == eSourceType::SOURCE_TYPE_FILE)
     {
-        gst_bin_add_many(GST_BIN(pipeline), source, depay, parser, muxer, sink, NULL);
-        gst_element_link_many(depay, parser, muxer, sink, NULL);
+        gst_bin_add_many(GST_BIN(pipeline), muxer, sink, NULL);
+        GstElement* tail = insertQueue(eQueueStage::QUEUE_STAGE_PARSER, encodedOutput());
+        gst_element_link_many(tail, muxer, sink, NULL);
+        addSegmentPad(tail);
+
+        // The muxer interleaves by timestamp; both streams carry rtspsrc's RTCP-synced running time
+        if (m_audioTail && !gst_element_link(m_audioTail, muxer))
+        {
+            MX_LOG_WARN("PipelineHandler", "audio could not be linked to the muxer");
+        }
+        addSegmentPad(m_audioTail);
+
+        // A single file is closed once the muxer's EOS, after its index, reaches the file sink
+        GstPad* fileSinkPad = gst_element_get_static_pad(sink, "sink");
+        gst_pad_add_probe(fileSinkPad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, &PipelineHandler::fileEosProbe, this, nullptr);
+        gst_object_unref(fileSinkPad);
     }
     else if (outputData.esourceType == eSourceType::SOURCE_TYPE_DISPLAY)
     {
         std::cerr << "successfully link display  element\n";
         gst_bin_add_many(GST_BIN(pipeline), source, depay, parser, decoder, sink, NULL);
-        gst_element_link_many(depay, parser, decoder, sink, NULL);
+        gst_element_link(insertQueue(eQueueStage::QUEUE_STAGE_PARSER, parser), decoder);
+        gst_element_link(insertQueue(eQueueStage::QUEUE_STAGE_DECODER, decoder), sink);
     }
     else if (outputData.esourceType == eSourceType::SOURCE_TYPE_NETWORK)
     {
         gst_bin_add(GST_BIN(pipeline), sink);
-        gst_element_link(prevElement, sink);
-        if (device.stinputMediaData.stMediaCodec.eaudiocodec != eAudioCodec::AUDIO_CODEC_NONE)
+        gst_element_link(m_bPassthrough ? prevElement : insertQueue(eQueueStage::QUEUE_STAGE_PARSER, prevElement), sink);
+        // Audio only goes out through rtspclientsink (see audioRoute); the server, RTP and HLS outputs carry video
+        if (m_audioTail && !gst_element_link(m_audioTail, sink))
         {
-            if (!gst_element_link(audiodepay, sink))
-            {
-                g_printerr("Audio elements could not be linked. Exiting.\n");
+            MX_LOG_WARN("PipelineHandler", "audio could not be linked to rtspclientsink");
+        }
+    }
+
+    // Stream health probes; the output stage only exists where frames reach a renderer
+    m_stats.attach(depay, "src", eStatsStage::STATS_STAGE_DEPAY);
+    m_stats.attach(parser, "src", eStatsStage::STATS_STAGE_PARSER);
+    if (outputData.esourceType == eSourceType::SOURCE_TYPE_DISPLAY)
+    {
+        m_stats.attach(sink, "sink", eStatsStage::STATS_STAGE_OUTPUT);
+        m_stats.attachLatency(sink);
+    }
+
+    if (m_preEvent.getConfig().bEnabled)
+    {
+        m_preEvent.attach(encodedOutput());
+    }
 
+    // Subscribers survive rebuilds; put their probes back on the new elements
+    {
+        std::lock_guard<std::mutex> lock(m_tapMutex);
+        for (TapPoint* tapPoint : tapPointsLocked())
+        {
+            if (!tapPoint->taps.empty())
+            {
+                installTapProbeLocked(*tapPoint);
             }
         }
     }
 
+    m_iAppliedDecodeThreads = decoder ? m_buildOptions.iDecodeThreads : 0;
+
     GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
     gst_bus_add_watch(bus, (GstBusFunc)PipelineHandler::busCallback, this);
+    gst_bus_set_sync_handler(bus, &PipelineHandler::syncBusHandler, this, nullptr);
     gst_object_unref(bus);
 }
 
@@ -652,8 +952,50 @@ void PipelineHandler::buildPipeline()
 //    }
 //}
 
+GstElement* PipelineHandler::insertQueue(eQueueStage stage, GstElement* upstream)
+{
+    const QueueStageConfig& queueConfig = m_buildOptions.stQueues.stage(stage);
+    if (!queueConfig.bEnabled || !upstream)
+    {
+        return upstream;
+    }
+
+    static const char* names[] = {"queue_depay", "queue_parse", "queue_decode"};
+    GstElement* queue = gst_element_factory_make(queueConfig.bQueue2 ? "queue2" : "queue", names[static_cast<size_t>(stage)]);
+    if (!queue)
+    {
+        MX_LOG_WARN("PipelineHandler", ("failed to create " + std::string(names[static_cast<size_t>(stage)]) + ", linking directly").c_str());
+        return upstream;
+    }
+
+    g_object_set(G_OBJECT(queue),
+                 "max-size-buffers", queueConfig.iMaxBuffers,
+                 "max-size-bytes",   queueConfig.iMaxBytes,
+                 "max-size-time",    static_cast<guint64>(queueConfig.iMaxTimeMs * GST_MSECOND),
+                 NULL);
+    if (!queueConfig.bQueue2)
+    {
+        g_object_set(G_OBJECT(queue), "leaky", static_cast<int>(queueConfig.eLeaky), NULL);
+    }
+
+    gst_bin_add(GST_BIN(pipeline), queue);
+    if (!gst_element_link(upstream, queue))
+    {
+        MX_LOG_ERROR("PipelineHandler", ("failed to link " + std::string(names[static_cast<size_t>(stage)])).c_str());
+    }
+    return queue;
+}
+
 void PipelineHandler::cleanupPipeline() 
 {
+    stopBusThread();
+
+    // stop() has already closed the last segment; a rebuild closes it here
+    finalizeSegment();
+    unmountRtspOutput();
+    unpublishHls();
+    detachMosaic();
+
     // First set the pipeline to NULL state if it exists
     if (pipeline) 
     {
@@ -666,9 +1008,48 @@ void PipelineHandler::cleanupPipeline()
         }
     }
 
+    // Probes go before the pads they hold references to
+    m_stats.detach();
+    m_preEvent.detach();
+    if (m_gatePad)
+    {
+        gst_pad_remove_probe(m_gatePad, m_gateProbeId);
+        gst_object_unref(m_gatePad);
+        m_gatePad = nullptr;
+        m_gateProbeId = 0;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_reopenMutex);
+        if (m_reopenProbeId && decoder)
+        {
+            GstPad* sinkPad = gst_element_get_static_pad(decoder, "sink");
+            gst_pad_remove_probe(sinkPad, m_reopenProbeId);
+            gst_object_unref(sinkPad);
+        }
+        m_reopenProbeId = 0;
+        m_iPendingDecodeThreads = -1;
+        m_iAppliedDecodeThreads = 0;
+    }
+    resetQos();
+    m_bSinkSync = false;
+    m_hls.reset();
+    m_renditions.clear();
+    if (m_rtpPayPad)
+    {
+        g_signal_handler_disconnect(m_rtpPayPad, m_rtpCapsHandler);
+        gst_object_unref(m_rtpPayPad);
+        m_rtpPayPad = nullptr;
+        m_rtpCapsHandler = 0;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_tapMutex);
+        removeTapProbesLocked();
+    }
+
     // Unref all elements - the pipeline will unref its children, so we only need to unref the pipeline
     if (pipeline) {
         gst_object_unref(GST_OBJECT(pipeline));
+        pipeline = nullptr;
     }
     
     // Update state
@@ -680,7 +1061,11 @@ void PipelineHandler::cleanupPipeline()
 bool PipelineHandler::start() 
 {
     std::lock_guard<std::mutex> lock(m_mutex);
-    
+    return startLocked();
+}
+
+bool PipelineHandler::startLocked()
+{
     if (m_state == State::PLAYING)
     {
         MX_LOG_INFO("PipelineHandler", "Pipeline is already in PLAYING state");
@@ -724,13 +1109,20 @@ bool PipelineHandler::start()
         MX_LOG_INFO("PipelineHandler", "Pipeline state change completed immediately");
     }
 
+    // A resume from PAUSED still has the previous bus thread
+    stopBusThread();
     m_isRunning = true;
+    mountRtspOutput();
+    publishHls();
+    attachMosaic();
     
-    // Start a thread to monitor the pipeline bus
-    std::thread([this]() 
+    // Start a thread to monitor the pipeline bus; stop and cleanup bump the generation and join it
+    const unsigned generation = ++m_busGeneration;
+    GstBus* pipelineBus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
+    m_busThread = std::thread([this, generation, pipelineBus]() 
     {
-        GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
-        while (m_isRunning) 
+        GstBus* bus = pipelineBus;
+        while (m_isRunning && m_busGeneration == generation) 
         {
             GstMessage* msg = gst_bus_timed_pop_filtered(
                 bus, 100 * GST_MSECOND,  // Check every 100ms instead of blocking indefinitely
@@ -742,9 +1134,16 @@ bool PipelineHandler::start()
                 busCallback(bus, msg, this);
                 gst_message_unref(msg);
             }
+
+            // The message may have stopped the pipeline from this thread
+            if (!m_isRunning || m_busGeneration != generation)
+            {
+                break;
+            }
+            evaluateQos();
         }
         gst_object_unref(bus);
-    }).detach(); // Runs in a separate thread
+    });
 
 
     m_state = State::PLAYING;
@@ -789,11 +1188,16 @@ bool PipelineHandler::resume()
 bool PipelineHandler::stop() 
 {
     std::lock_guard<std::mutex> lock(m_mutex);
+
+    stopBusThread();
     
-    if (m_state == State::STOPPED)
+    if (m_state == State::STOPPED || !pipeline)
     {
         return true;
     }
+
+    // The last segment needs its EOS while the muxer still runs; NULL would cut it off without an index
+    finalizeSegment();
     
     GstStateChangeReturn ret = gst_element_set_state(pipeline, GST_STATE_NULL);
 
@@ -821,42 +1225,84 @@ void PipelineHandler::terminate()
 bool PipelineHandler::updateConfiguration(const MediaStreamDevice& newConfig) 
 {
     std::lock_guard<std::mutex> lock(m_mutex);
-    
-    // Store current state
-    State previousState = m_state;
-    
-    MX_LOG_TRACE("PipelineHandler", "stop pipeline for new configuration update");
 
-    // Stop pipeline
-    if (!stop()) 
+    // Keyframe-only is switched live; an update that only changes it skips the rebuild
+    MediaStreamDevice sameMode = config;
+    sameMode.bKeyframeOnly = newConfig.bKeyframeOnly;
+    if (sameMode == newConfig)
     {
-        MX_LOG_ERROR("PipelineHandler", "failed to stop pipeline");
-        return false;
+        setKeyframeOnly(newConfig.bKeyframeOnly);
+        return true;
     }
     
     // Update configuration
     config = newConfig;
+    m_bKeyframeOnly = newConfig.bKeyframeOnly;
 
     MX_LOG_TRACE("PipelineHandler", "new configuration is updated");
     
-    // Rebuild pipeline
+    return rebuildLocked();
+}
+
+bool PipelineHandler::rebuildLocked()
+{
+    // Store current state
+    const State previousState = m_state;
+
+    MX_LOG_TRACE("PipelineHandler", "stop pipeline for rebuild");
+
+    // Cleanup retires the bus thread of the old pipeline and sets it to NULL
     cleanupPipeline();
 
     buildPipeline();
+    if (m_state == State::ERROR || !pipeline)
+    {
+        return false;
+    }
     
     // Restore previous state if it was playing or paused
     if (previousState == State::PLAYING) 
     {
-        return start();
+        return startLocked();
     } 
     else if (previousState == State::PAUSED) 
     {
-        return pause();
+        if (!startLocked())
+        {
+            return false;
+        }
+        gst_element_set_state(pipeline, GST_STATE_PAUSED);
+        m_state = State::PAUSED;
     }
     
     return true;
 }
 
+void PipelineHandler::setTileSize(int width, int height)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    config.stTileSize.width = width;
+    config.stTileSize.height = height;
+
+    const int next = StreamProfileSelector::select(config, m_iActiveProfile);
+    if (next == m_iActiveProfile)
+    {
+        return;
+    }
+
+    const std::string from = m_iActiveProfile >= 0 ? config.vStreamProfiles[m_iActiveProfile].sName : "default";
+    const std::string to = next >= 0 ? config.vStreamProfiles[next].sName : "default";
+    MX_LOG_INFO("PipelineHandler", ("tile " + std::to_string(width) + "x" + std::to_string(height) +
+                                    ", switching stream " + from + " -> " + to).c_str());
+
+    m_iActiveProfile = next;
+    if (rebuildLocked())
+    {
+        reportStatus(PipelineStatus::Information, "Stream profile switched to " + to);
+    }
+}
+
 bool PipelineHandler::isRunning() const 
 {
     return m_state == State::PLAYING;
@@ -912,20 +1358,19 @@ bool PipelineHandler::linkDynamicPad(GstPad* newPad)
                 std::cerr << "successfully to link dynamic pad\n";
             gst_object_unref(sinkPad);
         }
-       /* else if (g_strcmp0(media, "audio") == 0)
+        else if (g_strcmp0(media, "audio") == 0 && audiodepay)
         {
-            GstPad* sinkpad = gst_element_get_static_pad(audiodepay, "sink");
-            if (GST_PAD_LINK_SUCCESSFUL(gst_pad_link(newPad, sinkpad)))
+            // A camera whose audio differs from the configured codec fails here; no-more-pads then ends the branch
+            GstPad* sinkPad = gst_element_get_static_pad(audiodepay, "sink");
+            if (sinkPad && !gst_pad_is_linked(sinkPad) && gst_pad_link(newPad, sinkPad) != GST_PAD_LINK_OK)
             {
-                g_print("Linked audio pad successfully\n");
+                MX_LOG_WARN("PipelineHandler", ("pipeline " + std::to_string(m_pipelineId) + ": camera audio does not match the configured codec").c_str());
             }
-            else
+            if (sinkPad)
             {
-                g_print("Failed to link audio pad\n");
+                gst_object_unref(sinkPad);
             }
-            gst_object_unref(sinkpad);
-            std::cerr << "audio frame receive\n";
-        }*/
+        }
     }
 
 
@@ -1031,6 +1476,10 @@ gboolean PipelineHandler::busCallback(GstBus* bus, GstMessage* msg, gpointer dat
                         break;
                     case GST_STATE_PLAYING:
                         handler->m_state = State::PLAYING;
+                        if (handler->m_bSinkSync)
+                        {
+                            handler->m_stats.setSyncLatency(gst_pipeline_get_latency(GST_PIPELINE(handler->pipeline)));
+                        }
                         handler->reportStatus(PipelineStatus::Success, "Pipeline is now playing");
                         MX_LOG_INFO("PipelineHandler", "Pipeline reached PLAYING state - video should be visible now");
                         break;
@@ -1064,6 +1513,10 @@ gboolean PipelineHandler::busCallback(GstBus* bus, GstMessage* msg, gpointer dat
             break;
         }
         
+        case GST_MESSAGE_QOS:
+            handler->handleQos(msg);
+            break;
+
         case GST_MESSAGE_CLOCK_LOST:
             // Get a new clock
             MX_LOG_INFO("PipelineHandler", "Clock lost, getting a new one");
@@ -1080,6 +1533,1775 @@ gboolean PipelineHandler::busCallback(GstBus* bus, GstMessage* msg, gpointer dat
     return TRUE;
 }
 
+///////////////////////////////////////////////    QoS   //////////////////////////////////////////
+
+void PipelineHandler::handleQos(GstMessage* msg)
+{
+    gint64 jitter = 0;
+    gdouble proportion = 1.0;
+    gint quality = 0;
+    gst_message_parse_qos_values(msg, &jitter, &proportion, &quality);
+
+    GstFormat format = GST_FORMAT_UNDEFINED;
+    guint64 processed = 0, dropped = 0;
+    gst_message_parse_qos_stats(msg, &format, &processed, &dropped);
+
+    std::lock_guard<std::mutex> lock(m_qosMutex);
+
+    // Counters are cumulative per posting element since its last state change.
+    // autovideosink posts from its internal child sink, so key by the real source.
+    if (format == GST_FORMAT_BUFFERS || format == GST_FORMAT_DEFAULT)
+    {
+        auto& last = m_qos.lastCounts[GST_MESSAGE_SRC(msg)];
+        if (processed < last.first || dropped < last.second)
+        {
+            last = {0, 0};
+        }
+        m_qos.windowProcessed += processed - last.first;
+        m_qos.windowDropped   += dropped - last.second;
+        m_qos.totalProcessed  += processed - last.first;
+        m_qos.totalDropped    += dropped - last.second;
+        last = {processed, dropped};
+    }
+
+    // Positive jitter is how late the buffer was
+    if (jitter > 0)
+    {
+        m_qos.windowLatenessNs += jitter;
+    }
+    ++m_qos.windowMessages;
+}
+
+void PipelineHandler::evaluateQos()
+{
+    // decoder is swapped under m_mutex by rebuilds. Whoever holds it may be joining this
+    // thread, so skip the round rather than wait; the window is evaluated on the next one.
+    std::unique_lock<std::mutex> pipelineLock(m_mutex, std::try_to_lock);
+    if (!pipelineLock.owns_lock())
+    {
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const int level = m_decodeLevel.load();
+    int newLevel = level;
+    std::string reason;
+
+    {
+        std::lock_guard<std::mutex> lock(m_qosMutex);
+        if (now - m_qos.windowStart < std::chrono::milliseconds(QOS_WINDOW_MS))
+        {
+            return;
+        }
+
+        const guint64 total = m_qos.windowProcessed + m_qos.windowDropped;
+        const double dropRatio = total > 0 ? static_cast<double>(m_qos.windowDropped) / total : 0.0;
+        m_qos.avgLatenessMs = m_qos.windowMessages > 0 ? m_qos.windowLatenessNs / 1e6 / m_qos.windowMessages : 0.0;
+
+        const bool bOverloaded = dropRatio > QOS_DROP_RATIO_THRESHOLD || m_qos.avgLatenessMs > QOS_LATENESS_THRESHOLD_MS;
+        if (m_qos.recoverHoldMs == 0)
+        {
+            m_qos.recoverHoldMs = QOS_RECOVER_HOLD_MS;
+        }
+
+        if (bOverloaded)
+        {
+            m_qos.lastLate = now;
+            if (level < QOS_LEVEL_KEYFRAMES_ONLY && now - m_qos.lastChange >= std::chrono::milliseconds(QOS_DEGRADE_HOLD_MS))
+            {
+                // Overload right after stepping back up: wait longer before the next try
+                if (m_qos.lastChange.time_since_epoch().count() != 0 &&
+                    now - m_qos.lastChange < std::chrono::milliseconds(m_qos.recoverHoldMs + QOS_DEGRADE_HOLD_MS))
+                {
+                    m_qos.recoverHoldMs = std::min(m_qos.recoverHoldMs * 2, QOS_RECOVER_HOLD_MAX_MS);
+                }
+
+                newLevel = level + 1;
+                std::ostringstream oss;
+                oss << "dropped " << static_cast<int>(dropRatio * 100) << "%, late " << static_cast<int>(m_qos.avgLatenessMs) << "ms";
+                reason = oss.str();
+            }
+        }
+        else if (level > QOS_LEVEL_FULL &&
+                 now - m_qos.lastLate >= std::chrono::milliseconds(m_qos.recoverHoldMs) &&
+                 now - m_qos.lastChange >= std::chrono::milliseconds(m_qos.recoverHoldMs))
+        {
+            newLevel = level - 1;
+            reason = "no late frames for " + std::to_string(m_qos.recoverHoldMs / 1000) + "s";
+        }
+        else if (level == QOS_LEVEL_FULL && now - m_qos.lastLate >= std::chrono::milliseconds(QOS_RECOVER_HOLD_MAX_MS))
+        {
+            m_qos.recoverHoldMs = QOS_RECOVER_HOLD_MS;
+        }
+
+        if (newLevel != level)
+        {
+            m_qos.lastChange = now;
+        }
+
+        m_qos.windowProcessed = 0;
+        m_qos.windowDropped = 0;
+        m_qos.windowLatenessNs = 0;
+        m_qos.windowMessages = 0;
+        m_qos.windowStart = now;
+    }
+
+    if (newLevel != level)
+    {
+        applyDecodeLevel(newLevel);
+        pipelineLock.unlock();
+
+        static const char* names[] = {"full decode", "non-reference frames skipped", "keyframes only"};
+        std::string message = std::string(newLevel > level ? "QoS overload (" : "QoS recovered (") + reason +
+                              "), decoder now at " + names[newLevel];
+        if (newLevel > level)
+        {
+            MX_LOG_WARN("PipelineHandler", message.c_str());
+        }
+        else
+        {
+            MX_LOG_INFO("PipelineHandler", message.c_str());
+        }
+        reportStatus(PipelineStatus::Information, message);
+    }
+}
+
+void PipelineHandler::applyDecodeLevel(int level)
+{
+    if (decoder)
+    {
+        // Never go below what admission control asked for
+        const int baseSkip = m_buildOptions.bReducedDecode ? 1 : 0;
+        g_object_set(G_OBJECT(decoder), "skip-frame", level >= QOS_LEVEL_SKIP_NONREF ? 1 : baseSkip, NULL);
+    }
+    m_decodeLevel.store(level);
+}
+
+void PipelineHandler::stopBusThread()
+{
+    m_isRunning = false;
+    ++m_busGeneration;
+    if (!m_busThread.joinable())
+    {
+        return;
+    }
+
+    // A bus message that ends in stop() runs on the bus thread itself, which cannot join
+    // itself; it sees the new generation and exits once the callback returns
+    if (m_busThread.get_id() == std::this_thread::get_id())
+    {
+        m_busThread.detach();
+    }
+    else
+    {
+        m_busThread.join();
+    }
+}
+
+void PipelineHandler::resetQos()
+{
+    std::lock_guard<std::mutex> lock(m_qosMutex);
+    m_qos = QosTracker();
+    m_decodeLevel.store(QOS_LEVEL_FULL);
+}
+
+GstPadProbeReturn PipelineHandler::decodeGateProbe(GstPad* pad, GstPadProbeInfo* info, gpointer data)
+{
+    PipelineHandler* handler = static_cast<PipelineHandler*>(data);
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (!buffer)
+    {
+        return GST_PAD_PROBE_OK;
+    }
+
+    // Parked: nothing reaches the decoder. The first dropped buffer flushes what the
+    // decoder still holds so it releases its frames and the display stops on the last one.
+    if (handler->m_bDisplayParked.load(std::memory_order_relaxed))
+    {
+        if (!handler->m_bGateFlushed)
+        {
+            flushDecoder(pad);
+            handler->m_bGateFlushed = true;
+        }
+        handler->m_bGateWaitKeyframe = true;
+        return GST_PAD_PROBE_DROP;
+    }
+    handler->m_bGateFlushed = false;
+
+    const bool bDelta = GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+    if (handler->m_bKeyframeOnly.load(std::memory_order_relaxed) ||
+        handler->m_decodeLevel.load(std::memory_order_relaxed) >= QOS_LEVEL_KEYFRAMES_ONLY)
+    {
+        handler->m_bGateWaitKeyframe = true;
+        return bDelta ? GST_PAD_PROBE_DROP : GST_PAD_PROBE_OK;
+    }
+
+    // Leaving keyframes-only: delta units before the next keyframe reference dropped frames
+    if (handler->m_bGateWaitKeyframe)
+    {
+        if (bDelta)
+        {
+            return GST_PAD_PROBE_DROP;
+        }
+        handler->m_bGateWaitKeyframe = false;
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+void PipelineHandler::flushDecoder(GstPad* decoderSink)
+{
+    // Runs on the only thread feeding this pad, so no buffer can race the flush and
+    // see FLUSHING. Flush-stop drops the sticky segment, so put it back afterwards.
+    GstEvent* segment = gst_pad_get_sticky_event(decoderSink, GST_EVENT_SEGMENT, 0);
+
+    // The decoder forwards the flush synchronously. It stops at its src pad: a flushed
+    // display sink loses its preroll and takes the whole pipeline back to PAUSED.
+    GstElement* decoder = gst_pad_get_parent_element(decoderSink);
+    GstPad* decoderSrc = decoder ? gst_element_get_static_pad(decoder, "src") : nullptr;
+    const gulong probeId = decoderSrc ? gst_pad_add_probe(decoderSrc, GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+                                                          &PipelineHandler::dropFlushProbe, nullptr, nullptr) : 0;
+
+    gst_pad_send_event(decoderSink, gst_event_new_flush_start());
+    gst_pad_send_event(decoderSink, gst_event_new_flush_stop(FALSE));
+
+    if (decoderSrc)
+    {
+        gst_pad_remove_probe(decoderSrc, probeId);
+        gst_object_unref(decoderSrc);
+    }
+    if (decoder)
+    {
+        gst_object_unref(decoder);
+    }
+
+    if (segment)
+    {
+        gst_pad_send_event(decoderSink, segment);
+    }
+}
+
+GstPadProbeReturn PipelineHandler::dropFlushProbe(GstPad* pad, GstPadProbeInfo* info, gpointer data)
+{
+    return GST_PAD_PROBE_DROP;
+}
+
+void PipelineHandler::setDisplayParked(bool bParked)
+{
+    if (m_bDisplayParked.exchange(bParked) == bParked)
+    {
+        return;
+    }
+
+    if (!m_gatePad)
+    {
+        MX_LOG_WARN("PipelineHandler", "park only applies to pipelines with a decode branch");
+    }
+    MX_LOG_INFO("PipelineHandler", ("pipeline " + std::to_string(m_pipelineId) +
+                                    (bParked ? " display parked" : " display unparked, waiting for keyframe")).c_str());
+}
+
+void PipelineHandler::setKeyframeOnly(bool bKeyframeOnly)
+{
+    if (m_bKeyframeOnly.exchange(bKeyframeOnly) == bKeyframeOnly)
+    {
+        return;
+    }
+    config.bKeyframeOnly = bKeyframeOnly;
+
+    if (!m_gatePad)
+    {
+        MX_LOG_WARN("PipelineHandler", "keyframe-only mode only applies to decoding pipelines");
+    }
+    MX_LOG_INFO("PipelineHandler", ("pipeline " + std::to_string(m_pipelineId) +
+                                    (bKeyframeOnly ? " decoding keyframes only" : " back to full rate decode")).c_str());
+}
+
+void PipelineHandler::setDecodeThreads(int threads)
+{
+    if (m_buildOptions.iDecodeThreads == threads)
+    {
+        return;
+    }
+    m_buildOptions.iDecodeThreads = threads;   // rebuilds use it straight away
+
+    if (!decoder)
+    {
+        return;
+    }
+
+    // libav reads max-threads when it opens the codec context. A decoder that has not
+    // started takes the property as it is; a running one is reopened at its next keyframe.
+    // The encoder's share only changes on a rebuild.
+    std::lock_guard<std::mutex> lock(m_reopenMutex);
+    if (GST_STATE(decoder) < GST_STATE_PAUSED)
+    {
+        g_object_set(G_OBJECT(decoder), "max-threads", decoderThreadsFor(threads), NULL);
+        m_iAppliedDecodeThreads = threads;
+        return;
+    }
+
+    m_iPendingDecodeThreads = threads;
+    if (!m_reopenProbeId)
+    {
+        GstPad* sinkPad = gst_element_get_static_pad(decoder, "sink");
+        m_reopenProbeId = gst_pad_add_probe(sinkPad, GST_PAD_PROBE_TYPE_BUFFER, &PipelineHandler::decoderReopenProbe, this, nullptr);
+        gst_object_unref(sinkPad);
+    }
+}
+
+int PipelineHandler::decoderThreadsFor(int share) const
+{
+    return share > 0 ? std::max(1, static_cast<int>(share / m_fEncodeLoad)) : share;
+}
+
+GstPadProbeReturn PipelineHandler::decoderReopenProbe(GstPad* pad, GstPadProbeInfo* info, gpointer data)
+{
+    PipelineHandler* handler = static_cast<PipelineHandler*>(data);
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (!buffer || GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT))
+    {
+        return GST_PAD_PROBE_OK;
+    }
+
+    std::lock_guard<std::mutex> lock(handler->m_reopenMutex);
+    if (handler->m_iPendingDecodeThreads < 0)
+    {
+        handler->m_reopenProbeId = 0;
+        return GST_PAD_PROBE_REMOVE;
+    }
+
+    // A pipeline state change holding the decoder's state lock waits for this thread's
+    // stream lock to deactivate the pad; leave the decoder to it and try the next keyframe
+    if (!GST_STATE_TRYLOCK(handler->decoder))
+    {
+        return GST_PAD_PROBE_OK;
+    }
+    const int threads = handler->m_iPendingDecodeThreads;
+    handler->reopenDecoder(pad, threads);
+    GST_STATE_UNLOCK(handler->decoder);
+
+    handler->m_iPendingDecodeThreads = -1;
+    handler->m_reopenProbeId = 0;
+    handler->m_iAppliedDecodeThreads = threads;
+    MX_LOG_INFO("PipelineHandler", ("pipeline " + std::to_string(handler->m_pipelineId) + " decoder reopened with " +
+                                    std::to_string(handler->decoderThreadsFor(threads)) + " threads").c_str());
+    return GST_PAD_PROBE_REMOVE;
+}
+
+void PipelineHandler::reopenDecoder(GstPad* decoderSink, int threads)
+{
+    g_object_set(G_OBJECT(decoder), "max-threads", decoderThreadsFor(threads), NULL);
+
+    // READY closes the codec context and clears the sink pad's sticky events. Back at the
+    // pipeline's state the decoder opens again on the caps replayed from upstream, ahead of
+    // this keyframe; only frames still inside the old threads are lost. The stream lock
+    // this thread holds is recursive, so deactivating the pad from here does not block.
+    gst_element_set_state(decoder, GST_STATE_READY);
+    gst_element_sync_state_with_parent(decoder);
+
+    GstPad* peer = gst_pad_get_peer(decoderSink);
+    if (peer)
+    {
+        gst_pad_sticky_events_foreach(peer, &PipelineHandler::replayStickyEvent, decoderSink);
+        gst_object_unref(peer);
+    }
+}
+
+gboolean PipelineHandler::replayStickyEvent(GstPad* pad, GstEvent** event, gpointer data)
+{
+    gst_pad_send_event(static_cast<GstPad*>(data), gst_event_ref(*event));
+    return TRUE;
+}
+
+///////////////////////////////////////////////    Relay passthrough   //////////////////////////////////////////
+
+bool PipelineHandler::isPassthroughRelay(const MediaStreamDevice& device)
+{
+    const MediaData& input = device.stinputMediaData;
+    const MediaData& output = device.stoutputMediaData;
+    if (input.esourceType != eSourceType::SOURCE_TYPE_NETWORK || output.esourceType != eSourceType::SOURCE_TYPE_NETWORK)
+    {
+        return false;
+    }
+
+    // HLS packaging needs the parser's codec_data and stream-format conversion
+    if (output.stNetworkStreaming.estreamingProtocol == eStreamingProtocol::STREAMING_PROTOCOL_HTTP || isTranscode(device) || isLadder(device))
+    {
+        return false;
+    }
+
+    // No output codec means "as received"
+    return output.stMediaCodec.evideocodec == eVideoCodec::VIDEO_CODEC_NONE ||
+           output.stMediaCodec.evideocodec == input.stMediaCodec.evideocodec;
+}
+
+///////////////////////////////////////////////    Audio   //////////////////////////////////////////
+
+bool PipelineHandler::containerCarries(eContainerFormat container, eAudioCodec codec)
+{
+    switch (container)
+    {
+    case eContainerFormat::CONTAINER_FORMAT_MP4:
+        return codec == eAudioCodec::AUDIO_CODEC_AAC || codec == eAudioCodec::AUDIO_CODEC_MP3;
+    case eContainerFormat::CONTAINER_FORMAT_MKV:
+        return codec == eAudioCodec::AUDIO_CODEC_AAC || codec == eAudioCodec::AUDIO_CODEC_MP3 ||
+               codec == eAudioCodec::AUDIO_CODEC_OPUS || codec == eAudioCodec::AUDIO_CODEC_FLAC ||
+               codec == eAudioCodec::AUDIO_CODEC_G711_ALAW || codec == eAudioCodec::AUDIO_CODEC_G711_ULAW;
+    default:
+        return false;
+    }
+}
+
+eAudioRoute PipelineHandler::audioRoute(const MediaStreamDevice& device, eAudioCodec& target)
+{
+    // The output's audio codec is the request: NONE means no audio, the input codec means as received
+    const eAudioCodec input = device.stinputMediaData.stMediaCodec.eaudiocodec;
+    const MediaData& output = device.stoutputMediaData;
+    target = output.stMediaCodec.eaudiocodec;
+    if (input == eAudioCodec::AUDIO_CODEC_NONE || target == eAudioCodec::AUDIO_CODEC_NONE ||
+        device.stinputMediaData.esourceType != eSourceType::SOURCE_TYPE_NETWORK)
+    {
+        return eAudioRoute::AUDIO_ROUTE_NONE;
+    }
+
+    if (output.esourceType == eSourceType::SOURCE_TYPE_DISPLAY)
+    {
+        // A wall tile is one of many pictures on a shared surface; it has no sound of its own
+        return device.sMosaic.empty() ? eAudioRoute::AUDIO_ROUTE_PLAYBACK : eAudioRoute::AUDIO_ROUTE_NONE;
+    }
+
+    if (output.esourceType == eSourceType::SOURCE_TYPE_FILE)
+    {
+        const eContainerFormat container = output.stFileSource.econtainerFormat;
+        if (target == input && containerCarries(container, input))
+        {
+            return eAudioRoute::AUDIO_ROUTE_PASSTHROUGH;
+        }
+        // G.711 as received does not fit MP4: store it in the container's usual codec instead
+        if (target == input)
+        {
+            target = container == eContainerFormat::CONTAINER_FORMAT_MKV ? eAudioCodec::AUDIO_CODEC_OPUS : eAudioCodec::AUDIO_CODEC_AAC;
+        }
+        if (!containerCarries(container, target))
+        {
+            return eAudioRoute::AUDIO_ROUTE_NONE;
+        }
+    }
+    else if (output.esourceType == eSourceType::SOURCE_TYPE_NETWORK)
+    {
+        // Served, RTP, HLS and ladder outputs carry video only; rtspclientsink payloads whatever it gets
+        const eStreamingProtocol protocol = output.stNetworkStreaming.estreamingProtocol;
+        if (output.stNetworkStreaming.bServe || protocol == eStreamingProtocol::STREAMING_PROTOCOL_RTP ||
+            protocol == eStreamingProtocol::STREAMING_PROTOCOL_HTTP || isLadder(device))
+        {
+            return eAudioRoute::AUDIO_ROUTE_NONE;
+        }
+        if (target == input)
+        {
+            return eAudioRoute::AUDIO_ROUTE_PASSTHROUGH;
+        }
+    }
+    else
+    {
+        return eAudioRoute::AUDIO_ROUTE_NONE;
+    }
+
+    return (target == eAudioCodec::AUDIO_CODEC_AAC || target == eAudioCodec::AUDIO_CODEC_OPUS)
+         ? eAudioRoute::AUDIO_ROUTE_TRANSCODE : eAudioRoute::AUDIO_ROUTE_NONE;
+}
+
+bool PipelineHandler::buildAudioBranch(const MediaStreamDevice& device, eAudioCodec target)
+{
+    const eAudioCodec input = device.stinputMediaData.stMediaCodec.eaudiocodec;
+    const auto parserFor = [](eAudioCodec codec) -> GstElement*
+    {
+        switch (codec)
+        {
+        case eAudioCodec::AUDIO_CODEC_AAC:  return CMx_ParseFactory::createParser("pipeliene", MEDIA_TYPE_AUDIO_AAC);
+        case eAudioCodec::AUDIO_CODEC_MP3:  return CMx_ParseFactory::createParser("pipeliene", MEDIA_TYPE_AUDIO_MPEG);
+        case eAudioCodec::AUDIO_CODEC_OPUS: return CMx_ParseFactory::createParser("pipeliene", MEDIA_TYPE_AUDIO_OPUS);
+        case eAudioCodec::AUDIO_CODEC_FLAC: return CMx_ParseFactory::createParser("pipeliene", MEDIA_TYPE_AUDIO_FLAC);
+        default:                            return nullptr;     // G.711 frames need no parsing
+        }
+    };
+
+    std::vector<GstElement*> chain;
+    bool bComplete = true;
+    const auto add = [&chain, &bComplete](GstElement* element)
+    {
+        bComplete = bComplete && element != nullptr;
+        if (element)
+        {
+            chain.push_back(element);
+        }
+    };
+
+    // The queue gives audio its own thread, and room to wait while the muxer holds out for video
+    add(CMx_DepayloaderFactory::createDepayloaderforAudio("pipeliene", input));
+    GstElement* queue = gst_element_factory_make("queue", "queue_audio");
+    if (queue)
+    {
+        g_object_set(G_OBJECT(queue), "max-size-buffers", 0, "max-size-bytes", 0,
+                     "max-size-time", static_cast<guint64>(AUDIO_QUEUE_TIME_NS), NULL);
+    }
+    add(queue);
+
+    if (m_eAudioRoute == eAudioRoute::AUDIO_ROUTE_PASSTHROUGH)
+    {
+        if (GstElement* audioParser = parserFor(input))
+        {
+            add(audioParser);
+        }
+    }
+    else
+    {
+        const char* decoderName = nullptr;
+        switch (input)
+        {
+        case eAudioCodec::AUDIO_CODEC_G711_ALAW: decoderName = "alawdec"; break;
+        case eAudioCodec::AUDIO_CODEC_G711_ULAW: decoderName = "mulawdec"; break;
+        case eAudioCodec::AUDIO_CODE_G726:       decoderName = "avdec_g726"; break;
+        case eAudioCodec::AUDIO_CODEC_AAC:       decoderName = "avdec_aac"; break;
+        case eAudioCodec::AUDIO_CODEC_MP3:       decoderName = "avdec_mp3"; break;
+        case eAudioCodec::AUDIO_CODEC_OPUS:      decoderName = "opusdec"; break;
+        default: break;
+        }
+        add(decoderName ? gst_element_factory_make(decoderName, "audio_decode") : nullptr);
+        add(gst_element_factory_make("audioconvert", "audio_convert"));
+        add(gst_element_factory_make("audioresample", "audio_resample"));
+
+        if (m_eAudioRoute == eAudioRoute::AUDIO_ROUTE_TRANSCODE)
+        {
+            // Opus only encodes at a handful of rates; 48 kHz is what every player expects from it
+            const eAudioSampleRate rate = device.stoutputMediaData.stMediaCodec.eaudioSampleRate;
+            const int sampleRate = target == eAudioCodec::AUDIO_CODEC_OPUS ? OPUS_SAMPLE_RATE
+                                 : (rate == eAudioSampleRate::AUDIO_SAMPLE_RATE_K48 ? 48000
+                                 : (rate == eAudioSampleRate::AUDIO_SAMPLE_RATE_K44_1 ? 44100 : 0));
+            if (sampleRate > 0)
+            {
+                GstElement* rateFilter = gst_element_factory_make("capsfilter", "audio_filter");
+                if (rateFilter)
+                {
+                    GstCaps* caps = gst_caps_new_simple("audio/x-raw", "rate", G_TYPE_INT, sampleRate, NULL);
+                    g_object_set(G_OBJECT(rateFilter), "caps", caps, NULL);
+                    gst_caps_unref(caps);
+                }
+                add(rateFilter);
+            }
+            add(gst_element_factory_make(target == eAudioCodec::AUDIO_CODEC_OPUS ? "opusenc" : "avenc_aac", "audio_encode"));
+            if (GstElement* audioParser = parserFor(target))
+            {
+                add(audioParser);
+            }
+        }
+        else
+        {
+            // Same clock and sync choice as the video sink next to it
+            GstElement* audioSink = gst_element_factory_make("autoaudiosink", "audio_sink");
+            if (audioSink && device.elatencyProfile == eLatencyProfile::LATENCY_PROFILE_LOW)
+            {
+                g_object_set(G_OBJECT(audioSink), "sync", FALSE, NULL);
+            }
+            add(audioSink);
+        }
+    }
+
+    if (!bComplete)
+    {
+        // Elements not yet in the bin are still floating; sink them before dropping them
+        for (GstElement* element : chain)
+        {
+            gst_object_unref(gst_object_ref_sink(element));
+        }
+        return false;
+    }
+
+    for (GstElement* element : chain)
+    {
+        gst_bin_add(GST_BIN(pipeline), element);
+    }
+    for (size_t i = 1; i < chain.size(); ++i)
+    {
+        if (!gst_element_link(chain[i - 1], chain[i]))
+        {
+            MX_LOG_ERROR("PipelineHandler", ("audio branch: cannot link " + std::string(GST_ELEMENT_NAME(chain[i - 1])) +
+                                             " to " + GST_ELEMENT_NAME(chain[i])).c_str());
+        }
+    }
+
+    audiodepay = chain.front();
+    // Playback ends in its own sink; the other routes leave a tail for the muxer or rtspclientsink
+    m_audioTail = m_eAudioRoute == eAudioRoute::AUDIO_ROUTE_PLAYBACK ? nullptr : chain.back();
+    MX_LOG_INFO("PipelineHandler", ("pipeline " + std::to_string(m_pipelineId) + ": audio " +
+                (m_eAudioRoute == eAudioRoute::AUDIO_ROUTE_PASSTHROUGH ? "passthrough" :
+                 m_eAudioRoute == eAudioRoute::AUDIO_ROUTE_TRANSCODE ? "transcoded" : "played")).c_str());
+    return true;
+}
+
+gboolean PipelineHandler::onSelectStream(GstElement* src, guint num, GstCaps* caps, gpointer data)
+{
+    // Unwanted audio is never SETUP: no RTP crosses the network for it, nothing depays or decodes it
+    PipelineHandler* self = static_cast<PipelineHandler*>(data);
+    const GstStructure* structure = caps && !gst_caps_is_empty(caps) ? gst_caps_get_structure(caps, 0) : nullptr;
+    const gchar* media = structure ? gst_structure_get_string(structure, "media") : nullptr;
+    return g_strcmp0(media, "audio") != 0 || self->audiodepay != nullptr;
+}
+
+void PipelineHandler::onNoMorePads(GstElement* src, gpointer data)
+{
+    PipelineHandler* self = static_cast<PipelineHandler*>(data);
+    if (!self->audiodepay)
+    {
+        return;
+    }
+
+    GstPad* sinkPad = gst_element_get_static_pad(self->audiodepay, "sink");
+    if (!sinkPad || gst_pad_is_linked(sinkPad))
+    {
+        if (sinkPad)
+        {
+            gst_object_unref(sinkPad);
+        }
+        return;
+    }
+
+    // The camera sent no usable audio: without this the muxer, or rtspclientsink's ANNOUNCE, waits for it forever
+    MX_LOG_WARN("PipelineHandler", ("pipeline " + std::to_string(self->m_pipelineId) + ": no audio from the camera, continuing with video").c_str());
+    if (self->config.stoutputMediaData.esourceType == eSourceType::SOURCE_TYPE_NETWORK && self->m_audioTail)
+    {
+        GstPad* tailSrc = gst_element_get_static_pad(self->m_audioTail, "src");
+        GstPad* peer = gst_pad_get_peer(tailSrc);
+        if (peer)
+        {
+            gst_pad_unlink(tailSrc, peer);
+            gst_element_release_request_pad(self->sink, peer);
+            gst_object_unref(peer);
+        }
+        gst_object_unref(tailSrc);
+    }
+    else
+    {
+        gst_pad_send_event(sinkPad, gst_event_new_eos());
+    }
+    gst_object_unref(sinkPad);
+}
+
+///////////////////////////////////////////////    Transcoding   //////////////////////////////////////////
+
+bool PipelineHandler::isTranscode(const MediaStreamDevice& device)
+{
+    const MediaData& input = device.stinputMediaData;
+    const MediaData& output = device.stoutputMediaData;
+    if (isLadder(device) ||
+        (output.esourceType != eSourceType::SOURCE_TYPE_NETWORK && output.esourceType != eSourceType::SOURCE_TYPE_FILE))
+    {
+        return false;
+    }
+
+    if (outputCodec(device) != input.stMediaCodec.evideocodec)
+    {
+        return true;
+    }
+    if (output.stMediaCodec.bitrate > 0 && output.stMediaCodec.bitrate != input.stMediaCodec.bitrate)
+    {
+        return true;
+    }
+
+    const Resolution& in = input.stResolution;
+    const Resolution& out = output.stResolution;
+    return (out.width > 0 && out.height > 0 && (out.width != in.width || out.height != in.height)) ||
+           (out.frameRate > 0.0f && (in.frameRate <= 0.0f || out.frameRate < in.frameRate));
+}
+
+bool PipelineHandler::isLadder(const MediaStreamDevice& device)
+{
+    const MediaData& output = device.stoutputMediaData;
+    return !output.vRenditions.empty() && output.esourceType == eSourceType::SOURCE_TYPE_NETWORK &&
+           (output.stNetworkStreaming.bServe ||
+            output.stNetworkStreaming.estreamingProtocol == eStreamingProtocol::STREAMING_PROTOCOL_HTTP);
+}
+
+float PipelineHandler::encodeLoadFactor(const MediaStreamDevice& device)
+{
+    const size_t encoders = isLadder(device) ? device.stoutputMediaData.vRenditions.size() : (isTranscode(device) ? 1 : 0);
+    return 1.0f + ENCODER_LOAD_WEIGHT * static_cast<float>(encoders);
+}
+
+double PipelineHandler::renditionArea(const Rendition& rendition)
+{
+    return rendition.iWidth > 0 ? static_cast<double>(rendition.iWidth) * rendition.iHeight : 1920.0 * 1080.0;
+}
+
+float PipelineHandler::ladderEncodeLoad(const MediaStreamDevice& device)
+{
+    if (!isLadder(device))
+    {
+        return 0.0f;
+    }
+
+    const float sourceRate = device.stinputMediaData.stResolution.frameRate;
+    double load = 0.0;
+    for (const Rendition& rendition : device.stoutputMediaData.vRenditions)
+    {
+        // Only lower rates apply, as in buildLadder
+        float rate = sourceRate > 0.0f ? sourceRate : 25.0f;
+        if (rendition.fFrameRate > 0.0f && (sourceRate <= 0.0f || rendition.fFrameRate < sourceRate))
+        {
+            rate = rendition.fFrameRate;
+        }
+        load += ENCODER_LOAD_WEIGHT * renditionArea(rendition) / (1920.0 * 1080.0) * rate / 25.0;
+    }
+    return static_cast<float>(load);
+}
+
+eVideoCodec PipelineHandler::outputCodec(const MediaStreamDevice& device)
+{
+    const eVideoCodec codec = device.stoutputMediaData.stMediaCodec.evideocodec;
+    return codec == eVideoCodec::VIDEO_CODEC_NONE ? device.stinputMediaData.stMediaCodec.evideocodec : codec;
+}
+
+bool PipelineHandler::buildDecodeStage(eVideoCodec inputCodec, int decodeThreads)
+{
+    if (inputCodec != eVideoCodec::VIDEO_CODEC_H264 && inputCodec != eVideoCodec::VIDEO_CODEC_H265)
+    {
+        MX_LOG_ERROR("PipelineHandler", "Transcoding supports H.264 and H.265 input only");
+        return false;
+    }
+
+    decoder = gst_element_factory_make(inputCodec == eVideoCodec::VIDEO_CODEC_H265 ? "avdec_h265" : "avdec_h264", "decode");
+    convert = gst_element_factory_make("videoconvert", "convert");
+    if (!decoder || !convert)
+    {
+        if (decoder) gst_object_unref(decoder);
+        if (convert) gst_object_unref(convert);
+        decoder = convert = nullptr;
+        return false;
+    }
+
+    if (decodeThreads > 0)
+    {
+        g_object_set(G_OBJECT(decoder), "max-threads", decodeThreads, NULL);
+    }
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(decoder), "thread-type"))
+    {
+        g_object_set(G_OBJECT(decoder), "thread-type", AVDEC_THREAD_TYPE_SLICE, NULL);
+    }
+
+    // parse+decode share the depay queue's thread; the encoders work behind the decoder queue
+    gst_bin_add_many(GST_BIN(pipeline), decoder, convert, NULL);
+    if (!gst_element_link(prevElement, decoder) || !gst_element_link(insertQueue(eQueueStage::QUEUE_STAGE_DECODER, decoder), convert))
+    {
+        MX_LOG_ERROR("PipelineHandler", "Failed to link decode stage");
+        return false;
+    }
+    prevElement = convert;
+    return true;
+}
+
+GstElement* PipelineHandler::buildEncodeBranch(GstElement* upstream, const std::string& suffix, eVideoCodec codec,
+                                               const MediaCodec& settings, const Resolution& size, int bitrate,
+                                               float sourceRate, int threads)
+{
+    const bool bH265 = codec == eVideoCodec::VIDEO_CODEC_H265;
+    if (!bH265 && codec != eVideoCodec::VIDEO_CODEC_H264)
+    {
+        MX_LOG_ERROR("PipelineHandler", "Transcoding supports H.264 and H.265 output only");
+        return nullptr;
+    }
+
+    GstElement* scale  = gst_element_factory_make("videoscale", ("scale" + suffix).c_str());
+    GstElement* rate   = gst_element_factory_make("videorate", ("rate" + suffix).c_str());
+    GstElement* caps   = gst_element_factory_make("capsfilter", ("rawcaps" + suffix).c_str());
+    GstElement* encode = gst_element_factory_make(bH265 ? "x265enc" : "x264enc", ("encode" + suffix).c_str());
+    GstElement* parse  = gst_element_factory_make(bH265 ? "h265parse" : "h264parse", ("outparse" + suffix).c_str());
+    if (!scale || !rate || !caps || !encode || !parse)
+    {
+        GstElement* created[] = {scale, rate, caps, encode, parse};
+        for (GstElement* element : created)
+        {
+            if (element)
+            {
+                gst_object_unref(element);
+            }
+        }
+        return nullptr;
+    }
+
+    // Only scale or drop frames when asked to; videorate never duplicates
+    std::string rawCaps = "video/x-raw";
+    if (size.width > 0 && size.height > 0)
+    {
+        rawCaps += ",width=" + std::to_string(size.width) + ",height=" + std::to_string(size.height);
+    }
+    if (size.frameRate > 0.0f)
+    {
+        rawCaps += ",framerate=" + std::to_string(static_cast<int>(size.frameRate * 1000)) + "/1000";
+    }
+    GstCaps* filterCaps = gst_caps_from_string(rawCaps.c_str());
+    g_object_set(G_OBJECT(caps), "caps", filterCaps, NULL);
+    gst_caps_unref(filterCaps);
+    g_object_set(G_OBJECT(rate), "drop-only", TRUE, NULL);
+
+    // Live tuning: no lookahead or B-frame delay, a keyframe every couple of seconds
+    if (bitrate > 0)
+    {
+        g_object_set(G_OBJECT(encode), "bitrate", static_cast<guint>(bitrate), NULL);
+    }
+    gst_util_set_object_arg(G_OBJECT(encode), "tune", "zerolatency");
+    gst_util_set_object_arg(G_OBJECT(encode), "speed-preset", settings.preset.empty() ? TRANSCODE_DEFAULT_PRESET : settings.preset.c_str());
+    const float frameRate = size.frameRate > 0.0f ? size.frameRate : (sourceRate > 0.0f ? sourceRate : 25.0f);
+    g_object_set(G_OBJECT(encode), "key-int-max", static_cast<int>(frameRate * TRANSCODE_GOP_SECONDS), NULL);
+    if (threads > 0)
+    {
+        if (bH265)
+        {
+            // x265 sizes its worker pool from an option string; one frame thread avoids frame delay
+            const std::string options = "pools=" + std::to_string(threads) + ":frame-threads=1";
+            g_object_set(G_OBJECT(encode), "option-string", options.c_str(), NULL);
+        }
+        else
+        {
+            g_object_set(G_OBJECT(encode), "threads", static_cast<guint>(threads), NULL);
+        }
+    }
+
+    // Parameter sets before every keyframe, so every output can start anywhere
+    g_object_set(G_OBJECT(parse), "config-interval", -1, NULL);
+
+    gst_bin_add_many(GST_BIN(pipeline), scale, rate, caps, encode, parse, NULL);
+    bool bLinked = gst_element_link_many(upstream, scale, rate, caps, encode, NULL);
+
+    // The encoder takes its profile from downstream caps
+    GstCaps* profileCaps = gst_caps_from_string(bH265 ? "video/x-h265" : "video/x-h264");
+    if (!settings.profile.empty())
+    {
+        gst_caps_set_simple(profileCaps, "profile", G_TYPE_STRING, settings.profile.c_str(), NULL);
+    }
+    bLinked = bLinked && gst_element_link_filtered(encode, parse, profileCaps);
+    gst_caps_unref(profileCaps);
+    if (!bLinked)
+    {
+        MX_LOG_ERROR("PipelineHandler", ("Failed to link encode branch" + suffix).c_str());
+        return nullptr;
+    }
+
+    MX_LOG_INFO("PipelineHandler", ("Encoding " + std::string(bH265 ? "H.265" : "H.264") +
+                                    (bitrate > 0 ? " at " + std::to_string(bitrate) + " kbit/s" : std::string()) +
+                                    (size.width > 0 ? ", " + std::to_string(size.width) + "x" + std::to_string(size.height) : std::string())).c_str());
+    return parse;
+}
+
+bool PipelineHandler::buildTranscodeStage(const MediaStreamDevice& device)
+{
+    const MediaData& inputData = device.stinputMediaData;
+    const MediaData& outputData = device.stoutputMediaData;
+
+    // The pipeline's share of the thread budget covers both codecs; encoding is the heavier side
+    const int threads = m_buildOptions.iDecodeThreads;
+    const int decodeThreads = threads > 0 ? std::max(1, static_cast<int>(threads / encodeLoadFactor(device))) : 0;
+    if (!buildDecodeStage(inputData.stMediaCodec.evideocodec, decodeThreads))
+    {
+        return false;
+    }
+
+    const int bitrate = outputData.stMediaCodec.bitrate > 0 ? outputData.stMediaCodec.bitrate : inputData.stMediaCodec.bitrate;
+    parser2 = buildEncodeBranch(prevElement, "", outputCodec(device), outputData.stMediaCodec, outputData.stResolution,
+                                bitrate, inputData.stResolution.frameRate, threads > 0 ? std::max(1, threads - decodeThreads) : 0);
+    if (!parser2)
+    {
+        return false;
+    }
+    prevElement = parser2;
+    return true;
+}
+
+bool PipelineHandler::buildLadder(const MediaStreamDevice& device)
+{
+    const MediaData& inputData = device.stinputMediaData;
+    const MediaData& outputData = device.stoutputMediaData;
+    const NetworkStreaming& network = outputData.stNetworkStreaming;
+    const bool bHls = network.estreamingProtocol == eStreamingProtocol::STREAMING_PROTOCOL_HTTP && !network.bServe;
+
+    const int threads = m_buildOptions.iDecodeThreads;
+    const int decodeThreads = threads > 0 ? std::max(1, static_cast<int>(threads / encodeLoadFactor(device))) : 0;
+    if (!buildDecodeStage(inputData.stMediaCodec.evideocodec, decodeThreads))
+    {
+        return false;
+    }
+
+    GstElement* tee = gst_element_factory_make("tee", "ladder");
+    if (!tee)
+    {
+        return false;
+    }
+    gst_bin_add(GST_BIN(pipeline), tee);
+    gst_element_link(prevElement, tee);
+
+    // Encoder threads follow each rendition's share of the ladder's pixels
+    double totalArea = 0.0;
+    for (const Rendition& rendition : outputData.vRenditions)
+    {
+        totalArea += renditionArea(rendition);
+    }
+    const int encodeThreads = threads > 0 ? std::max(1, threads - decodeThreads) : 0;
+
+    m_renditions.clear();
+    m_renditions.reserve(outputData.vRenditions.size());
+    for (size_t i = 0; i < outputData.vRenditions.size(); ++i)
+    {
+        const Rendition& rendition = outputData.vRenditions[i];
+        const std::string suffix = "_" + std::to_string(i);
+
+        // Each branch gets its own thread; a slow encoder must not stall the tee for the others
+        GstElement* queue = gst_element_factory_make("queue", ("ladder_queue" + suffix).c_str());
+        if (!queue)
+        {
+            return false;
+        }
+        g_object_set(G_OBJECT(queue), "max-size-buffers", LADDER_QUEUE_FRAMES, "max-size-bytes", 0,
+                     "max-size-time", static_cast<guint64>(0), "leaky", static_cast<int>(eQueueLeaky::QUEUE_LEAKY_DOWNSTREAM), NULL);
+        gst_bin_add(GST_BIN(pipeline), queue);
+        gst_element_link(tee, queue);
+
+        Resolution size;
+        size.width = rendition.iWidth;
+        size.height = rendition.iHeight;
+        size.frameRate = (rendition.fFrameRate > 0.0f &&
+                          (inputData.stResolution.frameRate <= 0.0f || rendition.fFrameRate < inputData.stResolution.frameRate))
+                       ? rendition.fFrameRate : 0.0f;
+        const int bitrate = rendition.iBitrate > 0 ? rendition.iBitrate : outputData.stMediaCodec.bitrate;
+        const double area = renditionArea(rendition);
+        const int branchThreads = encodeThreads > 0 ? std::max(1, static_cast<int>(encodeThreads * area / totalArea + 0.5)) : 0;
+
+        RenditionBranch branch;
+        branch.config = rendition;
+        branch.parser = buildEncodeBranch(queue, suffix, outputCodec(device), outputData.stMediaCodec, size, bitrate,
+                                          inputData.stResolution.frameRate, branchThreads);
+        if (!branch.parser)
+        {
+            return false;
+        }
+
+        // Served renditions are read through their frame tap; HLS renditions package on their own appsink
+        GstElement* branchSink = nullptr;
+        if (bHls)
+        {
+            HlsStoreConfig storeConfig;
+            storeConfig.iTargetMs = network.iHlsSegmentMs;
+            storeConfig.iPlaylistSegments = network.iHlsPlaylistSegments;
+            storeConfig.iMaxBytes = network.iHlsStoreMaxBytes;
+            branch.hls = std::make_unique<HlsPackager>(std::make_shared<HlsSegmentStore>(storeConfig), network.iHlsSegmentMs);
+            branchSink = branch.hls->createSink(outputCodec(device), ("hlssink" + suffix).c_str());
+        }
+        else
+        {
+            branchSink = gst_element_factory_make("fakesink", ("sink" + suffix).c_str());
+            if (branchSink)
+            {
+                g_object_set(G_OBJECT(branchSink), "sync", FALSE, "async", FALSE, NULL);
+            }
+        }
+        if (!branchSink)
+        {
+            return false;
+        }
+        gst_bin_add(GST_BIN(pipeline), branchSink);
+        gst_element_link(branch.parser, branchSink);
+        m_renditions.push_back(std::move(branch));
+    }
+
+    MX_LOG_INFO("PipelineHandler", ("Rendition ladder with " + std::to_string(m_renditions.size()) +
+                                    " renditions from one decode").c_str());
+    return true;
+}
+
+std::string PipelineHandler::renditionEndpoint(size_t index) const
+{
+    return std::to_string(m_pipelineId) + "-" +
+           (m_renditions[index].config.sName.empty() ? std::to_string(index) : m_renditions[index].config.sName);
+}
+
+///////////////////////////////////////////////    RTSP server output   //////////////////////////////////////////
+
+void PipelineHandler::mountRtspOutput()
+{
+    const MediaData& output = config.stoutputMediaData;
+    if (output.esourceType != eSourceType::SOURCE_TYPE_NETWORK || !output.stNetworkStreaming.bServe || !m_sMountPath.empty())
+    {
+        return;
+    }
+
+    const std::string path = output.stNetworkStreaming.sMountPath.empty() ? "/camera/" + std::to_string(m_pipelineId)
+                                                                          : output.stNetworkStreaming.sMountPath;
+
+    // Late joiners to the shared media wait for a keyframe anyway; a small queue keeps them current.
+    // A drop would leave clients decoding deltas against a missing reference, so resync on the next keyframe.
+    FrameTapConfig tapConfig;
+    tapConfig.ePoint = eFrameTapPoint::FRAME_TAP_ENCODED;
+    tapConfig.iMaxQueued = RTSP_OUTPUT_TAP_QUEUE;
+    tapConfig.eDrop = eFrameTapDrop::FRAME_TAP_DROP_OLDEST;
+    tapConfig.bResyncOnDrop = true;
+
+    // A ladder serves the source stream as it was received, and each rendition below it
+    const eVideoCodec mainCodec = m_bLadder ? config.stinputMediaData.stMediaCodec.evideocodec : outputCodec(config);
+    if (RtspServerOutput::instance().addMount(path, m_pipelineId, mainCodec,
+            [this, tapConfig](FrameCallback callback) { return subscribeFrames(tapConfig, std::move(callback)); }))
+    {
+        m_sMountPath = path;
+    }
+
+    for (size_t i = 0; i < m_renditions.size(); ++i)
+    {
+        FrameTapConfig renditionTap = tapConfig;
+        renditionTap.iRendition = static_cast<int>(i);
+        const std::string renditionPath = path + "/" + (m_renditions[i].config.sName.empty() ? std::to_string(i)
+                                                                                            : m_renditions[i].config.sName);
+        if (RtspServerOutput::instance().addMount(renditionPath, m_pipelineId, outputCodec(config),
+                [this, renditionTap](FrameCallback callback) { return subscribeFrames(renditionTap, std::move(callback)); }))
+        {
+            m_renditions[i].sMountPath = renditionPath;
+        }
+    }
+}
+
+void PipelineHandler::unmountRtspOutput()
+{
+    if (!m_sMountPath.empty())
+    {
+        RtspServerOutput::instance().removeMount(m_sMountPath);
+        m_sMountPath.clear();
+    }
+    for (RenditionBranch& branch : m_renditions)
+    {
+        if (!branch.sMountPath.empty())
+        {
+            RtspServerOutput::instance().removeMount(branch.sMountPath);
+            branch.sMountPath.clear();
+        }
+    }
+}
+
+///////////////////////////////////////////////    RTP output   //////////////////////////////////////////
+
+GstElement* PipelineHandler::createRtpOutput(eVideoCodec codec, const NetworkStreaming& network)
+{
+    if (network.sIpAddress.empty() || network.iPort <= 0 || network.iPort > 65535)
+    {
+        MX_LOG_ERROR("PipelineHandler", ("RTP output needs a destination address and port, got '" + network.sIpAddress +
+                                         ":" + std::to_string(network.iPort) + "'").c_str());
+        return nullptr;
+    }
+
+    const char* payloaderName = codec == eVideoCodec::VIDEO_CODEC_H264 ? "rtph264pay" :
+                               (codec == eVideoCodec::VIDEO_CODEC_H265 ? "rtph265pay" : nullptr);
+    if (!payloaderName)
+    {
+        MX_LOG_ERROR("PipelineHandler", "RTP output supports H.264 and H.265 only");
+        return nullptr;
+    }
+
+    GstElement* bin = gst_bin_new("sink");
+    GstElement* payloader = gst_element_factory_make(payloaderName, "rtppay");
+    GstElement* udpsink = gst_element_factory_make("udpsink", "udpsink");
+    if (!payloader || !udpsink)
+    {
+        if (payloader) gst_object_unref(payloader);
+        if (udpsink) gst_object_unref(udpsink);
+        gst_object_unref(bin);
+        return nullptr;
+    }
+
+    // Parameter sets in band before every keyframe: multicast receivers join at any time
+    g_object_set(G_OBJECT(payloader), "pt", RTP_OUTPUT_PAYLOAD_TYPE, "config-interval", -1,
+                 "mtu", static_cast<guint>(std::max(network.iMtu, RTP_OUTPUT_MIN_MTU)), NULL);
+
+    // One send per packet whatever the number of receivers; the network replicates it.
+    // auto-multicast joins the group on the sending socket so local receivers see loopback.
+    g_object_set(G_OBJECT(udpsink), "host", network.sIpAddress.c_str(), "port", network.iPort,
+                 "auto-multicast", TRUE, "ttl-mc", network.iTtl, "sync", FALSE, "async", FALSE, NULL);
+    if (!network.sMulticastIface.empty())
+    {
+        g_object_set(G_OBJECT(udpsink), "multicast-iface", network.sMulticastIface.c_str(), NULL);
+    }
+    if (!SdpBuilder::isMulticast(network.sIpAddress))
+    {
+        MX_LOG_WARN("PipelineHandler", ("RTP output to unicast address " + network.sIpAddress +
+                                        ", egress grows with every extra destination").c_str());
+    }
+
+    gst_bin_add_many(GST_BIN(bin), payloader, udpsink, NULL);
+    gst_element_link(payloader, udpsink);
+
+    GstPad* payloaderSink = gst_element_get_static_pad(payloader, "sink");
+    gst_element_add_pad(bin, gst_ghost_pad_new("sink", payloaderSink));
+    gst_object_unref(payloaderSink);
+
+    m_rtpPayPad = gst_element_get_static_pad(payloader, "src");
+    m_rtpCapsHandler = g_signal_connect(m_rtpPayPad, "notify::caps", G_CALLBACK(&PipelineHandler::onRtpCaps), this);
+
+    MX_LOG_INFO("PipelineHandler", ("RTP output to " + network.sIpAddress + ":" + std::to_string(network.iPort) +
+                                    " ttl " + std::to_string(network.iTtl)).c_str());
+    return bin;
+}
+
+void PipelineHandler::onRtpCaps(GstPad* pad, GParamSpec* /*pspec*/, gpointer data)
+{
+    auto* self = static_cast<PipelineHandler*>(data);
+    GstCaps* caps = gst_pad_get_current_caps(pad);
+    if (!caps)
+    {
+        return;
+    }
+
+    const NetworkStreaming& network = self->config.stoutputMediaData.stNetworkStreaming;
+    SdpSession session;
+    session.sName = "pipeline " + std::to_string(self->m_pipelineId);
+    session.sAddress = network.sIpAddress;
+    session.iPort = network.iPort;
+    session.iTtl = network.iTtl;
+    const std::string sdp = SdpBuilder::build(session, caps);
+    gst_caps_unref(caps);
+    if (sdp.empty())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(self->m_sdpMutex);
+        if (sdp == self->m_sSdp)
+        {
+            return;
+        }
+        self->m_sSdp = sdp;
+    }
+
+    // Written beside and renamed, so a client never reads half a file
+    if (!network.sSdpPath.empty())
+    {
+        const std::string tmpPath = network.sSdpPath + ".tmp";
+        std::ofstream out(tmpPath, std::ios::trunc);
+        out << sdp;
+        out.close();
+        std::error_code ec;
+        std::filesystem::rename(tmpPath, network.sSdpPath, ec);
+        if (!out || ec)
+        {
+            MX_LOG_WARN("PipelineHandler", ("Cannot write SDP to " + network.sSdpPath).c_str());
+        }
+    }
+    MX_LOG_INFO("PipelineHandler", ("RTP session description updated for pipeline " + std::to_string(self->m_pipelineId)).c_str());
+}
+
+std::string PipelineHandler::getSdp()
+{
+    std::lock_guard<std::mutex> lock(m_sdpMutex);
+    return m_sSdp;
+}
+
+///////////////////////////////////////////////    HLS output   //////////////////////////////////////////
+
+void PipelineHandler::publishHls()
+{
+    if (m_hls && !m_bHlsPublished)
+    {
+        m_bHlsPublished = HlsServer::instance().publish(std::to_string(m_pipelineId), m_hls->store());
+    }
+
+    // A ladder publishes each rendition as its own stream and a multivariant playlist over them
+    bool bAny = false;
+    std::string master = "#EXTM3U\n#EXT-X-VERSION:7\n#EXT-X-INDEPENDENT-SEGMENTS\n";
+    for (size_t i = 0; i < m_renditions.size(); ++i)
+    {
+        RenditionBranch& branch = m_renditions[i];
+        if (!branch.hls)
+        {
+            continue;
+        }
+        if (!branch.bHlsPublished)
+        {
+            branch.bHlsPublished = HlsServer::instance().publish(renditionEndpoint(i), branch.hls->store());
+        }
+        bAny = bAny || branch.bHlsPublished;
+
+        // BANDWIDTH is the peak in bit/s; fMP4 framing adds a few percent on top of the encoder rate
+        const int kbps = branch.config.iBitrate > 0 ? branch.config.iBitrate
+                       : (config.stoutputMediaData.stMediaCodec.bitrate > 0 ? config.stoutputMediaData.stMediaCodec.bitrate
+                                                                             : config.stinputMediaData.stMediaCodec.bitrate);
+        master += "#EXT-X-STREAM-INF:BANDWIDTH=" + std::to_string(static_cast<long long>(std::max(kbps, 1)) * 1100);
+        if (branch.config.iWidth > 0 && branch.config.iHeight > 0)
+        {
+            master += ",RESOLUTION=" + std::to_string(branch.config.iWidth) + "x" + std::to_string(branch.config.iHeight);
+        }
+        master += "\n../" + renditionEndpoint(i) + "/index.m3u8\n";
+    }
+    if (bAny)
+    {
+        HlsServer::instance().publishMaster(std::to_string(m_pipelineId), master);
+    }
+}
+
+void PipelineHandler::unpublishHls()
+{
+    if (m_bHlsPublished)
+    {
+        HlsServer::instance().unpublish(std::to_string(m_pipelineId));
+        m_bHlsPublished = false;
+    }
+    for (size_t i = 0; i < m_renditions.size(); ++i)
+    {
+        if (m_renditions[i].bHlsPublished)
+        {
+            HlsServer::instance().unpublish(renditionEndpoint(i));
+            m_renditions[i].bHlsPublished = false;
+        }
+    }
+    if (!m_renditions.empty())
+    {
+        HlsServer::instance().unpublish(std::to_string(m_pipelineId));
+    }
+}
+
+///////////////////////////////////////////////    Display wall   //////////////////////////////////////////
+
+void PipelineHandler::attachMosaic()
+{
+    if (config.sMosaic.empty() || config.stoutputMediaData.esourceType != eSourceType::SOURCE_TYPE_DISPLAY || m_bMosaicAttached)
+    {
+        return;
+    }
+
+    // Latest picture wins: a tile that falls behind skips frames rather than showing old ones
+    FrameTapConfig tapConfig;
+    tapConfig.ePoint = eFrameTapPoint::FRAME_TAP_DECODED;
+    tapConfig.iMaxQueued = 1;
+    tapConfig.eDrop = eFrameTapDrop::FRAME_TAP_DROP_OLDEST;
+
+    m_bMosaicAttached = MosaicOutput::instance().attach(config.sMosaic, config.iMosaicTile, m_pipelineId,
+        [this, tapConfig](FrameCallback callback) { return subscribeFrames(tapConfig, std::move(callback)); });
+}
+
+void PipelineHandler::detachMosaic()
+{
+    if (m_bMosaicAttached)
+    {
+        MosaicOutput::instance().detach(config.sMosaic, config.iMosaicTile, m_pipelineId);
+        m_bMosaicAttached = false;
+    }
+}
+
+///////////////////////////////////////////////    Segmented recording   //////////////////////////////////////////
+
+GstElement* PipelineHandler::createSegmentSink(const MediaFileSource& fileSource)
+{
+    GstElement* splitmux = gst_element_factory_make("splitmuxsink", "sink");
+    if (!splitmux)
+    {
+        return nullptr;
+    }
+
+    // Segments must not overwrite each other; a template without {index} or {time} gets "_{index}"
+    const char* extension = fileSource.econtainerFormat == eContainerFormat::CONTAINER_FORMAT_MKV ? ".mkv" : ".mp4";
+    std::string pathTemplate = fileSource.sPathTemplate.empty() ? std::string("rec_{id}_{time}") + extension : fileSource.sPathTemplate;
+    if (pathTemplate.find("{index}") == std::string::npos && pathTemplate.find("{time}") == std::string::npos)
+    {
+        const size_t dot = pathTemplate.rfind('.');
+        const size_t slash = pathTemplate.rfind('/');
+        const size_t at = (dot != std::string::npos && (slash == std::string::npos || dot > slash)) ? dot : pathTemplate.size();
+        pathTemplate.insert(at, "_{index}");
+    }
+    m_sSegmentTemplate = pathTemplate;
+    m_iSegmentMaxFiles = fileSource.iMaxFiles;
+    if (!m_segmentThread.joinable())
+    {
+        m_segmentThread = std::thread(&PipelineHandler::segmentWorker, this);
+    }
+
+    if (muxer)
+    {
+        g_object_set(G_OBJECT(splitmux), "muxer", muxer, NULL);
+    }
+    if (fileSource.iSegmentSeconds > 0)
+    {
+        g_object_set(G_OBJECT(splitmux), "max-size-time", static_cast<guint64>(fileSource.iSegmentSeconds) * GST_SECOND, NULL);
+    }
+    if (fileSource.iSegmentMaxBytes > 0)
+    {
+        g_object_set(G_OBJECT(splitmux), "max-size-bytes", static_cast<guint64>(fileSource.iSegmentMaxBytes), NULL);
+    }
+
+    // splitmuxsink's own max-files only wraps the index, so rotation is done on close
+    g_signal_connect(splitmux, "format-location", G_CALLBACK(&PipelineHandler::formatLocation), this);
+    return splitmux;
+}
+
+std::string PipelineHandler::segmentLocation(guint fragmentId) const
+{
+    char timeText[32] = {0};
+    const time_t now = time(nullptr);
+    tm local{};
+    localtime_r(&now, &local);
+    strftime(timeText, sizeof(timeText), "%Y%m%d-%H%M%S", &local);
+
+    char indexText[16] = {0};
+    snprintf(indexText, sizeof(indexText), "%05u", fragmentId);
+
+    std::string location = m_sSegmentTemplate;
+    const std::pair<const char*, std::string> tokens[] = {
+        {"{id}", std::to_string(m_pipelineId)}, {"{index}", indexText}, {"{time}", timeText}};
+    for (const auto& [token, value] : tokens)
+    {
+        for (size_t pos = location.find(token); pos != std::string::npos; pos = location.find(token, pos + value.size()))
+        {
+            location.replace(pos, strlen(token), value);
+        }
+    }
+    return location;
+}
+
+gchar* PipelineHandler::formatLocation(GstElement* splitmux, guint fragmentId, gpointer data)
+{
+    PipelineHandler* handler = static_cast<PipelineHandler*>(data);
+    const std::string location = handler->segmentLocation(fragmentId);
+
+    std::error_code ec;
+    const std::filesystem::path parent = std::filesystem::path(location).parent_path();
+    if (!parent.empty())
+    {
+        std::filesystem::create_directories(parent, ec);
+    }
+    return g_strdup(location.c_str());
+}
+
+void PipelineHandler::onSegmentMessage(GstMessage* msg)
+{
+    const GstStructure* structure = gst_message_get_structure(msg);
+    if (!structure)
+    {
+        return;
+    }
+
+    const std::string name = gst_structure_get_name(structure);
+    GstClockTime runningTime = GST_CLOCK_TIME_NONE;
+    gst_structure_get_clock_time(structure, "running-time", &runningTime);
+
+    if (name == "splitmuxsink-fragment-opened")
+    {
+        m_segmentOpenedAt = runningTime;
+        return;
+    }
+    if (name != "splitmuxsink-fragment-closed")
+    {
+        return;
+    }
+
+    // Only bookkeeping here: this is the muxer's streaming thread
+    SegmentJob job;
+    const gchar* location = gst_structure_get_string(structure, "location");
+    job.segment.sLocation = location ? location : "";
+    job.segment.iIndex = ++m_iSegmentsClosed;
+    if (GST_CLOCK_TIME_IS_VALID(m_segmentOpenedAt) && GST_CLOCK_TIME_IS_VALID(runningTime) && runningTime >= m_segmentOpenedAt)
+    {
+        job.segment.iStartNs = m_segmentOpenedAt;
+        job.segment.iDurationNs = runningTime - m_segmentOpenedAt;
+    }
+    job.iMaxFiles = m_iSegmentMaxFiles;
+
+    {
+        std::lock_guard<std::mutex> lock(m_segmentMutex);
+        m_segmentJobs.push_back(std::move(job));
+    }
+    m_segmentCv.notify_all();
+}
+
+void PipelineHandler::markRecordingClosed()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_segmentMutex);
+        m_bSegmentClosed = true;
+    }
+    m_segmentCv.notify_all();
+}
+
+void PipelineHandler::segmentWorker()
+{
+    for (;;)
+    {
+        SegmentJob job;
+        {
+            std::unique_lock<std::mutex> lock(m_segmentMutex);
+            m_segmentCv.wait(lock, [this] { return m_bSegmentWorkerStop || !m_segmentJobs.empty(); });
+            if (m_segmentJobs.empty())
+            {
+                return;     // stopping and drained
+            }
+            job = std::move(m_segmentJobs.front());
+            m_segmentJobs.pop_front();
+        }
+
+        SegmentInfo& segment = job.segment;
+        std::error_code ec;
+        const auto bytes = std::filesystem::file_size(segment.sLocation, ec);
+        segment.iBytes = ec ? 0 : bytes;
+
+        if (job.iMaxFiles > 0 && !segment.sLocation.empty())
+        {
+            m_closedSegments.push_back(segment.sLocation);
+            while (m_closedSegments.size() > job.iMaxFiles)
+            {
+                std::filesystem::remove(m_closedSegments.front(), ec);
+                m_closedSegments.pop_front();
+            }
+        }
+
+        MX_LOG_INFO("PipelineHandler", ("pipeline " + std::to_string(m_pipelineId) + " segment closed: " + segment.sLocation +
+                    " (" + std::to_string(segment.iDurationNs / GST_MSECOND) + " ms, " + std::to_string(segment.iBytes) + " bytes)").c_str());
+
+        if (m_segmentCallback)
+        {
+            m_segmentCallback(m_pipelineId, segment);
+        }
+    }
+}
+
+void PipelineHandler::stopSegmentWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_segmentMutex);
+        m_bSegmentWorkerStop = true;
+    }
+    m_segmentCv.notify_all();
+
+    // Delivers what is still queued, including the segment closed by the final stop
+    if (m_segmentThread.joinable())
+    {
+        m_segmentThread.join();
+    }
+}
+
+void PipelineHandler::addSegmentPad(GstElement* upstream)
+{
+    if (!upstream)
+    {
+        return;
+    }
+    GstPad* src = gst_element_get_static_pad(upstream, "src");
+    if (GstPad* peer = gst_pad_get_peer(src))
+    {
+        m_segmentPads.push_back(peer);
+    }
+    gst_object_unref(src);
+}
+
+GstPadProbeReturn PipelineHandler::fileEosProbe(GstPad* pad, GstPadProbeInfo* info, gpointer data)
+{
+    if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_EOS)
+    {
+        static_cast<PipelineHandler*>(data)->markRecordingClosed();
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+void PipelineHandler::finalizeSegment()
+{
+    if (m_segmentPads.empty())
+    {
+        return;
+    }
+
+    // EOS on the muxer inputs alone, audio included: the muxer only finishes once every
+    // input has ended, then writes its index and the file closes.
+    // Asks the pipeline itself, m_state may already say STOPPED or ERROR while data still flows.
+    GstState current = GST_STATE_NULL;
+    gst_element_get_state(pipeline, &current, nullptr, 0);
+    if (current >= GST_STATE_PAUSED)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_segmentMutex);
+            m_bSegmentClosed = false;
+        }
+        for (GstPad* pad : m_segmentPads)
+        {
+            gst_pad_send_event(pad, gst_event_new_eos());
+        }
+
+        std::unique_lock<std::mutex> lock(m_segmentMutex);
+        if (!m_segmentCv.wait_for(lock, std::chrono::milliseconds(SEGMENT_FINALIZE_TIMEOUT_MS), [this] { return m_bSegmentClosed; }))
+        {
+            MX_LOG_WARN("PipelineHandler", ("pipeline " + std::to_string(m_pipelineId) + " last segment did not close in time").c_str());
+        }
+    }
+
+    for (GstPad* pad : m_segmentPads)
+    {
+        gst_object_unref(pad);
+    }
+    m_segmentPads.clear();
+    m_segmentOpenedAt = GST_CLOCK_TIME_NONE;
+}
+
+///////////////////////////////////////////////    Pre-event buffer   //////////////////////////////////////////
+
+void PipelineHandler::setPreEventConfig(const PreEventConfig& preEventConfig)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_preEvent.setConfig(preEventConfig);
+    if (!preEventConfig.bEnabled)
+    {
+        m_preEvent.detach();
+    }
+    else if (pipeline && encodedOutput())
+    {
+        m_preEvent.attach(encodedOutput());
+    }
+}
+
+bool PipelineHandler::triggerEventRecording(const EventRecordingRequest& request, std::string& location)
+{
+    std::string error;
+    if (!m_preEvent.trigger(m_pipelineId, request, location, error))
+    {
+        MX_LOG_WARN("PipelineHandler", ("pipeline " + std::to_string(m_pipelineId) + " event recording not started: " + error).c_str());
+        return false;
+    }
+    return true;
+}
+
+///////////////////////////////////////////////    Frame taps   //////////////////////////////////////////
+
+GstElement* PipelineHandler::tapElement(eFrameTapPoint point, int rendition) const
+{
+    if (rendition >= 0)
+    {
+        // Renditions share the decoder; only their encoded output is their own
+        if (point != eFrameTapPoint::FRAME_TAP_ENCODED || static_cast<size_t>(rendition) >= m_renditions.size())
+        {
+            return nullptr;
+        }
+        return m_renditions[static_cast<size_t>(rendition)].parser;
+    }
+    return point == eFrameTapPoint::FRAME_TAP_DECODED ? decoder : encodedOutput();
+}
+
+std::vector<PipelineHandler::TapPoint*> PipelineHandler::tapPointsLocked()
+{
+    std::vector<TapPoint*> points;
+    for (TapPoint& tapPoint : m_tapPoints)
+    {
+        points.push_back(&tapPoint);
+    }
+    for (auto& entry : m_renditionTapPoints)
+    {
+        points.push_back(&entry.second);
+    }
+    return points;
+}
+
+void PipelineHandler::installTapProbeLocked(TapPoint& tapPoint)
+{
+    if (tapPoint.probeId != 0)
+    {
+        return;
+    }
+
+    GstElement* element = tapElement(tapPoint.point, tapPoint.rendition);
+    if (!element)
+    {
+        return;
+    }
+
+    tapPoint.handler = this;
+    tapPoint.pad = gst_element_get_static_pad(element, "src");
+    if (tapPoint.pad)
+    {
+        tapPoint.probeId = gst_pad_add_probe(tapPoint.pad, GST_PAD_PROBE_TYPE_BUFFER, &PipelineHandler::frameTapProbe, &tapPoint, nullptr);
+    }
+}
+
+void PipelineHandler::removeTapProbesLocked()
+{
+    for (TapPoint* tapPoint : tapPointsLocked())
+    {
+        if (tapPoint->pad)
+        {
+            if (tapPoint->probeId != 0)
+            {
+                gst_pad_remove_probe(tapPoint->pad, tapPoint->probeId);
+            }
+            gst_object_unref(tapPoint->pad);
+        }
+        tapPoint->pad = nullptr;
+        tapPoint->probeId = 0;
+    }
+}
+
+FrameTapPtr PipelineHandler::subscribeFrames(const FrameTapConfig& tapConfig, FrameCallback callback)
+{
+    if (tapConfig.ePoint == eFrameTapPoint::FRAME_TAP_COUNT || !tapElement(tapConfig.ePoint, tapConfig.iRendition))
+    {
+        MX_LOG_WARN("PipelineHandler", ("pipeline " + std::to_string(m_pipelineId) + " has no element for the requested frame tap").c_str());
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_tapMutex);
+    TapPoint& tapPoint = tapConfig.iRendition >= 0 ? m_renditionTapPoints[tapConfig.iRendition]
+                                                   : m_tapPoints[static_cast<size_t>(tapConfig.ePoint)];
+    tapPoint.point = tapConfig.ePoint;
+    tapPoint.rendition = tapConfig.iRendition;
+
+    FrameTapPtr tap = FrameTap::create(m_iNextTapId++, tapConfig, std::move(callback));
+    tapPoint.taps.push_back(tap);
+    installTapProbeLocked(tapPoint);
+    return tap;
+}
+
+void PipelineHandler::unsubscribeFrames(const FrameTapPtr& tap)
+{
+    if (!tap)
+    {
+        return;
+    }
+
+    // The probe drops closed taps, and removes itself once a point has none left
+    tap->close();
+}
+
+GstPadProbeReturn PipelineHandler::frameTapProbe(GstPad* pad, GstPadProbeInfo* info, gpointer data)
+{
+    TapPoint* tapPoint = static_cast<TapPoint*>(data);
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (!buffer)
+    {
+        return GST_PAD_PROBE_OK;
+    }
+
+    std::lock_guard<std::mutex> lock(tapPoint->handler->m_tapMutex);
+
+    auto& taps = tapPoint->taps;
+    taps.erase(std::remove_if(taps.begin(), taps.end(), [](const FrameTapPtr& tap) { return tap->isClosed(); }), taps.end());
+    if (taps.empty())
+    {
+        // Returning REMOVE drops the probe; release the pad reference that came with it
+        gst_object_unref(tapPoint->pad);
+        tapPoint->pad = nullptr;
+        tapPoint->probeId = 0;
+        return GST_PAD_PROBE_REMOVE;
+    }
+
+    // One sample shared by every consumer; each queue holds a reference, nothing is copied
+    GstCaps* caps = gst_pad_get_current_caps(pad);
+    GstSample* sample = gst_sample_new(buffer, caps, nullptr, nullptr);
+    for (const FrameTapPtr& tap : taps)
+    {
+        tap->offer(sample);
+    }
+    gst_sample_unref(sample);
+    if (caps)
+    {
+        gst_caps_unref(caps);
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+///////////////////////////////////////////////    Thread placement   //////////////////////////////////////////
+
+GstBusSyncReply PipelineHandler::syncBusHandler(GstBus* bus, GstMessage* msg, gpointer data)
+{
+    // Runs on the posting thread; stream-status ENTER is posted by the streaming thread itself
+    if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_STREAM_STATUS)
+    {
+        static_cast<PipelineHandler*>(data)->onStreamStatus(msg);
+    }
+    else if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ELEMENT)
+    {
+        static_cast<PipelineHandler*>(data)->onSegmentMessage(msg);
+    }
+    else if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS)
+    {
+        // splitmuxsink keeps the EOS of every rotation to itself and only lets the one after
+        // its final fragment through, so a rotation closing during stop cannot end the wait
+        static_cast<PipelineHandler*>(data)->markRecordingClosed();
+    }
+    return GST_BUS_PASS;
+}
+
+void PipelineHandler::onStreamStatus(GstMessage* msg)
+{
+    GstStreamStatusType type;
+    GstElement* owner = nullptr;
+    gst_message_parse_stream_status(msg, &type, &owner);
+
+    // New streaming tasks run on the shared pool instead of a thread of their own
+    if (type == GST_STREAM_STATUS_TYPE_CREATE)
+    {
+        const GValue* value = gst_message_get_stream_status_object(msg);
+        if (value && G_VALUE_TYPE(value) == GST_TYPE_TASK)
+        {
+            if (GstTaskPool* pool = SharedTaskPool::instance().acquireGstPool())
+            {
+                gst_task_set_pool(GST_TASK(g_value_get_object(value)), pool);
+                gst_object_unref(pool);
+            }
+        }
+        return;
+    }
+
+    if (type != GST_STREAM_STATUS_TYPE_ENTER || m_buildOptions.vCpuSet.empty())
+    {
+        return;
+    }
+
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int cpu : m_buildOptions.vCpuSet)
+    {
+        CPU_SET(cpu, &cpus);
+    }
+
+    const int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (rc == 0)
+    {
+        m_iPinnedThreads.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        MX_LOG_WARN("PipelineHandler", ("failed to pin streaming thread of " + std::string(owner ? GST_ELEMENT_NAME(owner) : "?") +
+                                        ", error " + std::to_string(rc)).c_str());
+    }
+#endif
+}
+
+PipelineStatsSnapshot PipelineHandler::getStats(bool bAdvanceWindow)
+{
+    PipelineStatsSnapshot snapshot = m_stats.snapshot(m_pipelineId, bAdvanceWindow);
+
+    std::lock_guard<std::mutex> lock(m_qosMutex);
+    snapshot.iDecodeThreads = m_iAppliedDecodeThreads.load();
+    snapshot.iNumaNode      = m_buildOptions.iNumaNode;
+    snapshot.vCpuSet        = m_buildOptions.vCpuSet;
+    snapshot.iPinnedThreads = m_iPinnedThreads.load(std::memory_order_relaxed);
+    snapshot.bKeyframeOnly  = m_bKeyframeOnly.load();
+    snapshot.bPassthrough   = m_bPassthrough;
+    snapshot.bTranscode     = m_bTranscode;
+    snapshot.iRenditions    = m_renditions.size();
+    snapshot.eAudio         = m_eAudioRoute;
+    if (m_iActiveProfile >= 0 && m_iActiveProfile < static_cast<int>(config.vStreamProfiles.size()))
+    {
+        snapshot.sStreamProfile = config.vStreamProfiles[m_iActiveProfile].sName;
+    }
+    snapshot.bDisplayParked = m_bDisplayParked.load();
+
+    const PreEventSnapshot preEvent = m_preEvent.snapshot();
+    snapshot.fPreEventSeconds = preEvent.fBufferedSeconds;
+    snapshot.iPreEventBytes = preEvent.iBytes;
+    snapshot.bEventRecording = preEvent.bRecording;
+    snapshot.iDecodeLevel   = m_decodeLevel.load();
+    snapshot.iQosProcessed  = m_qos.totalProcessed;
+    snapshot.iQosDropped    = m_qos.totalDropped;
+    snapshot.fQosLatenessMs = m_qos.avgLatenessMs;
+    return snapshot;
+}
+
 //// Static pad added handler
 //void PipelineHandler::padAddedHandlerStatic(GstElement* src, GstPad* new_pad, gpointer data) {
 //    PipelineHandler* handler = static_cast<PipelineHandler*>(data);
@@ -10,12 +10,26 @@
 #include <atomic>
 #include <functional>
 #include <unordered_map>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <thread>
 #include "MediaStreamDevice.h"
 #include "PipelineProcess.h" // For PipelineStatus enum
 #include "PipelineHandler.h"
 #include "MxDepayloaderFactory.h"
 #include "Mx_ParseFactory.h"
 #include "StreamDiscoverer.h"
+#include "PipelineStats.h"
+#include "SharedTaskPool.h"
+#include "StreamProfileSelector.h"
+#include "FrameTap.h"
+#include "PreEventBuffer.h"
+#include "RtspServerOutput.h"
+#include "SdpBuilder.h"
+#include "HlsServer.h"
+#include "MosaicOutput.h"
 
 // Forward declaration
 struct MediaStreamDevice;
@@ -45,23 +59,24 @@ public:
 
 private:
 
-    GstElement* pipeline;
-    GstElement* source;
-    GstElement* depay;
-    GstElement* demuxer;
-    GstElement* parser;
-    GstElement* decoder;
-    GstElement* muxer;
-    GstElement* payloader;
-    GstElement* encoder;
-    GstElement* convert;
-    GstElement* sink;
-    GstElement* parser2;
-    GstElement* filter;
-    GstElement* videorate;
-    GstElement* videoscale;
-    GstElement* prevElement; // for generic pipeline create
-    GstElement* audiodepay;
+    GstElement* pipeline{nullptr};
+    GstElement* source{nullptr};
+    GstElement* depay{nullptr};
+    GstElement* demuxer{nullptr};
+    GstElement* parser{nullptr};
+    GstElement* decoder{nullptr};
+    GstElement* muxer{nullptr};
+    GstElement* payloader{nullptr};
+    GstElement* encoder{nullptr};
+    GstElement* convert{nullptr};
+    GstElement* sink{nullptr};
+    GstElement* parser2{nullptr};
+    GstElement* filter{nullptr};
+    GstElement* videorate{nullptr};
+    GstElement* videoscale{nullptr};
+    GstElement* prevElement{nullptr}; // for generic pipeline create
+    GstElement* audiodepay{nullptr};
+    GstElement* m_audioTail{nullptr};    // last element of the audio branch, linked to the muxer or sink
     std::mutex mtx;
 
     // Pipeline state
@@ -70,6 +85,190 @@ private:
     size_t m_pipelineId{0};
     size_t m_currentRequestId{0};
     MediaStreamDevice config;
+    PipelineBuildOptions m_buildOptions;
+    int m_iActiveProfile{-1};                   // index into config.vStreamProfiles, -1 = sDeviceName
+    std::atomic<unsigned> m_busGeneration{0};   // bus thread exits when this moves on
+    std::thread m_busThread;                    // joined before the pipeline it polls goes away
+
+    // Pad probe counters for depay, parser and output
+    PipelineStats m_stats;
+    bool m_bSinkSync{false};    // display sink waits for PTS + pipeline latency
+    bool m_bPassthrough{false}; // same-codec RTSP relay, no parser between depay and sink
+    bool m_bTranscode{false};   // decoder ! videoconvert ! videoscale ! videorate ! capsfilter ! encoder ! parser2
+    bool m_bLadder{false};      // decoder ! videoconvert ! tee, one encode branch per rendition
+    float m_fEncodeLoad{1.0f};  // thread budget weight against a plain decode
+    eAudioRoute m_eAudioRoute{eAudioRoute::AUDIO_ROUTE_NONE};
+
+    // Audio branch: audiodepay ! queue [! parser | ! decoder ! convert ! resample (! encoder ! parser | ! audio sink)]
+    static eAudioRoute audioRoute(const MediaStreamDevice& device, eAudioCodec& target);
+    static bool containerCarries(eContainerFormat container, eAudioCodec codec);
+    bool buildAudioBranch(const MediaStreamDevice& device, eAudioCodec target);
+    static gboolean onSelectStream(GstElement* src, guint num, GstCaps* caps, gpointer data);
+    static void onNoMorePads(GstElement* src, gpointer data);
+
+    // Same-codec network to network relay
+    static bool isPassthroughRelay(const MediaStreamDevice& device);
+    static eVideoCodec outputCodec(const MediaStreamDevice& device);
+
+    // Transcode stage from the output MediaCodec and resolution; links from prevElement, leaves parser2 as the tail
+    bool buildTranscodeStage(const MediaStreamDevice& device);
+
+    // decoder ! queue ! videoconvert after prevElement, which it then points at videoconvert
+    bool buildDecodeStage(eVideoCodec inputCodec, int decodeThreads);
+
+    // videoscale ! videorate ! capsfilter ! encoder ! parser from upstream; returns the parser
+    GstElement* buildEncodeBranch(GstElement* upstream, const std::string& suffix, eVideoCodec codec,
+                                  const MediaCodec& settings, const Resolution& size, int bitrate,
+                                  float sourceRate, int threads);
+
+    // Rendition ladder: each branch is served as its own RTSP mount or HLS stream
+    struct RenditionBranch
+    {
+        Rendition                    config;
+        GstElement*                  parser{nullptr};
+        std::unique_ptr<HlsPackager> hls;
+        std::string                  sMountPath;
+        bool                         bHlsPublished{false};
+    };
+    std::vector<RenditionBranch> m_renditions;
+    bool buildLadder(const MediaStreamDevice& device);
+    std::string renditionEndpoint(size_t index) const;     // "<pipeline id>-<rendition name>"
+
+    // Last element carrying the compressed stream the pipeline outputs: the output parser of a
+    // transcode, else the parser, or the depayloader in passthrough
+    GstElement* encodedOutput() const { return parser2 ? parser2 : (parser ? parser : depay); }
+
+    // QoS overload management. The bus thread picks a decode level from the sinks'
+    // QoS messages; the decoder gate probe applies the keyframes-only level.
+    struct QosTracker
+    {
+        std::unordered_map<const GstObject*, std::pair<guint64, guint64>> lastCounts; // processed/dropped per sink
+        guint64 windowProcessed{0};
+        guint64 windowDropped{0};
+        guint64 totalProcessed{0};
+        guint64 totalDropped{0};
+        gint64  windowLatenessNs{0};
+        guint   windowMessages{0};
+        double  avgLatenessMs{0.0};
+        int     recoverHoldMs{0};
+        std::chrono::steady_clock::time_point windowStart{std::chrono::steady_clock::now()};
+        std::chrono::steady_clock::time_point lastLate{};
+        std::chrono::steady_clock::time_point lastChange{};
+    };
+    QosTracker        m_qos;
+    std::mutex        m_qosMutex;
+    std::atomic<int>  m_decodeLevel{0};
+    GstPad*           m_gatePad{nullptr};
+    gulong            m_gateProbeId{0};
+    std::atomic<bool> m_bKeyframeOnly{false};       // requested mode, independent of QoS
+    std::atomic<bool> m_bDisplayParked{false};      // drop everything ahead of the decoder
+    bool              m_bGateWaitKeyframe{false};   // streaming thread only
+    bool              m_bGateFlushed{false};        // streaming thread only
+
+    // libav reads max-threads only when it opens the codec, so a new budget share is
+    // applied by a one-shot probe that reopens the decoder on the next keyframe
+    std::atomic<int>  m_iAppliedDecodeThreads{0};
+    std::mutex        m_reopenMutex;
+    int               m_iPendingDecodeThreads{-1};  // under m_reopenMutex, -1 = nothing pending
+    gulong            m_reopenProbeId{0};           // under m_reopenMutex, on the decoder's sink pad
+    int decoderThreadsFor(int share) const;
+    void reopenDecoder(GstPad* decoderSink, int threads);
+    static GstPadProbeReturn decoderReopenProbe(GstPad* pad, GstPadProbeInfo* info, gpointer data);
+    static gboolean replayStickyEvent(GstPad* pad, GstEvent** event, gpointer data);
+
+    void handleQos(GstMessage* msg);
+    void evaluateQos();
+    void applyDecodeLevel(int level);
+    void resetQos();
+    void stopBusThread();
+    static GstPadProbeReturn decodeGateProbe(GstPad* pad, GstPadProbeInfo* info, gpointer data);
+    static void flushDecoder(GstPad* decoderSink);
+    static GstPadProbeReturn dropFlushProbe(GstPad* pad, GstPadProbeInfo* info, gpointer data);
+
+    // Frame taps, per tap point. The probe is only installed while a point has subscribers.
+    struct TapPoint
+    {
+        PipelineHandler*         handler{nullptr};
+        eFrameTapPoint           point{eFrameTapPoint::FRAME_TAP_ENCODED};
+        int                      rendition{-1};
+        std::vector<FrameTapPtr> taps;
+        GstPad*                  pad{nullptr};
+        gulong                   probeId{0};
+    };
+    std::mutex m_tapMutex;
+    TapPoint   m_tapPoints[static_cast<size_t>(eFrameTapPoint::FRAME_TAP_COUNT)];
+    std::unordered_map<int, TapPoint> m_renditionTapPoints;    // encoded output of each ladder rendition
+    size_t     m_iNextTapId{1};
+    GstElement* tapElement(eFrameTapPoint point, int rendition = -1) const;
+    std::vector<TapPoint*> tapPointsLocked();
+    void installTapProbeLocked(TapPoint& tapPoint);
+    void removeTapProbesLocked();
+    static GstPadProbeReturn frameTapProbe(GstPad* pad, GstPadProbeInfo* info, gpointer data);
+
+    // Segmented recording through splitmuxsink. Segment messages are handled on the
+    // posting thread (sync bus handler); rotation and the callback run on the segment
+    // worker, off the streaming thread. Stop waits for the recording's own EOS: the
+    // pipeline EOS for splitmuxsink, the file sink's EOS event for a single file.
+    SegmentCallback         m_segmentCallback{nullptr};
+    std::vector<GstPad*>    m_segmentPads;              // muxer inputs, video then audio; each gets EOS on stop
+    std::string             m_sSegmentTemplate;
+    unsigned                m_iSegmentMaxFiles{0};
+    GstClockTime            m_segmentOpenedAt{GST_CLOCK_TIME_NONE};
+    unsigned                m_iSegmentsClosed{0};
+    std::deque<std::string> m_closedSegments;           // oldest first, for iMaxFiles rotation
+    std::mutex              m_segmentMutex;
+    std::condition_variable m_segmentCv;
+    bool                    m_bSegmentClosed{false};    // the EOS sent by finalizeSegment came through
+    struct SegmentJob
+    {
+        SegmentInfo segment;
+        unsigned    iMaxFiles{0};
+    };
+    std::deque<SegmentJob>  m_segmentJobs;              // under m_segmentMutex
+    bool                    m_bSegmentWorkerStop{false};
+    std::thread             m_segmentThread;
+    void segmentWorker();
+    void stopSegmentWorker();
+    GstElement* createSegmentSink(const MediaFileSource& fileSource);
+    std::string segmentLocation(guint fragmentId) const;
+    void onSegmentMessage(GstMessage* msg);
+    void addSegmentPad(GstElement* upstream);
+    void finalizeSegment();
+    void markRecordingClosed();
+    static GstPadProbeReturn fileEosProbe(GstPad* pad, GstPadProbeInfo* info, gpointer data);
+    static gchar* formatLocation(GstElement* splitmux, guint fragmentId, gpointer data);
+
+    // Embedded RTSP server output: the mount is registered while the pipeline runs
+    std::string             m_sMountPath;
+    void mountRtspOutput();
+    void unmountRtspOutput();
+
+    // RTP/UDP output: the SDP is rebuilt whenever the payloader renegotiates
+    GstPad*                 m_rtpPayPad{nullptr};
+    gulong                  m_rtpCapsHandler{0};
+    std::string             m_sSdp;
+    std::mutex              m_sdpMutex;
+    GstElement* createRtpOutput(eVideoCodec codec, const NetworkStreaming& network);
+    static void onRtpCaps(GstPad* pad, GParamSpec* pspec, gpointer data);
+
+    // HLS output: fMP4 fragments cut from the parser output into a store the HTTP server reads
+    std::unique_ptr<HlsPackager> m_hls;
+    bool                    m_bHlsPublished{false};
+    void publishHls();
+    void unpublishHls();
+
+    // Display wall tile: decoded frames go to the shared compositor, the own sink is a fakesink
+    bool                    m_bMosaicAttached{false};
+    void attachMosaic();
+    void detachMosaic();
+
+    // Compressed pre-event history on the parser output; recordings report through m_segmentCallback
+    PreEventBuffer          m_preEvent;
+
+    // Streaming tasks go to the shared pool on CREATE; placement is applied on ENTER
+    std::atomic<uint64_t> m_iPinnedThreads{0};
+    void onStreamStatus(GstMessage* msg);
+    static GstBusSyncReply syncBusHandler(GstBus* bus, GstMessage* msg, gpointer data);
 
     // Callbacks
     HandlerCallback m_callback{nullptr};
@@ -82,6 +281,11 @@ private:
     void MediaConfigurationChanges();
     bool configurePipeline();
     void cleanupPipeline();
+    bool rebuildLocked();
+    bool startLocked();
+
+    // Adds the configured queue after upstream and returns the new tail, or upstream if disabled
+    GstElement* insertQueue(eQueueStage stage, GstElement* upstream);
     
     // Error handling
     void handleError(const std::string& error);
@@ -95,7 +299,8 @@ private:
     void padAddedHandler(GstElement* src, GstPad* new_pad);
 
 public:
-    explicit PipelineHandler(const MediaStreamDevice& streamDevice = MediaStreamDevice());
+    explicit PipelineHandler(const MediaStreamDevice& streamDevice = MediaStreamDevice(),
+                             const PipelineBuildOptions& options = PipelineBuildOptions());
     ~PipelineHandler();
     
     // Pipeline control
@@ -118,6 +323,59 @@ public:
     
     // Configuration access
     const MediaStreamDevice& getConfig() const { return config; }
+
+    // Runtime statistics from the pad probes
+    PipelineStatsSnapshot getStats(bool bAdvanceWindow = false);
+
+    // Keyframe-only display decode; takes effect on the next access unit, no rebuild
+    void setKeyframeOnly(bool bKeyframeOnly);
+    bool isKeyframeOnly() const { return m_bKeyframeOnly.load(); }
+
+    // Park the decode/display branch while the tile is hidden; ingest keeps flowing.
+    // Unparking resumes at the next keyframe. Much cheaper than pause()/resume().
+    void setDisplayParked(bool bParked);
+    bool isDisplayParked() const { return m_bDisplayParked.load(); }
+
+    // Zero-copy frame access for in-process consumers. Returns nullptr if the tap point
+    // does not exist in this pipeline (decoded frames need a display pipeline).
+    FrameTapPtr subscribeFrames(const FrameTapConfig& tapConfig, FrameCallback callback = nullptr);
+    void unsubscribeFrames(const FrameTapPtr& tap);
+
+    // Pre-event ring buffer; applies immediately, no rebuild
+    void setPreEventConfig(const PreEventConfig& preEventConfig);
+
+    // Writes the buffered GOPs plus the live continuation to a file, or extends the running
+    // event recording. location receives the file name.
+    bool triggerEventRecording(const EventRecordingRequest& request, std::string& location);
+
+    // Session description of an RTP output, "" until the payloader has negotiated
+    std::string getSdp();
+
+    // Display tile size; switches between main and substream when the best fit changes
+    void setTileSize(int width, int height);
+    int getActiveProfile() const { return m_iActiveProfile; }
+
+    // Decoder thread share from the manager's global budget; a transcode splits it with its encoder.
+    // A running decoder is reopened with the new share at its next keyframe.
+    void setDecodeThreads(int threads);
+
+    // Share the running decoder was opened with; lags setDecodeThreads until that keyframe
+    int appliedDecodeThreads() const { return m_iAppliedDecodeThreads.load(); }
+
+    // Output needs another codec, bitrate or size than the input: file and network outputs only
+    static bool isTranscode(const MediaStreamDevice& device);
+
+    // Served (RTSP server or HLS) network output with renditions: one decode, one encode per rendition
+    static bool isLadder(const MediaStreamDevice& device);
+
+    // Thread budget weight: 1 for a decode, plus one share per encoder the pipeline runs
+    static float encodeLoadFactor(const MediaStreamDevice& device);
+
+    // Pixels a rendition encodes per frame; a source-sized rendition counts as 1080p
+    static double renditionArea(const Rendition& rendition);
+
+    // Encoder load of a ladder in 1080p25 decodes: one share per rendition, by its pixel rate
+    static float ladderEncodeLoad(const MediaStreamDevice& device);
     
     // Unified callback
     void setCallback(HandlerCallback callback) 
@@ -126,6 +384,14 @@ public:
         m_callback = callback;
     }
     
+    // Called once per finalized recording segment, on this handler's segment worker (event
+    // recordings: the pre-event recorder's thread). A slow callback delays later segments' reports.
+    void setSegmentCallback(SegmentCallback callback)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_segmentCallback = callback;
+    }
+
     // Report status using the callback
     void reportStatus(PipelineStatus status, const std::string& message) 
     {
@@ -17,11 +17,18 @@ PipelineManager::PipelineManager()
 PipelineManager::~PipelineManager() 
 {
     MX_LOG_TRACE("PipelineManager", "pipeline process shutdown start");
+    stopStatsThread();
+    m_analytics.stop();
     stopworkerthread();
 
     // Clear all pipelines
-    std::lock_guard<std::mutex> lock(m_pipemangermutex);
-    m_pipelineHandlers.clear();
+    {
+        std::lock_guard<std::mutex> lock(m_pipemangermutex);
+        m_pipelineHandlers.clear();
+    }
+    RtspServerOutput::instance().stop();
+    HlsServer::instance().stop();
+    MosaicOutput::instance().stop();
 }
 
 ///////////////////////////////////////////////    Initialization   ///////////////////////////////////////////////
@@ -32,9 +39,9 @@ void PipelineManager::initializemanager()
     startworkerthread();
 }
 
-void PipelineManager::sendPipelineRequest(PipelineRequest incommingrequest)
+bool PipelineManager::sendPipelineRequest(PipelineRequest incommingrequest)
 {
-    enqueuePipelineRequest(incommingrequest);
+    return enqueuePipelineRequest(incommingrequest);
 }
 
 ///////////////////////////////////////////////    Pipeline comparison   //////////////////////////////////////////
@@ -132,11 +139,26 @@ void PipelineManager::stopworkerthread()
     }
 }
 
-void PipelineManager::enqueuePipelineRequest(const PipelineRequest& request)
+bool PipelineManager::enqueuePipelineRequest(const PipelineRequest& request)
 {
+    // Wait for the worker to make room instead of throwing "Queue is full", so the
+    // backlog stays in the submission queue where the backpressure policy applies.
+    // TQueue has its own lock; m_pipemangermutex is not held while waiting.
+    bool bQueued = false;
+    while (m_running && !bQueued)
+    {
+        bQueued = m_pipelinerequest.enqueueFor(request, std::chrono::milliseconds(100));
+    }
+
+    if (!bQueued)
+    {
+        MX_LOG_ERROR("PipelineManager", ("manager stopped before request could be queued: " + std::to_string(request.getRequestID())).c_str());
+        return false;
+    }
+
     {
+        // Pairs with the predicate check in processpipelinerequest to avoid a lost wakeup
         std::lock_guard<std::mutex> lock(m_pipemangermutex);
-        m_pipelinerequest.enqueue(request);
     }
     m_cv.notify_one();
     
@@ -147,6 +169,8 @@ void PipelineManager::enqueuePipelineRequest(const PipelineRequest& request)
         request.getPipelineID(),
         request.getRequestID(),
         "Request received and enqueue by Pipeline Manager");
+
+    return true;
 }
 
 void PipelineManager::processpipelinerequest()
@@ -156,18 +180,40 @@ void PipelineManager::processpipelinerequest()
     while (m_running)
     {
         PipelineRequest request;
+        int deferAttempts = 0;
         {
             std::unique_lock<std::mutex> lock(m_pipemangermutex);
-            m_cv.wait(lock, [this]
+            auto ready = [this]
                 {
-                    return !m_running || !m_pipelinerequest.isEmpty();
-                });
+                    return !m_running || !m_pipelinerequest.isEmpty() ||
+                           (!m_deferredRequests.empty() && m_deferredRequests.front().due <= std::chrono::steady_clock::now());
+                };
+
+            if (m_deferredRequests.empty())
+            {
+                m_cv.wait(lock, ready);
+            }
+            else
+            {
+                m_cv.wait_until(lock, m_deferredRequests.front().due, ready);
+            }
 
             if (!m_running) break;
 
-            request = m_pipelinerequest.dequeue();
+            // Deferred requests were accepted earlier, give them precedence once due
+            if (!takeDueDeferredRequest(request, deferAttempts))
+            {
+                if (m_pipelinerequest.isEmpty())
+                {
+                    continue;
+                }
+                request = m_pipelinerequest.dequeue();
+            }
         }
 
+        const PipelineID pipelineId = request.getPipelineID();
+        const size_t     requestId  = request.getRequestID();
+
         if (request.getEAction() == eAction::ACTION_CREATE ||
             request.getEAction() == eAction::ACTION_UPDATE ||
             request.getEAction() == eAction::ACTION_START)
@@ -175,10 +221,16 @@ void PipelineManager::processpipelinerequest()
             if (!validatepipelineConfig(request.getMediaStreamDevice()))
             {
                 MX_LOG_ERROR("PipelineManager", ("invalid configuration received for device :" + request.getMediaStreamDevice().name()).c_str());
+                onHandlerCallback(PipelineStatus::ConfigError, pipelineId, requestId, "Invalid pipeline configuration");
                 continue;
             }
         }
 
+        // Every request ends with exactly one terminal status so submitters can join on it
+        PipelineStatus resultStatus  = PipelineStatus::Success;
+        std::string    resultMessage = "Request completed";
+        bool           bDeferred     = false;
+
         try
         {
             switch (request.getEAction())
@@ -190,9 +242,15 @@ void PipelineManager::processpipelinerequest()
                 {
                     MX_LOG_INFO("PipelineManager", ("match same pipeline so can't created :" + std::to_string(existingId)).c_str());
                     // TODO : what to do blindlly created or return 
+                    resultStatus  = PipelineStatus::ConfigError;
+                    resultMessage = "Matching pipeline already exists: " + std::to_string(existingId);
+                    break;
+                }
+                if (!admitAndCreatePipeline(request, deferAttempts, bDeferred, resultStatus, resultMessage))
+                {
                     break;
                 }
-                createPipelineInternal(request.getPipelineID(), request.getRequestID(), request.getMediaStreamDevice());
+                resultMessage = "Pipeline created";
                 break;
             }
             case eAction::ACTION_UPDATE:
@@ -202,12 +260,20 @@ void PipelineManager::processpipelinerequest()
                 {
                     MX_LOG_INFO("PipelineManager", ("match same pipeline not found while updatating for device :" + request.getMediaStreamDevice().name()).c_str());
                     // TODO : what to do blindlly created or return 
+                    resultStatus  = PipelineStatus::ConfigError;
+                    resultMessage = "No matching pipeline to update";
                     break;
                 }
 
                 if (canUpdatePipeline(existingId, request.getMediaStreamDevice()))
                 {
-                    updatePipelineInternal(request.getPipelineID(), request.getMediaStreamDevice());
+                    updatePipelineInternal(pipelineId, request.getMediaStreamDevice());
+                    resultMessage = "Pipeline updated";
+                }
+                else
+                {
+                    resultStatus  = PipelineStatus::ConfigError;
+                    resultMessage = "Pipeline update not allowed";
                 }
                 break;
             }
@@ -218,12 +284,18 @@ void PipelineManager::processpipelinerequest()
                 {
                     MX_LOG_INFO("PipelineManager", ("match same pipeline so can't create new just starting ID :" + std::to_string(existingId)).c_str());
                     // TODO : what to do blindlly start 
-                    startPipeline(request.getPipelineID());
-
+                }
+                else if (!admitAndCreatePipeline(request, deferAttempts, bDeferred, resultStatus, resultMessage))
+                {
+                    break;
+                }
+                if (!startPipeline(pipelineId))
+                {
+                    resultStatus  = PipelineStatus::Error;
+                    resultMessage = "Pipeline start failed";
                     break;
                 }
-                createPipelineInternal(request.getPipelineID(), request.getRequestID(), request.getMediaStreamDevice());
-                startPipeline(request.getPipelineID());
+                resultMessage = "Pipeline running";
                 break;
             }
             case eAction::ACTION_START:
@@ -232,38 +304,82 @@ void PipelineManager::processpipelinerequest()
                 if (!findMatchingpipeline(request.getMediaStreamDevice(), existingId))
                 {
                     MX_LOG_INFO("PipelineManager", ("match same pipeline so can create first and then start  :" + std::to_string(existingId)).c_str());
-                    createPipelineInternal(request.getPipelineID(), request.getRequestID(), request.getMediaStreamDevice());
+                    if (!admitAndCreatePipeline(request, deferAttempts, bDeferred, resultStatus, resultMessage))
+                    {
+                        break;
+                    }
                 }
-                startPipeline(request.getPipelineID());
+                if (!startPipeline(pipelineId))
+                {
+                    resultStatus  = PipelineStatus::Error;
+                    resultMessage = "Pipeline start failed";
+                    break;
+                }
+                resultMessage = "Pipeline started";
                 break;
             }
             case eAction::ACTION_STOP:
             {
-                stopPipeline(request.getPipelineID());
+                cancelDeferredRequests(pipelineId);
+                if (!stopPipeline(pipelineId))
+                {
+                    resultStatus  = PipelineStatus::Error;
+                    resultMessage = "Pipeline stop failed";
+                    break;
+                }
+                resultMessage = "Pipeline stopped";
                 break;
             }
             case eAction::ACTION_PAUSE:
             {
-                pausePipeline(request.getPipelineID());
+                if (!pausePipeline(pipelineId))
+                {
+                    resultStatus  = PipelineStatus::Error;
+                    resultMessage = "Pipeline pause failed";
+                    break;
+                }
+                resultMessage = "Pipeline paused";
                 break;
             }
             case eAction::ACTION_RESUME:
             {
-                resumePipeline(request.getPipelineID());
+                if (!resumePipeline(pipelineId))
+                {
+                    resultStatus  = PipelineStatus::Error;
+                    resultMessage = "Pipeline resume failed";
+                    break;
+                }
+                resultMessage = "Pipeline resumed";
                 break;
             }
             case eAction::ACTION_TERMINATE:
             {
-                terminatePipeline(request.getPipelineID());
+                cancelDeferredRequests(pipelineId);
+                if (!terminatePipeline(pipelineId))
+                {
+                    resultStatus  = PipelineStatus::Error;
+                    resultMessage = "Pipeline not found";
+                    break;
+                }
+                resultMessage = "Pipeline terminated";
                 break;
             }
             default :
+                resultStatus  = PipelineStatus::ConfigError;
+                resultMessage = "Unsupported action";
             break;
             }
         }
         catch (const std::exception& e)
         {
             MX_LOG_ERROR("PipelineHandler", ("failed to create pipeline:" + request.getMediaStreamDevice().name() + e.what()).c_str());
+            resultStatus  = PipelineStatus::Error;
+            resultMessage = std::string("Request failed: ") + e.what();
+        }
+
+        if (!bDeferred)
+        {
+            onHandlerCallback(resultStatus, pipelineId, requestId, resultMessage);
         }
     }
 
@@ -273,14 +389,15 @@ void PipelineManager::processpipelinerequest()
 
 ///////////////////////////////////////////////    Control operations  //////////////////////////////////////////
 
-void PipelineManager::createPipelineInternal(PipelineID id, size_t iRequestID, const MediaStreamDevice& streamDevice)
+bool PipelineManager::createPipelineInternal(PipelineID id, size_t iRequestID, const MediaStreamDevice& streamDevice,
+                                             const PipelineBuildOptions& options)
 {
     std::lock_guard<std::mutex> lock(m_pipemangermutex);
 
     try 
     {
         // Create a new pipeline handler
-        auto handler = std::make_unique<PipelineHandler>(streamDevice);
+        auto handler = std::make_unique<PipelineHandler>(streamDevice, options);
 
         // Set the pipeline ID
         handler->setPipelineId(id);
@@ -294,24 +411,168 @@ void PipelineManager::createPipelineInternal(PipelineID id, size_t iRequestID, c
                      std::placeholders::_2,
                      std::placeholders::_3,
                      std::placeholders::_4));
+        handler->setSegmentCallback(
+            [this](size_t pipelineId, const SegmentInfo& segment)
+            {
+                SegmentCallback callback;
+                {
+                    std::lock_guard<std::mutex> lock(m_segmentCallbackMutex);
+                    callback = m_segmentCallback;
+                }
+                if (callback)
+                {
+                    callback(pipelineId, segment);
+                }
+            });
+
+        // Build errors are raised from the constructor before the callback is attached
+        // A half-built handler is not kept: the caller releases its reservations, and a later
+        // START/RUN for this id must find nothing rather than a pipeline nobody accounts for
+        if (handler->getState() == PipelineHandler::State::ERROR)
+        {
+            MX_LOG_WARN("PipelineManager", ("Pipeline " + std::to_string(id) + " failed to build, handler discarded").c_str());
+            return false;
+        }
 
         // Store the handler
         m_pipelineHandlers[id] = std::move(handler);
 
         MX_LOG_TRACE("PipelineManager", ("Created pipeline with ID: " + std::to_string(id)).c_str());
+        return true;
     } 
     catch (const std::exception& e) 
     {
-        onHandlerCallback(
-            PipelineStatus::Error,
-            id,
-            iRequestID,
-            std::string("Failed to create pipeline: ") + e.what()
-        );
+        // The request's terminal Error is reported once, by processpipelinerequest
+        MX_LOG_ERROR("PipelineManager", ("Failed to create pipeline " + std::to_string(id) + ": " + e.what()).c_str());
         throw; // Re-throw to be caught by the caller
     }
 }
 
+bool PipelineManager::admitAndCreatePipeline(const PipelineRequest& request, int attempts, bool& bDeferred,
+                                             PipelineStatus& resultStatus, std::string& resultMessage)
+{
+    const PipelineID id = request.getPipelineID();
+    PipelineBuildOptions options;
+    std::string reason;
+
+    // Cost follows the stream the handler will actually pull (main or substream)
+    const MediaStreamDevice& device = request.getMediaStreamDevice();
+    const MediaStreamDevice selected = StreamProfileSelector::resolve(device, StreamProfileSelector::select(device));
+
+    switch (m_admission.admit(id, selected, reason))
+    {
+    case eAdmissionDecision::ADMISSION_ADMIT:
+        break;
+    case eAdmissionDecision::ADMISSION_DOWNGRADE:
+        MX_LOG_WARN("PipelineManager", ("pipeline " + std::to_string(id) + " downgraded: " + reason).c_str());
+        onHandlerCallback(PipelineStatus::Information, id, request.getRequestID(), "Admission downgrade: " + reason);
+        options.bReducedDecode = true;
+        break;
+    case eAdmissionDecision::ADMISSION_DEFER:
+    {
+        const AdmissionConfig config = m_admission.getConfig();
+        if (attempts < config.iMaxDeferAttempts)
+        {
+            // Only the worker thread touches the deferred list
+            m_deferredRequests.push_back({request, std::chrono::steady_clock::now() + std::chrono::milliseconds(config.iDeferRetryMs), attempts + 1});
+            bDeferred = true;
+            MX_LOG_WARN("PipelineManager", ("pipeline " + std::to_string(id) + " deferred: " + reason).c_str());
+            onHandlerCallback(PipelineStatus::InProgress, id, request.getRequestID(), "Admission deferred: " + reason);
+            return false;
+        }
+        reason += ", gave up after " + std::to_string(attempts) + " deferrals";
+        [[fallthrough]];
+    }
+    case eAdmissionDecision::ADMISSION_REJECT:
+    default:
+        MX_LOG_ERROR("PipelineManager", ("pipeline " + std::to_string(id) + " rejected: " + reason).c_str());
+        resultStatus  = PipelineStatus::ResourceError;
+        resultMessage = "Admission rejected: " + reason;
+        return false;
+    }
+
+    // The display path decodes, and so do transcodes and ladders, which also encode; one
+    // decode is shared by every rendition, so only the encoders add to the weight
+    const float encodeLoad = PipelineHandler::encodeLoadFactor(selected);
+    const bool bDecodes = device.stoutputMediaData.esourceType == eSourceType::SOURCE_TYPE_DISPLAY || encodeLoad > 1.0f;
+    DecodeThreadMap threads;
+    if (bDecodes)
+    {
+        threads = m_decodeBudget.add(id, selected, request.getPriority(), encodeLoad);
+        options.iDecodeThreads = static_cast<int>(threads[id]);
+    }
+
+    options.stQueues = (device.elatencyProfile == eLatencyProfile::LATENCY_PROFILE_LOW && bDecodes)
+                     ? lowLatencyQueueProfile() : getQueueProfile(device.stoutputMediaData.esourceType);
+
+    const PipelinePlacement placement = m_placement.place(id);
+    options.iNumaNode = placement.iNumaNode;
+    options.vCpuSet   = placement.vCpuSet;
+    if (!placement.vCpuSet.empty())
+    {
+        MX_LOG_TRACE("PipelineManager", ("pipeline " + std::to_string(id) + " placed on node " + std::to_string(placement.iNumaNode) +
+                                         ", cpus " + CpuPlacement::formatCpuSet(placement.vCpuSet)).c_str());
+    }
+
+    bool bCreated = false;
+    try
+    {
+        bCreated = createPipelineInternal(id, request.getRequestID(), device, options);
+    }
+    catch (...)
+    {
+        // The reservations above are only released here; the caller reports the failure
+        std::lock_guard<std::mutex> lock(m_pipemangermutex);
+        releasePipelineResourcesLocked(id);
+        throw;
+    }
+
+    if (!bCreated)
+    {
+        std::lock_guard<std::mutex> lock(m_pipemangermutex);
+        releasePipelineResourcesLocked(id);
+        resultStatus  = PipelineStatus::Error;
+        resultMessage = "Pipeline creation failed";
+        return false;
+    }
+
+    if (bDecodes)
+    {
+        std::lock_guard<std::mutex> lock(m_pipemangermutex);
+        applyDecodeThreadsLocked(threads);
+    }
+    return true;
+}
+
+bool PipelineManager::takeDueDeferredRequest(PipelineRequest& request, int& attempts)
+{
+    if (m_deferredRequests.empty() || m_deferredRequests.front().due > std::chrono::steady_clock::now())
+    {
+        return false;
+    }
+
+    request  = std::move(m_deferredRequests.front().request);
+    attempts = m_deferredRequests.front().attempts;
+    m_deferredRequests.pop_front();
+    return true;
+}
+
+void PipelineManager::cancelDeferredRequests(PipelineID id)
+{
+    for (auto it = m_deferredRequests.begin(); it != m_deferredRequests.end();)
+    {
+        if (it->request.getPipelineID() == id)
+        {
+            onHandlerCallback(PipelineStatus::Cancelled, id, it->request.getRequestID(), "Deferred request cancelled by stop/terminate");
+            it = m_deferredRequests.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
 void PipelineManager::updatePipelineInternal(PipelineID id, const MediaStreamDevice& streamDevice)
 {
     std::lock_guard<std::mutex> lock(m_pipemangermutex);
@@ -372,6 +633,7 @@ bool PipelineManager::stopPipeline(PipelineID id)
         if (it->second->stop())
         {
             m_pipelineHandlers.erase(it);
+            releasePipelineResourcesLocked(id);
             return true;
         }
     }
@@ -386,11 +648,124 @@ bool PipelineManager::terminatePipeline(PipelineID id)
         MX_LOG_TRACE("PipelineManager", ("terminate Pipeline: " + std::to_string(id)).c_str());
         it->second->terminate();
         m_pipelineHandlers.erase(it);
+        releasePipelineResourcesLocked(id);
         return true;
     }
     return false;
 }
 
+void PipelineManager::releasePipelineResourcesLocked(PipelineID id)
+{
+    m_admission.release(id);
+    m_placement.release(id);
+    applyDecodeThreadsLocked(m_decodeBudget.remove(id));
+}
+
+void PipelineManager::applyDecodeThreadsLocked(const DecodeThreadMap& threads)
+{
+    for (const auto& [id, count] : threads)
+    {
+        if (auto it = m_pipelineHandlers.find(id); it != m_pipelineHandlers.end())
+        {
+            it->second->setDecodeThreads(static_cast<int>(count));
+        }
+    }
+}
+
+void PipelineManager::setDecodeBudgetConfig(const DecodeBudgetConfig& config)
+{
+    m_decodeBudget.setConfig(config);
+
+    std::lock_guard<std::mutex> lock(m_pipemangermutex);
+    applyDecodeThreadsLocked(m_decodeBudget.current());
+}
+
+DecodeBudgetSnapshot PipelineManager::getDecodeBudgetSnapshot()
+{
+    DecodeBudgetSnapshot snapshot = m_decodeBudget.getSnapshot();
+
+    std::lock_guard<std::mutex> lock(m_pipemangermutex);
+    for (DecodeThreadAllocation& allocation : snapshot.allocations)
+    {
+        if (auto it = m_pipelineHandlers.find(allocation.pipelineId); it != m_pipelineHandlers.end())
+        {
+            allocation.iRunning = static_cast<unsigned>(std::max(0, it->second->appliedDecodeThreads()));
+        }
+    }
+    return snapshot;
+}
+
+QueueProfile PipelineManager::defaultQueueProfile(eSourceType outputType)
+{
+    QueueProfile profile;
+    switch (outputType)
+    {
+    case eSourceType::SOURCE_TYPE_DISPLAY:
+    {
+        // Live view: a short compressed queue keeps network jitter out of the decoder
+        // thread, and the frame queue in front of the sink keeps only the newest frames
+        QueueStageConfig& parse = profile.stage(eQueueStage::QUEUE_STAGE_PARSER);
+        parse.bEnabled   = true;
+        parse.iMaxTimeMs = 200;
+        parse.eLeaky     = eQueueLeaky::QUEUE_LEAKY_NONE;   // dropped deltas would corrupt until the next keyframe
+
+        QueueStageConfig& decode = profile.stage(eQueueStage::QUEUE_STAGE_DECODER);
+        decode.bEnabled    = true;
+        decode.iMaxBuffers = 2;
+        decode.eLeaky      = eQueueLeaky::QUEUE_LEAKY_DOWNSTREAM;
+        break;
+    }
+    case eSourceType::SOURCE_TYPE_FILE:
+    {
+        // Recording: absorb disk stalls, never drop
+        QueueStageConfig& parse = profile.stage(eQueueStage::QUEUE_STAGE_PARSER);
+        parse.bEnabled   = true;
+        parse.iMaxBytes  = 32 * 1024 * 1024;
+        parse.iMaxTimeMs = 5000;
+        parse.eLeaky     = eQueueLeaky::QUEUE_LEAKY_NONE;
+        break;
+    }
+    case eSourceType::SOURCE_TYPE_NETWORK:
+    {
+        QueueStageConfig& parse = profile.stage(eQueueStage::QUEUE_STAGE_PARSER);
+        parse.bEnabled   = true;
+        parse.iMaxTimeMs = 1000;
+        parse.eLeaky     = eQueueLeaky::QUEUE_LEAKY_NONE;
+        break;
+    }
+    default:
+        break;
+    }
+    return profile;
+}
+
+QueueProfile PipelineManager::lowLatencyQueueProfile()
+{
+    // Nothing queued ahead of the decoder, and only the newest decoded frame waits for the sink
+    QueueProfile profile;
+    QueueStageConfig& decode = profile.stage(eQueueStage::QUEUE_STAGE_DECODER);
+    decode.bEnabled    = true;
+    decode.iMaxBuffers = 1;
+    decode.eLeaky      = eQueueLeaky::QUEUE_LEAKY_DOWNSTREAM;
+    return profile;
+}
+
+void PipelineManager::setQueueProfile(eSourceType outputType, const QueueProfile& profile)
+{
+    std::lock_guard<std::mutex> lock(m_queueProfileMutex);
+    m_queueProfiles[outputType] = profile;
+}
+
+QueueProfile PipelineManager::getQueueProfile(eSourceType outputType)
+{
+    std::lock_guard<std::mutex> lock(m_queueProfileMutex);
+    if (auto it = m_queueProfiles.find(outputType); it != m_queueProfiles.end())
+    {
+        return it->second;
+    }
+    return defaultQueueProfile(outputType);
+}
+
 ///////////////////////////////////////////////   Pipeline Status queries  //////////////////////////////////////////
 bool PipelineManager::isPipelineRunning(PipelineID id)
 {
@@ -419,10 +794,173 @@ std::vector<PipelineID> PipelineManager::getActivePipelines()
 
 size_t PipelineManager::getQueueSize()
 {
-    std::lock_guard<std::mutex> lock(m_pipemangermutex);
     return m_pipelinerequest.size();
 }
 
+size_t PipelineManager::getQueueCapacity() const
+{
+    return m_pipelinerequest.capacity();
+}
+
+size_t PipelineManager::getQueueHighWaterMark() const
+{
+    return m_pipelinerequest.highWaterMark();
+}
+
+bool PipelineManager::getPipelineStats(PipelineID id, PipelineStatsSnapshot& stats)
+{
+    std::lock_guard<std::mutex> lock(m_pipemangermutex);
+    if (auto it = m_pipelineHandlers.find(id); it != m_pipelineHandlers.end())
+    {
+        stats = it->second->getStats();
+        return true;
+    }
+    return false;
+}
+
+bool PipelineManager::setKeyframeOnly(PipelineID id, bool bKeyframeOnly)
+{
+    std::lock_guard<std::mutex> lock(m_pipemangermutex);
+    if (auto it = m_pipelineHandlers.find(id); it != m_pipelineHandlers.end())
+    {
+        it->second->setKeyframeOnly(bKeyframeOnly);
+        return true;
+    }
+    return false;
+}
+
+bool PipelineManager::setDisplayParked(PipelineID id, bool bParked)
+{
+    std::lock_guard<std::mutex> lock(m_pipemangermutex);
+    if (auto it = m_pipelineHandlers.find(id); it != m_pipelineHandlers.end())
+    {
+        it->second->setDisplayParked(bParked);
+        return true;
+    }
+    return false;
+}
+
+bool PipelineManager::setTileSize(PipelineID id, int width, int height)
+{
+    std::lock_guard<std::mutex> lock(m_pipemangermutex);
+    if (auto it = m_pipelineHandlers.find(id); it != m_pipelineHandlers.end())
+    {
+        it->second->setTileSize(width, height);
+        return true;
+    }
+    return false;
+}
+
+bool PipelineManager::setPreEventConfig(PipelineID id, const PreEventConfig& config)
+{
+    std::lock_guard<std::mutex> lock(m_pipemangermutex);
+    if (auto it = m_pipelineHandlers.find(id); it != m_pipelineHandlers.end())
+    {
+        it->second->setPreEventConfig(config);
+        return true;
+    }
+    return false;
+}
+
+bool PipelineManager::triggerEventRecording(PipelineID id, const EventRecordingRequest& request, std::string& location)
+{
+    std::lock_guard<std::mutex> lock(m_pipemangermutex);
+    if (auto it = m_pipelineHandlers.find(id); it != m_pipelineHandlers.end())
+    {
+        return it->second->triggerEventRecording(request, location);
+    }
+    return false;
+}
+
+bool PipelineManager::getSdp(PipelineID id, std::string& sdp)
+{
+    std::lock_guard<std::mutex> lock(m_pipemangermutex);
+    if (auto it = m_pipelineHandlers.find(id); it != m_pipelineHandlers.end())
+    {
+        sdp = it->second->getSdp();
+        return !sdp.empty();
+    }
+    return false;
+}
+
+FrameTapPtr PipelineManager::subscribeFrames(PipelineID id, const FrameTapConfig& config, FrameCallback callback)
+{
+    std::lock_guard<std::mutex> lock(m_pipemangermutex);
+    if (auto it = m_pipelineHandlers.find(id); it != m_pipelineHandlers.end())
+    {
+        return it->second->subscribeFrames(config, std::move(callback));
+    }
+    return nullptr;
+}
+
+std::vector<PipelineStatsSnapshot> PipelineManager::getAllPipelineStats(bool bAdvanceWindow)
+{
+    std::lock_guard<std::mutex> lock(m_pipemangermutex);
+    std::vector<PipelineStatsSnapshot> snapshots;
+    snapshots.reserve(m_pipelineHandlers.size());
+    for (const auto& [id, handler] : m_pipelineHandlers)
+    {
+        snapshots.push_back(handler->getStats(bAdvanceWindow));
+    }
+    return snapshots;
+}
+
+void PipelineManager::setStatsCallback(int intervalMs, StatsCallback callback)
+{
+    stopStatsThread();
+
+    if (intervalMs <= 0 || !callback)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        m_statsCallback = std::move(callback);
+        m_iStatsIntervalMs = intervalMs;
+        m_bStatsRunning = true;
+    }
+    m_statsThread = std::thread(&PipelineManager::statsLoop, this);
+}
+
+void PipelineManager::stopStatsThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        m_bStatsRunning = false;
+    }
+    m_statsCv.notify_all();
+
+    if (m_statsThread.joinable())
+    {
+        m_statsThread.join();
+    }
+}
+
+void PipelineManager::statsLoop()
+{
+    std::unique_lock<std::mutex> lock(m_statsMutex);
+    while (m_bStatsRunning)
+    {
+        if (m_statsCv.wait_for(lock, std::chrono::milliseconds(m_iStatsIntervalMs), [this] { return !m_bStatsRunning; }))
+        {
+            break;
+        }
+
+        StatsCallback callback = m_statsCallback;
+        lock.unlock();
+
+        // Each periodic snapshot closes the rate window for fps/bitrate
+        std::vector<PipelineStatsSnapshot> snapshots = getAllPipelineStats(true);
+        if (callback)
+        {
+            callback(snapshots);
+        }
+
+        lock.lock();
+    }
+}
+
 void PipelineManager::onHandlerCallback(PipelineStatus status, size_t pipelineId,
                          size_t requestId, const std::string& message)
 {
@@ -2,6 +2,8 @@
 #define PIPELINE_MANAGER_H
 
 #include <queue>
+#include <deque>
+#include <chrono>
 #include <thread>
 #include <mutex>
 #include <memory>
@@ -15,6 +17,13 @@
 #include "MediaStreamDevice.h"
 #include "TQueue.h"
 #include "PipelineRequest.h"
+#include "AdmissionController.h"
+#include "DecodeThreadBudget.h"
+#include "CpuPlacement.h"
+#include "PipelineStats.h"
+#include "FrameTap.h"
+#include "AnalyticsScheduler.h"
+#include "PreEventBuffer.h"
 
 // Forward declare PipelineStatus enum from PipelineProcess.h
 enum class PipelineStatus;
@@ -50,6 +59,45 @@ private:
     // Manager's callback
     ManagerCallback         m_callback;
 
+    // Resource admission for new pipelines; deferred requests are only touched by the worker thread
+    struct DeferredRequest
+    {
+        PipelineRequest request;
+        std::chrono::steady_clock::time_point due;
+        int attempts{0};
+    };
+    AdmissionController          m_admission;
+    std::deque<DeferredRequest>  m_deferredRequests;
+
+    // Decoder threads shared across display pipelines
+    DecodeThreadBudget           m_decodeBudget;
+
+    // Core sets for streaming threads
+    CpuPlacement                 m_placement;
+
+    // Inter-stage queue layout per output type
+    std::mutex                   m_queueProfileMutex;
+    std::unordered_map<eSourceType, QueueProfile> m_queueProfiles;
+    void applyDecodeThreadsLocked(const DecodeThreadMap& threads);
+    void releasePipelineResourcesLocked(PipelineID id);
+
+    // Analytics sampling over the frame taps; declared after the handlers map so it stops first
+    AnalyticsScheduler           m_analytics{[this](size_t id, const FrameTapConfig& config) { return subscribeFrames(id, config, nullptr); }};
+
+    // Finalized recording segments, from any pipeline
+    std::mutex                   m_segmentCallbackMutex;
+    SegmentCallback              m_segmentCallback;
+
+    // Periodic statistics snapshots
+    std::thread             m_statsThread;
+    std::mutex              m_statsMutex;
+    std::condition_variable m_statsCv;
+    StatsCallback           m_statsCallback;
+    int                     m_iStatsIntervalMs{0};
+    bool                    m_bStatsRunning{false};
+    void statsLoop();
+    void stopStatsThread();
+
     //   Pipeline comparison  
     bool findMatchingpipeline  (const MediaStreamDevice& streamDevice, PipelineID& existingId);
     bool validatepipelineConfig(const MediaStreamDevice& streamDevice) const;
@@ -59,11 +107,16 @@ private:
     //   Request Process   
     void startworkerthread();
     void stopworkerthread ();
-    void enqueuePipelineRequest(const PipelineRequest& request);
+    bool enqueuePipelineRequest(const PipelineRequest& request);
     void processpipelinerequest();
     
     //   Control operations  
-    void createPipelineInternal(PipelineID id, size_t iRequestID, const MediaStreamDevice& streamDevice);
+    bool createPipelineInternal(PipelineID id, size_t iRequestID, const MediaStreamDevice& streamDevice,
+                                const PipelineBuildOptions& options = PipelineBuildOptions());
+    bool admitAndCreatePipeline(const PipelineRequest& request, int attempts, bool& bDeferred,
+                                PipelineStatus& resultStatus, std::string& resultMessage);
+    bool takeDueDeferredRequest(PipelineRequest& request, int& attempts);
+    void cancelDeferredRequests(PipelineID id);
     void updatePipelineInternal(PipelineID id, const MediaStreamDevice& streamDevice);
     bool startPipeline (PipelineID id);
     bool pausePipeline (PipelineID id);
@@ -88,14 +141,73 @@ public:
         m_callback = callback;
     }
     
-    // Send pipeline request
-    void sendPipelineRequest(PipelineRequest incommingrequest);
+    // Send pipeline request, blocks while the work queue is full. False if the manager stopped.
+    bool sendPipelineRequest(PipelineRequest incommingrequest);
     
     // Pipeline Status queries
     bool isPipelineRunning(PipelineID id);
     std::vector<PipelineID> getActivePipelines();
     size_t getQueueSize();
 
+    // Runtime statistics; a periodic callback with intervalMs <= 0 or a null callback stops reporting
+    bool getPipelineStats(PipelineID id, PipelineStatsSnapshot& stats);
+    std::vector<PipelineStatsSnapshot> getAllPipelineStats(bool bAdvanceWindow = false);
+    void setStatsCallback(int intervalMs, StatsCallback callback);
+
+    // Keyframe-only display decode, switched without rebuilding the pipeline
+    bool setKeyframeOnly(PipelineID id, bool bKeyframeOnly);
+
+    // Suspend or resume a pipeline's decode/display branch without touching ingest
+    bool setDisplayParked(PipelineID id, bool bParked);
+
+    // Display tile resize; may switch the pipeline between main and substream
+    bool setTileSize(PipelineID id, int width, int height);
+
+    // Frame taps; nullptr if the pipeline or tap point does not exist
+    FrameTapPtr subscribeFrames(PipelineID id, const FrameTapConfig& config, FrameCallback callback);
+
+    // Pre-event buffering and event recordings; false if the pipeline does not exist
+    bool setPreEventConfig(PipelineID id, const PreEventConfig& config);
+    bool triggerEventRecording(PipelineID id, const EventRecordingRequest& request, std::string& location);
+
+    // RTP output session description; false if the pipeline does not exist or has not negotiated
+    bool getSdp(PipelineID id, std::string& sdp);
+
+    // Recording segment finalize notifications
+    void setSegmentCallback(SegmentCallback callback)
+    {
+        std::lock_guard<std::mutex> lock(m_segmentCallbackMutex);
+        m_segmentCallback = std::move(callback);
+    }
+
+    // Analytics sampling under a global frame and CPU budget
+    void setAnalyticsConfig(const AnalyticsBudgetConfig& config) { m_analytics.setConfig(config); }
+    void setAnalyticsCallback(AnalyticsCallback callback) { m_analytics.setCallback(std::move(callback)); }
+    bool addAnalyticsCamera(PipelineID id, const AnalyticsCameraConfig& config) { return m_analytics.addCamera(id, config); }
+    void removeAnalyticsCamera(PipelineID id) { m_analytics.removeCamera(id); }
+    AnalyticsSnapshot getAnalyticsSnapshot() { return m_analytics.getSnapshot(); }
+
+    // Admission control
+    void setAdmissionConfig(const AdmissionConfig& config) { m_admission.setConfig(config); }
+    AdmissionSnapshot getAdmissionSnapshot() { return m_admission.getSnapshot(); }
+
+    // Decoder thread budget
+    void setDecodeBudgetConfig(const DecodeBudgetConfig& config);
+    DecodeBudgetSnapshot getDecodeBudgetSnapshot();
+
+    // Streaming thread placement; a policy change applies to pipelines created afterwards
+    void setPlacementConfig(const PlacementConfig& config) { m_placement.setConfig(config); }
+    PlacementSnapshot getPlacementSnapshot() const { return m_placement.getSnapshot(); }
+
+    // Inter-stage queues; a profile applies to pipelines of that output type built afterwards
+    void setQueueProfile(eSourceType outputType, const QueueProfile& profile);
+    QueueProfile getQueueProfile(eSourceType outputType);
+    static QueueProfile defaultQueueProfile(eSourceType outputType);
+    static QueueProfile lowLatencyQueueProfile();
+    size_t getQueueCapacity() const;
+    size_t getQueueHighWaterMark() const;
+    void   resetQueueHighWaterMark() { m_pipelinerequest.resetHighWaterMark(); }
+
     // Delete copy and move operations
     PipelineManager(const PipelineManager&) = delete;
     PipelineManager& operator=(const PipelineManager&) = delete;
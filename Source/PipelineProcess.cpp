@@ -2,6 +2,7 @@
 #include "mx_systemInfoLogger.h"
 #include <string>
 #include <string.h>
+#include <algorithm>
 #include <Poco/Environment.h>
 
 // Define static members
@@ -14,9 +15,12 @@ std::unique_ptr<PipelineProcess, std::function<void(PipelineProcess*)>> Pipeline
         }
     );
 std::mutex PipelineProcess::s_mutex;
+std::shared_mutex PipelineProcess::s_managerMutex;
 std::mutex PipelineProcess::callback_mutex;
+std::mutex PipelineProcess::ticket_mutex;
 std::once_flag PipelineProcess::s_onceFlag;
 std::condition_variable PipelineProcess::m_cvEventQueue;
+std::condition_variable PipelineProcess::m_cvEventSpace;
 std::condition_variable PipelineProcess::m_cvCallbackQueue;
 PipelineCallback PipelineProcess::m_callback = nullptr;
 std::atomic<bool> PipelineProcess::g_processrunning = true;
@@ -96,7 +100,10 @@ bool PipelineProcess::initialize(const char* debugconfigPath, PipelineCallback c
         // Step 2: Create and initialize the Pipeline Manager
         logger.updateComponentStatus("Pipeline Manager", false, "Creating manager instance");
 
-        instance.m_pipelineManager = std::make_unique<PipelineManager>();
+        {
+            std::unique_lock<std::shared_mutex> lock(s_managerMutex);
+            instance.m_pipelineManager = std::make_unique<PipelineManager>();
+        }
         if (!instance.m_pipelineManager)
         {
             logger.updateComponentStatus("Pipeline Manager", false, "Failed to create manager instance");
@@ -120,7 +127,7 @@ bool PipelineProcess::initialize(const char* debugconfigPath, PipelineCallback c
 
         // Step 3: Initialize Event Queue
         logger.updateComponentStatus("Event Queue", false, "Initializing event queue");
-        instance.m_eventQueue = std::make_unique<std::queue<PipelineRequest>>();
+        instance.m_eventQueue = std::make_unique<std::deque<PipelineRequest>>();
         if (!instance.m_eventQueue)
         {
             logger.updateComponentStatus("Event Queue", false, "Failed to create event queue");
@@ -210,20 +217,35 @@ void PipelineProcess::processEvents()
     {
         try
         {
-            std::unique_lock<std::mutex> lock(s_mutex);
-            m_cvEventQueue.wait(lock, [this]
-                {
-                    return !g_processrunning || !getInstance().m_eventQueue || !getInstance().m_eventQueue->empty();
-                });
+            PipelineRequest request;
+            {
+                std::unique_lock<std::mutex> lock(s_mutex);
+                m_cvEventQueue.wait(lock, [this]
+                    {
+                        return !g_processrunning || !getInstance().m_eventQueue || !getInstance().m_eventQueue->empty();
+                    });
 
-            if (!g_processrunning)
-                break;
+                if (!g_processrunning)
+                    break;
+
+                if (!getInstance().m_eventQueue || getInstance().m_eventQueue->empty())
+                    continue;
 
-            if (getInstance().m_eventQueue && !getInstance().m_eventQueue->empty())
+                request = getInstance().m_eventQueue->front();
+                getInstance().m_eventQueue->pop_front();
+
+                if (m_bAboveHighWater && getInstance().m_eventQueue->size() < highWaterThreshold())
+                {
+                    m_bAboveHighWater = false;
+                }
+            }
+            m_cvEventSpace.notify_one();
+
+            // Blocks while the manager's work queue is full, without holding s_mutex,
+            // so submitters can still be admitted or rejected by the policy meanwhile
+            if (!getInstance().m_pipelineManager->sendPipelineRequest(request))
             {
-                PipelineRequest request = getInstance().m_eventQueue->front();
-                getInstance().m_eventQueue->pop();
-                getInstance().m_pipelineManager->sendPipelineRequest(request);
+                onManagerCallback(PipelineStatus::Cancelled, request.getPipelineID(), request.getRequestID(), "Pipeline manager stopped before the request was queued");
             }
         }
         catch (const std::exception& e)
@@ -233,16 +255,76 @@ void PipelineProcess::processEvents()
     }
 }
 
-void PipelineProcess::enqueueRequest(const PipelineRequest& request)
+PipelineTicket PipelineProcess::enqueueRequest(const PipelineRequest& request)
 {
+    const size_t requestId = request.getRequestID();
+    auto state = std::make_shared<PipelineTicket::State>(requestId);
+
+    {
+        std::lock_guard<std::mutex> lock(ticket_mutex);
+        auto& pending = getInstance().m_pendingTickets;
+        if (pending.find(requestId) != pending.end())
+        {
+            MX_LOG_ERROR("PipelineProcess", ("Request ID already in flight: " + std::to_string(requestId)).c_str());
+            return PipelineTicket::completed({PipelineStatus::ConfigError, request.getPipelineID(), requestId, "Request ID already in flight"});
+        }
+        pending[requestId] = state;
+    }
+
     try
     {
+        std::optional<PipelineRequest> victim;
+        std::string rejectReason;
+        bool bAdmitted = false;
+        bool bCrossedHighWater = false;
+        size_t depth = 0;
         {
             std::unique_lock<std::mutex> lock(s_mutex);
-            getInstance().m_eventQueue->push(request);
+            PipelineProcess& instance = getInstance();
+            if (!instance.m_eventQueue)
+            {
+                throw std::runtime_error("Event queue not initialized");
+            }
+
+            bAdmitted = instance.admitLocked(lock, request, victim, rejectReason);
+            if (bAdmitted)
+            {
+                instance.m_eventQueue->push_back(request);
+                depth = instance.m_eventQueue->size();
+                instance.m_iSubmitHighWater = std::max(instance.m_iSubmitHighWater, depth);
+
+                if (!instance.m_bAboveHighWater && depth >= instance.highWaterThreshold())
+                {
+                    instance.m_bAboveHighWater = true;
+                    bCrossedHighWater = true;
+                }
+            }
+        }
+
+        if (victim)
+        {
+            MX_LOG_WARN("PipelineProcess", ("Shed request " + std::to_string(victim->getRequestID()) + " for higher priority request " + std::to_string(requestId)).c_str());
+            onManagerCallback(PipelineStatus::Cancelled, victim->getPipelineID(), victim->getRequestID(), "Request shed by backpressure policy");
+        }
+
+        if (!bAdmitted)
+        {
+            {
+                std::lock_guard<std::mutex> lock(ticket_mutex);
+                getInstance().m_pendingTickets.erase(requestId);
+            }
+            MX_LOG_WARN("PipelineProcess", ("Request " + std::to_string(requestId) + " rejected: " + rejectReason).c_str());
+            state->complete({PipelineStatus::ResourceError, request.getPipelineID(), requestId, rejectReason});
+            onManagerCallback(PipelineStatus::ResourceError, request.getPipelineID(), requestId, rejectReason);
+            return PipelineTicket(state);
         }
            
         m_cvEventQueue.notify_one();
+
+        if (bCrossedHighWater)
+        {
+            onManagerCallback(PipelineStatus::Information, 0, 0, "Submission queue above high-water mark: " + std::to_string(depth));
+        }
         
         // Notify request enqueued
         onManagerCallback(PipelineStatus::InProgress,request.getPipelineID(),request.getRequestID(),"Incomming Request enqueued for in Pipeline Processor");
@@ -250,8 +332,15 @@ void PipelineProcess::enqueueRequest(const PipelineRequest& request)
     }
     catch (const std::exception& e)
     {
+        {
+            std::lock_guard<std::mutex> lock(ticket_mutex);
+            getInstance().m_pendingTickets.erase(requestId);
+        }
+        state->complete({PipelineStatus::Error, request.getPipelineID(), requestId, std::string("Failed to enqueue request: ") + e.what()});
         onManagerCallback(PipelineStatus::Error, 0, 0, std::string("Failed to enqueue request: ") + e.what());
     }
+
+    return PipelineTicket(state);
 }
 
 void PipelineProcess::shutdown()
@@ -268,6 +357,7 @@ void PipelineProcess::shutdown()
         std::lock_guard<std::mutex> lock(s_mutex); // Ensure thread safety
         g_processrunning = false;
         m_cvEventQueue.notify_all();
+        m_cvEventSpace.notify_all();  // release submitters blocked by the backpressure policy
     }
 
     {
@@ -308,7 +398,11 @@ void PipelineProcess::shutdown()
             {
                 s_instance->m_eventQueue.reset();
             }
+        }
 
+        {
+            // Waits for calls still inside the manager, e.g. a rebuild
+            std::unique_lock<std::shared_mutex> lock(s_managerMutex);
             if (s_instance->m_pipelineManager)
             {
                 s_instance->m_pipelineManager.reset();
@@ -316,6 +410,12 @@ void PipelineProcess::shutdown()
         }
         MxLogger::instance().shutdown();
     }
+    // Nothing will report on the remaining requests any more
+    if (s_instance)
+    {
+        s_instance->cancelPendingTickets("Pipeline process shut down");
+    }
+
     // Now it's safe to reset the instance itself
     cleanupInstance();
 }
@@ -327,6 +427,10 @@ void PipelineProcess::enqueueCallback(const CallbackData& data)
     {
         {
             std::unique_lock<std::mutex> lock(callback_mutex);
+            if (!m_callbackQueue)
+            {
+                return;
+            }
             m_callbackQueue->push(data);
         }
         
@@ -366,6 +470,9 @@ void PipelineProcess::processCallbacks()
                 {
                     m_callback(data.status, data.pipelineId, data.requestId, data.message);
                 }
+
+                // Complete the submitter's ticket after the callback has seen the same status
+                resolveTicket(data);
             }
         }
         catch (const std::exception& e)
@@ -382,11 +489,403 @@ void PipelineProcess::setCallback(PipelineCallback callback)
 
 void PipelineProcess::onManagerCallback(PipelineStatus status, size_t pipelineId, size_t requestId, const std::string& message)
 {
-    // Process can add additional context here if needed
-    if (m_callback)
+    // Queue even without an application callback, pending tickets resolve from the same queue
+    CallbackData data = {status, pipelineId, requestId, message};
+    getInstance().enqueueCallback(data);
+}
+
+///////////////////////////////////////////////    Backpressure   //////////////////////////////////////////
+
+size_t PipelineProcess::highWaterThreshold() const
+{
+    size_t threshold = static_cast<size_t>(m_backpressure.iCapacity * m_backpressure.fHighWaterRatio);
+    return std::max<size_t>(threshold, 1);
+}
+
+bool PipelineProcess::admitLocked(std::unique_lock<std::mutex>& lock, const PipelineRequest& request,
+                                  std::optional<PipelineRequest>& victim, std::string& reason)
+{
+    if (!g_processrunning)
+    {
+        reason = "Pipeline process is shutting down";
+        return false;
+    }
+
+    if (m_eventQueue->size() < m_backpressure.iCapacity)
+    {
+        return true;
+    }
+
+    switch (m_backpressure.ePolicy)
+    {
+    case eBackpressurePolicy::BACKPRESSURE_BLOCK:
+    {
+        bool bSpace = m_cvEventSpace.wait_for(lock, std::chrono::milliseconds(m_backpressure.iBlockTimeoutMs), [this]
+            {
+                return !g_processrunning || m_eventQueue->size() < m_backpressure.iCapacity;
+            });
+
+        if (!g_processrunning)
+        {
+            reason = "Pipeline process is shutting down";
+            return false;
+        }
+        if (!bSpace)
+        {
+            ++m_iBlockTimeouts;
+            reason = "Submission queue full, timed out after " + std::to_string(m_backpressure.iBlockTimeoutMs) + " ms";
+            return false;
+        }
+        return true;
+    }
+    case eBackpressurePolicy::BACKPRESSURE_SHED_LOWEST:
+    {
+        // Newest of the lowest priority requests goes first, older work keeps its place
+        auto lowest = m_eventQueue->end();
+        for (auto it = m_eventQueue->begin(); it != m_eventQueue->end(); ++it)
+        {
+            if (lowest == m_eventQueue->end() || it->getPriority() <= lowest->getPriority())
+            {
+                lowest = it;
+            }
+        }
+
+        if (lowest != m_eventQueue->end() && lowest->getPriority() < request.getPriority())
+        {
+            victim = std::move(*lowest);
+            m_eventQueue->erase(lowest);
+            ++m_iShed;
+            return true;
+        }
+
+        ++m_iRejected;
+        reason = "Submission queue full and no lower priority request to shed";
+        return false;
+    }
+    case eBackpressurePolicy::BACKPRESSURE_REJECT:
+    default:
+        ++m_iRejected;
+        reason = "Submission queue full (" + std::to_string(m_backpressure.iCapacity) + ")";
+        return false;
+    }
+}
+
+void PipelineProcess::setBackpressureConfig(const BackpressureConfig& config)
+{
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        getInstance().m_backpressure = config;
+    }
+    // A larger capacity may unblock waiting submitters
+    m_cvEventSpace.notify_all();
+}
+
+BackpressureConfig PipelineProcess::getBackpressureConfig()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    return getInstance().m_backpressure;
+}
+
+QueueOccupancy PipelineProcess::getQueueOccupancy()
+{
+    QueueOccupancy occupancy;
+    PipelineProcess& instance = getInstance();
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        occupancy.iSubmitDepth     = instance.m_eventQueue ? instance.m_eventQueue->size() : 0;
+        occupancy.iSubmitCapacity  = instance.m_backpressure.iCapacity;
+        occupancy.iSubmitHighWater = instance.m_iSubmitHighWater;
+        occupancy.iRejected        = instance.m_iRejected;
+        occupancy.iShed            = instance.m_iShed;
+        occupancy.iBlockTimeouts   = instance.m_iBlockTimeouts;
+
+    }
+
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (instance.m_pipelineManager)
+    {
+        occupancy.iWorkDepth     = instance.m_pipelineManager->getQueueSize();
+        occupancy.iWorkCapacity  = instance.m_pipelineManager->getQueueCapacity();
+        occupancy.iWorkHighWater = instance.m_pipelineManager->getQueueHighWaterMark();
+    }
+    return occupancy;
+}
+
+void PipelineProcess::resetHighWaterMarks()
+{
+    PipelineProcess& instance = getInstance();
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        instance.m_iSubmitHighWater = instance.m_eventQueue ? instance.m_eventQueue->size() : 0;
+    }
+
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (instance.m_pipelineManager)
+    {
+        instance.m_pipelineManager->resetQueueHighWaterMark();
+    }
+}
+
+bool PipelineProcess::getPipelineStats(size_t pipelineId, PipelineStatsSnapshot& stats)
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        return getInstance().m_pipelineManager->getPipelineStats(pipelineId, stats);
+    }
+    return false;
+}
+
+bool PipelineProcess::setKeyframeOnly(size_t pipelineId, bool bKeyframeOnly)
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        return getInstance().m_pipelineManager->setKeyframeOnly(pipelineId, bKeyframeOnly);
+    }
+    return false;
+}
+
+bool PipelineProcess::setDisplayParked(size_t pipelineId, bool bParked)
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        return getInstance().m_pipelineManager->setDisplayParked(pipelineId, bParked);
+    }
+    return false;
+}
+
+bool PipelineProcess::setTileSize(size_t pipelineId, int width, int height)
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        return getInstance().m_pipelineManager->setTileSize(pipelineId, width, height);
+    }
+    return false;
+}
+
+FrameTapPtr PipelineProcess::subscribeFrames(size_t pipelineId, const FrameTapConfig& config, FrameCallback callback)
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        return getInstance().m_pipelineManager->subscribeFrames(pipelineId, config, std::move(callback));
+    }
+    return nullptr;
+}
+
+bool PipelineProcess::setPreEventConfig(size_t pipelineId, const PreEventConfig& config)
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        return getInstance().m_pipelineManager->setPreEventConfig(pipelineId, config);
+    }
+    return false;
+}
+
+bool PipelineProcess::getSdp(size_t pipelineId, std::string& sdp)
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        return getInstance().m_pipelineManager->getSdp(pipelineId, sdp);
+    }
+    return false;
+}
+
+bool PipelineProcess::triggerEventRecording(size_t pipelineId, const EventRecordingRequest& request, std::string& location)
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        return getInstance().m_pipelineManager->triggerEventRecording(pipelineId, request, location);
+    }
+    return false;
+}
+
+void PipelineProcess::setSegmentCallback(SegmentCallback callback)
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        getInstance().m_pipelineManager->setSegmentCallback(std::move(callback));
+    }
+}
+
+void PipelineProcess::setAnalyticsConfig(const AnalyticsBudgetConfig& config)
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        getInstance().m_pipelineManager->setAnalyticsConfig(config);
+    }
+}
+
+void PipelineProcess::setAnalyticsCallback(AnalyticsCallback callback)
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        getInstance().m_pipelineManager->setAnalyticsCallback(std::move(callback));
+    }
+}
+
+bool PipelineProcess::addAnalyticsCamera(size_t pipelineId, const AnalyticsCameraConfig& config)
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        return getInstance().m_pipelineManager->addAnalyticsCamera(pipelineId, config);
+    }
+    return false;
+}
+
+void PipelineProcess::removeAnalyticsCamera(size_t pipelineId)
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        getInstance().m_pipelineManager->removeAnalyticsCamera(pipelineId);
+    }
+}
+
+AnalyticsSnapshot PipelineProcess::getAnalyticsSnapshot()
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        return getInstance().m_pipelineManager->getAnalyticsSnapshot();
+    }
+    return AnalyticsSnapshot();
+}
+
+void PipelineProcess::setStatsCallback(int intervalMs, StatsCallback callback)
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        getInstance().m_pipelineManager->setStatsCallback(intervalMs, std::move(callback));
+    }
+}
+
+void PipelineProcess::setAdmissionConfig(const AdmissionConfig& config)
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        getInstance().m_pipelineManager->setAdmissionConfig(config);
+    }
+}
+
+AdmissionSnapshot PipelineProcess::getAdmissionSnapshot()
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        return getInstance().m_pipelineManager->getAdmissionSnapshot();
+    }
+    return AdmissionSnapshot();
+}
+
+void PipelineProcess::setDecodeBudgetConfig(const DecodeBudgetConfig& config)
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        getInstance().m_pipelineManager->setDecodeBudgetConfig(config);
+    }
+}
+
+DecodeBudgetSnapshot PipelineProcess::getDecodeBudgetSnapshot()
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        return getInstance().m_pipelineManager->getDecodeBudgetSnapshot();
+    }
+    return DecodeBudgetSnapshot();
+}
+
+void PipelineProcess::setPlacementConfig(const PlacementConfig& config)
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
     {
-        // Queue the callback instead of calling it directly
-        CallbackData data = {status, pipelineId, requestId, message};
-        getInstance().enqueueCallback(data);
+        getInstance().m_pipelineManager->setPlacementConfig(config);
     }
-}
\ No newline at end of file
+}
+
+PlacementSnapshot PipelineProcess::getPlacementSnapshot()
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        return getInstance().m_pipelineManager->getPlacementSnapshot();
+    }
+    return PlacementSnapshot();
+}
+
+void PipelineProcess::setQueueProfile(eSourceType outputType, const QueueProfile& profile)
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        getInstance().m_pipelineManager->setQueueProfile(outputType, profile);
+    }
+}
+
+QueueProfile PipelineProcess::getQueueProfile(eSourceType outputType)
+{
+    std::shared_lock<std::shared_mutex> lock(s_managerMutex);
+    if (getInstance().m_pipelineManager)
+    {
+        return getInstance().m_pipelineManager->getQueueProfile(outputType);
+    }
+    return PipelineManager::defaultQueueProfile(outputType);
+}
+
+///////////////////////////////////////////////    Tickets   //////////////////////////////////////////
+
+bool PipelineProcess::isTerminalStatus(PipelineStatus status)
+{
+    return status != PipelineStatus::InProgress && status != PipelineStatus::Information;
+}
+
+void PipelineProcess::resolveTicket(const CallbackData& data)
+{
+    if (!isTerminalStatus(data.status))
+    {
+        return;
+    }
+
+    std::shared_ptr<PipelineTicket::State> state;
+    {
+        std::lock_guard<std::mutex> lock(ticket_mutex);
+        auto it = m_pendingTickets.find(data.requestId);
+        if (it == m_pendingTickets.end())
+        {
+            return;
+        }
+        state = std::move(it->second);
+        m_pendingTickets.erase(it);
+    }
+
+    state->complete({data.status, data.pipelineId, data.requestId, data.message});
+}
+
+void PipelineProcess::cancelPendingTickets(const std::string& reason)
+{
+    std::unordered_map<size_t, std::shared_ptr<PipelineTicket::State>> pending;
+    {
+        std::lock_guard<std::mutex> lock(ticket_mutex);
+        pending.swap(m_pendingTickets);
+    }
+
+    for (auto& [requestId, state] : pending)
+    {
+        state->complete({PipelineStatus::Cancelled, 0, requestId, reason});
+    }
+}
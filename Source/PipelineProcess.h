@@ -7,8 +7,24 @@
 #include <iostream>
 #include <functional>
 #include <queue>
+#include <deque>
 #include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <optional>
 #include "PipelineManager.h"
+#include "PipelineTicket.h"
+#include "PipelineStats.h"
+#include "AdmissionController.h"
+#include "DecodeThreadBudget.h"
+#include "CpuPlacement.h"
+#include "SharedTaskPool.h"
+#include "RtspServerOutput.h"
+#include "HlsServer.h"
+#include "MosaicOutput.h"
+#include "FrameTap.h"
+#include "AnalyticsScheduler.h"
+#include "PreEventBuffer.h"
 #include "PipelineRequest.h"
 #include "mx_logger.h"
 
@@ -26,12 +42,15 @@ class PipelineProcess
 {
 private:
     static std::unique_ptr<PipelineProcess, std::function<void(PipelineProcess*)>> s_instance;
-    static std::mutex               s_mutex;
+    static std::mutex               s_mutex;            // submission queue and backpressure state only
+    static std::shared_mutex        s_managerMutex;     // m_pipelineManager's lifetime: shared per call, exclusive to create or reset
     static std::condition_variable  m_cvEventQueue;
+    static std::condition_variable  m_cvEventSpace;
     static PipelineCallback         m_callback;  // Callback to main
     static std::once_flag           s_onceFlag;
     static std::atomic<bool>        g_processrunning;
     static std::condition_variable  m_cvCallbackQueue;
+    static std::mutex               ticket_mutex;
 
     // Structure to hold callback data
     struct CallbackData {
@@ -42,10 +61,21 @@ private:
     };
 
     std::unique_ptr<PipelineManager>                m_pipelineManager;
-    std::unique_ptr<std::queue<PipelineRequest>>    m_eventQueue;
+    std::unique_ptr<std::deque<PipelineRequest>>    m_eventQueue;
     std::unique_ptr<std::queue<CallbackData>>       m_callbackQueue;
     std::unique_ptr<std::thread>                    m_processingThread;
     std::unique_ptr<std::thread>                    m_callbackThread;
+
+    // Submission backpressure, guarded by s_mutex
+    BackpressureConfig                              m_backpressure;
+    size_t                                          m_iSubmitHighWater{0};
+    size_t                                          m_iRejected{0};
+    size_t                                          m_iShed{0};
+    size_t                                          m_iBlockTimeouts{0};
+    bool                                            m_bAboveHighWater{false};
+
+    // Tickets waiting for the terminal status of their request, keyed by request ID
+    std::unordered_map<size_t, std::shared_ptr<PipelineTicket::State>> m_pendingTickets;
     static std::atomic<bool>        g_callbackrunning;
     static std::mutex               callback_mutex;
    
@@ -64,6 +94,17 @@ private:
 
     void processEvents();
     void processCallbacks();
+
+    // Ticket bookkeeping
+    void resolveTicket(const CallbackData& data);
+    void cancelPendingTickets(const std::string& reason);
+    static bool isTerminalStatus(PipelineStatus status);
+
+    // Applies the backpressure policy to a full submission queue (s_mutex held).
+    // Returns false if the request must be rejected; a shed request is moved into victim.
+    bool admitLocked(std::unique_lock<std::mutex>& lock, const PipelineRequest& request,
+                     std::optional<PipelineRequest>& victim, std::string& reason);
+    size_t highWaterThreshold() const;
     
     // Handle pipeline errors and propagate them to application
    // static  void PipelineErrorcallback(const std::string& error);
@@ -81,8 +122,89 @@ public:
     static bool initialize(const char* debugconfigPath, PipelineCallback callback);
     
     static void shutdown();
-    static void enqueueRequest(const PipelineRequest& request);
+
+    // Returns a ticket that completes with the first terminal (non InProgress/Information)
+    // status reported for the request ID
+    static PipelineTicket enqueueRequest(const PipelineRequest& request);
     
+    // Submission queue policy and occupancy, so upstream controllers can throttle early
+    static void setBackpressureConfig(const BackpressureConfig& config);
+    static BackpressureConfig getBackpressureConfig();
+    static QueueOccupancy getQueueOccupancy();
+    static void resetHighWaterMarks();
+
+    // Per-pipeline runtime statistics, and a periodic snapshot on its own thread
+    static bool getPipelineStats(size_t pipelineId, PipelineStatsSnapshot& stats);
+    static void setStatsCallback(int intervalMs, StatsCallback callback);
+
+    // Switch a display pipeline between keyframe-only and full rate decode
+    static bool setKeyframeOnly(size_t pipelineId, bool bKeyframeOnly);
+
+    // Decode-on-demand: park a hidden tile's decode branch, unpark to resume at the next keyframe
+    static bool setDisplayParked(size_t pipelineId, bool bParked);
+
+    // Tile size for a display pipeline; picks the main or substream that fits
+    static bool setTileSize(size_t pipelineId, int width, int height);
+
+    // Zero-copy frame access: encoded access units or decoded frames through a bounded
+    // per-consumer queue. Pull from the tap, or pass a callback to get its own thread.
+    // tap->close() unsubscribes.
+    static FrameTapPtr subscribeFrames(size_t pipelineId, const FrameTapConfig& config, FrameCallback callback = nullptr);
+
+    // Pre-event buffering: keep the last N seconds of compressed video per pipeline, and on
+    // an alarm record it plus the live continuation. A running event recording is extended.
+    // The closed file is reported through the segment callback.
+    static bool setPreEventConfig(size_t pipelineId, const PreEventConfig& config);
+    static bool triggerEventRecording(size_t pipelineId, const EventRecordingRequest& request, std::string& location);
+
+    // SDP for a pipeline with an RTP (multicast) output, for receivers to join the group.
+    // Also written to stNetworkStreaming.sSdpPath when set.
+    static bool getSdp(size_t pipelineId, std::string& sdp);
+
+    // Called with each recording segment once it is closed and playable
+    static void setSegmentCallback(SegmentCallback callback);
+
+    // Analytics sampling: per-camera slots under a global frames/s and CPU budget,
+    // sampled frames are decoded and handed to the callback on a worker pool
+    static void setAnalyticsConfig(const AnalyticsBudgetConfig& config);
+    static void setAnalyticsCallback(AnalyticsCallback callback);
+    static bool addAnalyticsCamera(size_t pipelineId, const AnalyticsCameraConfig& config);
+    static void removeAnalyticsCamera(size_t pipelineId);
+    static AnalyticsSnapshot getAnalyticsSnapshot();
+
+    // Resource admission for new pipelines
+    static void setAdmissionConfig(const AdmissionConfig& config);
+    static AdmissionSnapshot getAdmissionSnapshot();
+
+    // Global decoder thread budget across display pipelines
+    static void setDecodeBudgetConfig(const DecodeBudgetConfig& config);
+    static DecodeBudgetSnapshot getDecodeBudgetSnapshot();
+
+    // CPU/NUMA placement of streaming threads
+    static void setPlacementConfig(const PlacementConfig& config);
+    static PlacementSnapshot getPlacementSnapshot();
+
+    // Shared streaming thread pool; config applies to pipelines built afterwards
+    static void setTaskPoolConfig(const TaskPoolConfig& config) { SharedTaskPool::instance().setConfig(config); }
+    static TaskPoolSnapshot getTaskPoolSnapshot() { return SharedTaskPool::instance().getSnapshot(); }
+
+    // Embedded RTSP server serving network outputs with stNetworkStreaming.bServe set
+    static void setRtspServerConfig(const RtspServerConfig& config) { RtspServerOutput::instance().setConfig(config); }
+    static RtspServerSnapshot getRtspServerSnapshot() { return RtspServerOutput::instance().getSnapshot(); }
+
+    // HTTP endpoint for STREAMING_PROTOCOL_HTTP outputs: /hls/<pipeline id>/index.m3u8
+    static void setHlsServerConfig(const HlsServerConfig& config) { HlsServer::instance().setConfig(config); }
+    static HlsServerSnapshot getHlsServerSnapshot() { return HlsServer::instance().getSnapshot(); }
+
+    // Display walls for display outputs with sMosaic set; a layout change never rebuilds a camera pipeline
+    static bool setMosaicLayout(const std::string& wall, const MosaicLayout& layout) { return MosaicOutput::instance().setLayout(wall, layout); }
+    static void removeMosaic(const std::string& wall) { MosaicOutput::instance().removeWall(wall); }
+    static std::vector<MosaicSnapshot> getMosaicSnapshot() { return MosaicOutput::instance().getSnapshot(); }
+
+    // Inter-stage queue layout per output type
+    static void setQueueProfile(eSourceType outputType, const QueueProfile& profile);
+    static QueueProfile getQueueProfile(eSourceType outputType);
+
     // Set callback for pipeline status updates and errors
     static void setCallback(PipelineCallback callback);
     
@@ -2,13 +2,13 @@
 
 // Default constructor
 PipelineRequest::PipelineRequest()
-    : m_uiPipelineID(0), m_uiRequestID(0), m_eAction(eAction::ACTION_NONE), m_stMediaStreamDevice() 
+    : m_uiPipelineID(0), m_uiRequestID(0), m_eAction(eAction::ACTION_NONE), m_stMediaStreamDevice(), m_iPriority(0) 
 {
 }
 
 // Parameterized constructor
 PipelineRequest::PipelineRequest(size_t pipelineID, size_t requestID, eAction action, const MediaStreamDevice& mediaStreamDevice)
-    : m_uiPipelineID(pipelineID), m_uiRequestID(requestID), m_eAction(action), m_stMediaStreamDevice(mediaStreamDevice) 
+    : m_uiPipelineID(pipelineID), m_uiRequestID(requestID), m_eAction(action), m_stMediaStreamDevice(mediaStreamDevice), m_iPriority(0) 
 {
 
 }
@@ -18,7 +18,8 @@ PipelineRequest::PipelineRequest(const PipelineRequest& other)
     : m_uiPipelineID(other.m_uiPipelineID),
     m_uiRequestID(other.m_uiRequestID),
     m_eAction(other.m_eAction),
-    m_stMediaStreamDevice(other.m_stMediaStreamDevice) 
+    m_stMediaStreamDevice(other.m_stMediaStreamDevice),
+    m_iPriority(other.m_iPriority) 
 {
     
 }
@@ -28,7 +29,8 @@ PipelineRequest::PipelineRequest(PipelineRequest&& other) noexcept
     : m_uiPipelineID(other.m_uiPipelineID),
     m_uiRequestID(other.m_uiRequestID),
     m_eAction(other.m_eAction),
-    m_stMediaStreamDevice(std::move(other.m_stMediaStreamDevice)) 
+    m_stMediaStreamDevice(std::move(other.m_stMediaStreamDevice)),
+    m_iPriority(other.m_iPriority) 
 {
    
 }
@@ -43,6 +45,7 @@ PipelineRequest& PipelineRequest::operator=(const PipelineRequest& other)
         m_uiRequestID = other.m_uiRequestID;
         m_eAction = other.m_eAction;
         m_stMediaStreamDevice = other.m_stMediaStreamDevice;
+        m_iPriority = other.m_iPriority;
     }
     return *this;
 }
@@ -57,6 +60,7 @@ PipelineRequest& PipelineRequest::operator=(PipelineRequest&& other) noexcept
         m_uiRequestID = other.m_uiRequestID;
         m_eAction = other.m_eAction;
         m_stMediaStreamDevice = std::move(other.m_stMediaStreamDevice);
+        m_iPriority = other.m_iPriority;
     }
     return *this;
 }
@@ -9,6 +9,7 @@ class PipelineRequest
     size_t m_uiRequestID;
     eAction m_eAction;
     MediaStreamDevice m_stMediaStreamDevice;
+    int m_iPriority;    // higher value survives longer when the submission queue sheds load
 
 public:
     // Default constructor
@@ -44,6 +45,9 @@ public:
 
     inline const MediaStreamDevice& getMediaStreamDevice() const { return m_stMediaStreamDevice; }
     inline void setMediaStreamDevice(const MediaStreamDevice& mediaStreamDevice) { m_stMediaStreamDevice = mediaStreamDevice; }
+
+    inline int getPriority() const { return m_iPriority; }
+    inline void setPriority(int priority) { m_iPriority = priority; }
 };
 
 #endif // PIPELINEREQUEST_H
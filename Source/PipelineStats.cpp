@@ -0,0 +1,366 @@
+#include "PipelineStats.h"
+#include "mx_logger.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+// Clock reads for the overhead meter are only taken on every Nth buffer
+#define STATS_OVERHEAD_SAMPLE_EVERY 16
+// Lag beyond the best observed lag before an access unit counts as late
+#define STATS_MIN_LATE_THRESHOLD_NS (40 * 1000 * 1000)
+// Allowance for camera/host clock drift when tracking the best lag
+#define STATS_MIN_LAG_RELAX_NS      (10 * 1000)
+// Seconds from the NTP epoch (1900) to the Unix epoch (1970)
+#define STATS_NTP_UNIX_OFFSET_S     2208988800ULL
+
+PipelineStats::~PipelineStats()
+{
+    detach();
+}
+
+void PipelineStats::StageCounters::reset()
+{
+    attached.store(false, std::memory_order_relaxed);
+    frames.store(0, std::memory_order_relaxed);
+    bytes.store(0, std::memory_order_relaxed);
+    keyframes.store(0, std::memory_order_relaxed);
+    ptsGaps.store(0, std::memory_order_relaxed);
+    late.store(0, std::memory_order_relaxed);
+    jitterNs.store(0, std::memory_order_relaxed);
+    probeNs.store(0, std::memory_order_relaxed);
+
+    lastArrivalNs = -1;
+    lastPts = GST_CLOCK_TIME_NONE;
+    avgPtsDeltaNs = 0;
+    minLagNs = INT64_MAX;
+    sampleTick = 0;
+    windowFrames = 0;
+    windowBytes = 0;
+}
+
+void PipelineStats::LatencyCounters::reset()
+{
+    attached.store(false, std::memory_order_relaxed);
+    samples.store(0, std::memory_order_relaxed);
+    lastNs.store(0, std::memory_order_relaxed);
+    avgNs.store(0, std::memory_order_relaxed);
+    maxNs.store(0, std::memory_order_relaxed);
+    captureSamples.store(0, std::memory_order_relaxed);
+    captureAvgNs.store(0, std::memory_order_relaxed);
+    captureMaxNs.store(0, std::memory_order_relaxed);
+    syncLatencyNs.store(0, std::memory_order_relaxed);
+
+    bSegment = false;
+    if (ntpCaps)
+    {
+        gst_caps_unref(ntpCaps);
+        ntpCaps = nullptr;
+    }
+    sink = nullptr;
+}
+
+int64_t PipelineStats::monotonicNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool PipelineStats::attach(GstElement* element, const char* padName, eStatsStage stage)
+{
+    if (!element)
+    {
+        return false;
+    }
+
+    GstPad* pad = gst_element_get_static_pad(element, padName);
+    if (!pad)
+    {
+        MX_LOG_WARN("PipelineStats", ("no static pad '" + std::string(padName) + "' for stats probe").c_str());
+        return false;
+    }
+
+    StageCounters& counters = m_stages[static_cast<size_t>(stage)];
+    counters.reset();
+
+    gulong id = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, &PipelineStats::onBuffer, &counters, nullptr);
+    if (id == 0)
+    {
+        gst_object_unref(pad);
+        return false;
+    }
+
+    counters.attached.store(true, std::memory_order_relaxed);
+    m_probes.push_back({pad, id});   // keeps the pad reference until detach()
+    return true;
+}
+
+bool PipelineStats::attachLatency(GstElement* sink)
+{
+    if (!sink)
+    {
+        return false;
+    }
+
+    GstPad* pad = gst_element_get_static_pad(sink, "sink");
+    if (!pad)
+    {
+        MX_LOG_WARN("PipelineStats", "no sink pad for the latency meter");
+        return false;
+    }
+
+    m_latency.reset();
+    m_latency.sink = sink;
+    m_latency.ntpCaps = gst_caps_from_string("timestamp/x-ntp");
+
+    gulong id = gst_pad_add_probe(pad, (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM),
+                                  &PipelineStats::onRender, &m_latency, nullptr);
+    if (id == 0)
+    {
+        gst_object_unref(pad);
+        return false;
+    }
+
+    m_latency.attached.store(true, std::memory_order_relaxed);
+    m_probes.push_back({pad, id});
+    return true;
+}
+
+void PipelineStats::detach()
+{
+    for (auto& probe : m_probes)
+    {
+        gst_pad_remove_probe(probe.pad, probe.id);
+        gst_object_unref(probe.pad);
+    }
+    m_probes.clear();
+
+    std::lock_guard<std::mutex> lock(m_windowMutex);
+    for (auto& counters : m_stages)
+    {
+        counters.reset();
+    }
+    m_latency.reset();
+    m_windowStart = std::chrono::steady_clock::now();
+    m_windowProbeNs = 0;
+}
+
+GstPadProbeReturn PipelineStats::onBuffer(GstPad* pad, GstPadProbeInfo* info, gpointer data)
+{
+    StageCounters* counters = static_cast<StageCounters*>(data);
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (!buffer)
+    {
+        return GST_PAD_PROBE_OK;
+    }
+
+    const int64_t arrivalNs = monotonicNs();
+
+    counters->frames.fetch_add(1, std::memory_order_relaxed);
+    counters->bytes.fetch_add(gst_buffer_get_size(buffer), std::memory_order_relaxed);
+    if (!GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT))
+    {
+        counters->keyframes.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const GstClockTime pts = GST_BUFFER_PTS(buffer);
+    if (GST_CLOCK_TIME_IS_VALID(pts))
+    {
+        bool bGap = GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DISCONT);
+
+        if (GST_CLOCK_TIME_IS_VALID(counters->lastPts) && counters->lastArrivalNs >= 0 && pts > counters->lastPts)
+        {
+            const int64_t ptsDelta = static_cast<int64_t>(pts - counters->lastPts);
+
+            // A jump well past the usual frame spacing means missing access units
+            if (counters->avgPtsDeltaNs > 0 && ptsDelta > 2 * counters->avgPtsDeltaNs)
+            {
+                bGap = true;
+            }
+            else
+            {
+                counters->avgPtsDeltaNs = counters->avgPtsDeltaNs == 0 ? ptsDelta
+                                        : counters->avgPtsDeltaNs + (ptsDelta - counters->avgPtsDeltaNs) / 16;
+            }
+
+            // J += (|D| - J) / 16
+            const int64_t d = (arrivalNs - counters->lastArrivalNs) - ptsDelta;
+            int64_t jitter = counters->jitterNs.load(std::memory_order_relaxed);
+            jitter += (std::llabs(d) - jitter) / 16;
+            counters->jitterNs.store(jitter, std::memory_order_relaxed);
+        }
+
+        if (bGap)
+        {
+            counters->ptsGaps.fetch_add(1, std::memory_order_relaxed);
+            counters->minLagNs = INT64_MAX;     // timeline moved, re-learn the best lag
+        }
+
+        // Late: arrived noticeably behind the best arrival-vs-PTS lag seen so far
+        const int64_t lag = arrivalNs - static_cast<int64_t>(pts);
+        if (counters->minLagNs == INT64_MAX || lag < counters->minLagNs)
+        {
+            counters->minLagNs = lag;
+        }
+        else
+        {
+            counters->minLagNs += STATS_MIN_LAG_RELAX_NS;
+            const int64_t threshold = std::max<int64_t>(STATS_MIN_LATE_THRESHOLD_NS, 2 * counters->avgPtsDeltaNs);
+            if (lag - counters->minLagNs > threshold)
+            {
+                counters->late.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        counters->lastPts = pts;
+    }
+    counters->lastArrivalNs = arrivalNs;
+
+    if (++counters->sampleTick % STATS_OVERHEAD_SAMPLE_EVERY == 0)
+    {
+        counters->probeNs.fetch_add((monotonicNs() - arrivalNs) * STATS_OVERHEAD_SAMPLE_EVERY, std::memory_order_relaxed);
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn PipelineStats::onRender(GstPad* pad, GstPadProbeInfo* info, gpointer data)
+{
+    LatencyCounters* counters = static_cast<LatencyCounters*>(data);
+
+    if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM)
+    {
+        GstEvent* event = GST_PAD_PROBE_INFO_EVENT(info);
+        if (GST_EVENT_TYPE(event) == GST_EVENT_SEGMENT)
+        {
+            gst_event_copy_segment(event, &counters->segment);
+            counters->bSegment = true;
+        }
+        return GST_PAD_PROBE_OK;
+    }
+
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (!buffer || !counters->bSegment || !GST_CLOCK_TIME_IS_VALID(GST_BUFFER_PTS(buffer)))
+    {
+        return GST_PAD_PROBE_OK;
+    }
+
+    GstClock* clock = gst_element_get_clock(counters->sink);
+    if (!clock)
+    {
+        return GST_PAD_PROBE_OK;
+    }
+    const GstClockTime now = gst_clock_get_time(clock);
+    gst_object_unref(clock);
+
+    const GstClockTime ptsRunning = gst_segment_to_running_time(&counters->segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buffer));
+    if (!GST_CLOCK_TIME_IS_VALID(ptsRunning))
+    {
+        return GST_PAD_PROBE_OK;
+    }
+
+    // A syncing sink holds the frame until PTS + pipeline latency; otherwise it renders now
+    const int64_t nowRunning = static_cast<int64_t>(now - gst_element_get_base_time(counters->sink));
+    const int64_t renderRunning = std::max<int64_t>(nowRunning,
+        static_cast<int64_t>(ptsRunning + counters->syncLatencyNs.load(std::memory_order_relaxed)));
+    const int64_t latencyNs = std::max<int64_t>(0, renderRunning - static_cast<int64_t>(ptsRunning));
+
+    int64_t avg = counters->avgNs.load(std::memory_order_relaxed);
+    avg = counters->samples.fetch_add(1, std::memory_order_relaxed) == 0 ? latencyNs : avg + (latencyNs - avg) / 16;
+    counters->avgNs.store(avg, std::memory_order_relaxed);
+    counters->lastNs.store(latencyNs, std::memory_order_relaxed);
+    if (latencyNs > counters->maxNs.load(std::memory_order_relaxed))
+    {
+        counters->maxNs.store(latencyNs, std::memory_order_relaxed);
+    }
+
+    // rtspsrc attaches the RTCP-derived NTP capture time when add-reference-timestamp-meta is set
+    GstReferenceTimestampMeta* meta = counters->ntpCaps ? gst_buffer_get_reference_timestamp_meta(buffer, counters->ntpCaps) : nullptr;
+    if (meta && GST_CLOCK_TIME_IS_VALID(meta->timestamp))
+    {
+        const int64_t wallNtpNs = g_get_real_time() * 1000 + static_cast<int64_t>(STATS_NTP_UNIX_OFFSET_S * GST_SECOND);
+        const int64_t captureNs = wallNtpNs + (renderRunning - nowRunning) - static_cast<int64_t>(meta->timestamp);
+
+        int64_t captureAvg = counters->captureAvgNs.load(std::memory_order_relaxed);
+        captureAvg = counters->captureSamples.fetch_add(1, std::memory_order_relaxed) == 0 ? captureNs
+                   : captureAvg + (captureNs - captureAvg) / 16;
+        counters->captureAvgNs.store(captureAvg, std::memory_order_relaxed);
+        if (captureNs > counters->captureMaxNs.load(std::memory_order_relaxed))
+        {
+            counters->captureMaxNs.store(captureNs, std::memory_order_relaxed);
+        }
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+PipelineStatsSnapshot PipelineStats::snapshot(size_t pipelineId, bool bAdvanceWindow)
+{
+    std::lock_guard<std::mutex> lock(m_windowMutex);
+
+    const auto now = std::chrono::steady_clock::now();
+    const double windowSeconds = std::chrono::duration<double>(now - m_windowStart).count();
+
+    PipelineStatsSnapshot snapshot;
+    snapshot.pipelineId = pipelineId;
+    snapshot.fWindowSeconds = windowSeconds;
+
+    uint64_t probeNs = 0;
+    for (size_t i = 0; i < m_stages.size(); ++i)
+    {
+        StageCounters& counters = m_stages[i];
+        StageStatsSnapshot& stage = snapshot.stages[i];
+
+        stage.bAttached  = counters.attached.load(std::memory_order_relaxed);
+        stage.iFrames    = counters.frames.load(std::memory_order_relaxed);
+        stage.iBytes     = counters.bytes.load(std::memory_order_relaxed);
+        stage.iKeyframes = counters.keyframes.load(std::memory_order_relaxed);
+        stage.iPtsGaps   = counters.ptsGaps.load(std::memory_order_relaxed);
+        stage.iLate      = counters.late.load(std::memory_order_relaxed);
+        stage.fJitterMs  = counters.jitterNs.load(std::memory_order_relaxed) / 1e6;
+        probeNs         += counters.probeNs.load(std::memory_order_relaxed);
+
+        if (windowSeconds > 0.0)
+        {
+            stage.fFps         = (stage.iFrames - counters.windowFrames) / windowSeconds;
+            stage.fBitrateKbps = (stage.iBytes - counters.windowBytes) * 8.0 / 1000.0 / windowSeconds;
+        }
+
+        if (bAdvanceWindow)
+        {
+            counters.windowFrames = stage.iFrames;
+            counters.windowBytes  = stage.iBytes;
+        }
+    }
+
+    const StageStatsSnapshot& parser = snapshot.stage(eStatsStage::STATS_STAGE_PARSER);
+    const StageStatsSnapshot& output = snapshot.stage(eStatsStage::STATS_STAGE_OUTPUT);
+    if (parser.bAttached && output.bAttached && parser.iFrames > output.iFrames)
+    {
+        snapshot.iDropped = parser.iFrames - output.iFrames;
+    }
+
+    if (windowSeconds > 0.0)
+    {
+        snapshot.fProbeCpuPercent = (probeNs - m_windowProbeNs) / (windowSeconds * 1e9) * 100.0;
+    }
+
+    LatencyStatsSnapshot& latency = snapshot.stLatency;
+    latency.bAttached     = m_latency.attached.load(std::memory_order_relaxed);
+    latency.iSamples      = m_latency.samples.load(std::memory_order_relaxed);
+    latency.fAvgMs        = m_latency.avgNs.load(std::memory_order_relaxed) / 1e6;
+    latency.fLastMs       = m_latency.lastNs.load(std::memory_order_relaxed) / 1e6;
+    latency.fMaxMs        = (bAdvanceWindow ? m_latency.maxNs.exchange(0, std::memory_order_relaxed)
+                                            : m_latency.maxNs.load(std::memory_order_relaxed)) / 1e6;
+    latency.bCaptureClock = m_latency.captureSamples.load(std::memory_order_relaxed) > 0;
+    latency.fCaptureAvgMs = m_latency.captureAvgNs.load(std::memory_order_relaxed) / 1e6;
+    latency.fCaptureMaxMs = (bAdvanceWindow ? m_latency.captureMaxNs.exchange(0, std::memory_order_relaxed)
+                                            : m_latency.captureMaxNs.load(std::memory_order_relaxed)) / 1e6;
+
+    if (bAdvanceWindow)
+    {
+        m_windowStart = now;
+        m_windowProbeNs = probeNs;
+    }
+
+    return snapshot;
+}
@@ -0,0 +1,176 @@
+#ifndef PIPELINE_STATS_H
+#define PIPELINE_STATS_H
+
+#include <gst/gst.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Enum.h"
+
+// Probe points inside a pipeline
+enum class eStatsStage
+{
+    STATS_STAGE_DEPAY = 0,      // depayloader src: access units leaving RTP
+    STATS_STAGE_PARSER,         // parser src: parsed access units
+    STATS_STAGE_OUTPUT,         // display sink: frames that reached the renderer
+    STATS_STAGE_COUNT
+};
+
+struct StageStatsSnapshot
+{
+    bool     bAttached{false};
+    uint64_t iFrames{0};
+    uint64_t iBytes{0};
+    uint64_t iKeyframes{0};
+    uint64_t iPtsGaps{0};
+    uint64_t iLate{0};
+    double   fJitterMs{0.0};        // RFC 3550 style inter-arrival jitter
+    double   fFps{0.0};             // over the current window
+    double   fBitrateKbps{0.0};     // over the current window
+};
+
+// Time from a frame's timestamp to the moment it reaches the display sink
+struct LatencyStatsSnapshot
+{
+    bool     bAttached{false};
+    uint64_t iSamples{0};
+    double   fAvgMs{0.0};           // PTS (jitterbuffer arrival time) to render, smoothed
+    double   fMaxMs{0.0};           // over the current window
+    double   fLastMs{0.0};
+    bool     bCaptureClock{false};  // RTCP sender reports gave an NTP capture time
+    double   fCaptureAvgMs{0.0};    // capture to render; assumes camera and host share NTP
+    double   fCaptureMaxMs{0.0};
+};
+
+struct PipelineStatsSnapshot
+{
+    size_t   pipelineId{0};
+    double   fWindowSeconds{0.0};
+    uint64_t iDropped{0};           // frames that left the parser but never reached the output
+    double   fProbeCpuPercent{0.0}; // time spent inside the probes, percent of one core
+    int      iDecodeThreads{0};     // budget share the running decoder was opened with, 0 = decoder default
+    int      iNumaNode{-1};         // placement, -1 when threads are not pinned
+    std::vector<int> vCpuSet;
+    uint64_t iPinnedThreads{0};     // streaming threads that took the core set
+    std::string sStreamProfile;     // selected main/substream profile name, empty = device URL
+    bool     bKeyframeOnly{false};  // requested keyframe-only display mode
+    bool     bPassthrough{false};   // relay without the parser stage
+    bool     bTranscode{false};     // decode, convert/scale/rate and re-encode before the output
+    size_t   iRenditions{0};        // ladder branches fed by the one decode
+    eAudioRoute eAudio{eAudioRoute::AUDIO_ROUTE_NONE};
+    bool     bDisplayParked{false}; // decode branch suspended, ingest still running
+    double   fPreEventSeconds{0.0}; // compressed history held for event recordings
+    size_t   iPreEventBytes{0};
+    bool     bEventRecording{false};
+    int      iDecodeLevel{0};       // QoS degradation: 0 full, 1 non-reference skipped, 2 keyframes only
+    uint64_t iQosProcessed{0};
+    uint64_t iQosDropped{0};
+    double   fQosLatenessMs{0.0};
+    std::array<StageStatsSnapshot, static_cast<size_t>(eStatsStage::STATS_STAGE_COUNT)> stages;
+    LatencyStatsSnapshot stLatency;
+
+    const StageStatsSnapshot& stage(eStatsStage s) const { return stages[static_cast<size_t>(s)]; }
+};
+
+using StatsCallback = std::function<void(const std::vector<PipelineStatsSnapshot>& snapshots)>;
+
+// Buffer probes on a pipeline's depay, parser and output pads. Counters are
+// written only from each pad's streaming thread and read with relaxed atomics,
+// so the data path never takes a lock.
+class PipelineStats
+{
+public:
+    PipelineStats() = default;
+    ~PipelineStats();
+
+    PipelineStats(const PipelineStats&) = delete;
+    PipelineStats& operator=(const PipelineStats&) = delete;
+
+    // Adds a buffer probe on element's pad; returns false if the pad does not exist
+    bool attach(GstElement* element, const char* padName, eStatsStage stage);
+
+    // Render latency meter on the display sink's sink pad
+    bool attachLatency(GstElement* sink);
+
+    // Extra delay the sink adds when it syncs to the clock (the pipeline latency)
+    void setSyncLatency(GstClockTime latency) { m_latency.syncLatencyNs.store(latency, std::memory_order_relaxed); }
+
+    // Removes all probes and clears counters. Call with the pipeline stopped.
+    void detach();
+
+    // Cumulative counters plus rates over the window since the last advancing snapshot
+    PipelineStatsSnapshot snapshot(size_t pipelineId, bool bAdvanceWindow = false);
+
+private:
+    struct StageCounters
+    {
+        std::atomic<bool>     attached{false};
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> keyframes{0};
+        std::atomic<uint64_t> ptsGaps{0};
+        std::atomic<uint64_t> late{0};
+        std::atomic<int64_t>  jitterNs{0};
+        std::atomic<uint64_t> probeNs{0};
+
+        // Streaming-thread private state
+        int64_t   lastArrivalNs{-1};
+        uint64_t  lastPts{GST_CLOCK_TIME_NONE};
+        int64_t   avgPtsDeltaNs{0};
+        int64_t   minLagNs{INT64_MAX};
+        uint32_t  sampleTick{0};
+
+        // Window baseline, guarded by m_windowMutex
+        uint64_t  windowFrames{0};
+        uint64_t  windowBytes{0};
+
+        void reset();
+    };
+
+    struct LatencyCounters
+    {
+        std::atomic<bool>     attached{false};
+        std::atomic<uint64_t> samples{0};
+        std::atomic<int64_t>  lastNs{0};
+        std::atomic<int64_t>  avgNs{0};
+        std::atomic<int64_t>  maxNs{0};
+        std::atomic<uint64_t> captureSamples{0};
+        std::atomic<int64_t>  captureAvgNs{0};
+        std::atomic<int64_t>  captureMaxNs{0};
+        std::atomic<uint64_t> syncLatencyNs{0};
+
+        // Streaming-thread private state
+        GstSegment segment;
+        bool       bSegment{false};
+        GstCaps*   ntpCaps{nullptr};
+        GstElement* sink{nullptr};
+
+        void reset();
+    };
+
+    struct Probe
+    {
+        GstPad* pad;
+        gulong  id;
+    };
+
+    static GstPadProbeReturn onBuffer(GstPad* pad, GstPadProbeInfo* info, gpointer data);
+    static GstPadProbeReturn onRender(GstPad* pad, GstPadProbeInfo* info, gpointer data);
+    static int64_t monotonicNs();
+
+    std::array<StageCounters, static_cast<size_t>(eStatsStage::STATS_STAGE_COUNT)> m_stages;
+    LatencyCounters m_latency;
+    std::vector<Probe> m_probes;
+
+    std::mutex m_windowMutex;
+    std::chrono::steady_clock::time_point m_windowStart{std::chrono::steady_clock::now()};
+    uint64_t m_windowProbeNs{0};
+};
+
+#endif // PIPELINE_STATS_H
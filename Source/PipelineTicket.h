@@ -0,0 +1,248 @@
+#ifndef PIPELINE_TICKET_H
+#define PIPELINE_TICKET_H
+
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <vector>
+#include <optional>
+#include <functional>
+#include <chrono>
+#include <string>
+#include "Enum.h"
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+// Final outcome of a request submitted through PipelineProcess::enqueueRequest
+struct PipelineResult
+{
+    PipelineStatus status{PipelineStatus::InProgress};
+    size_t pipelineId{0};
+    size_t requestId{0};
+    std::string message;
+};
+
+// Handle returned on request submission. Copies share the same completion state,
+// so a ticket can be polled, blocked on, chained with onComplete() or co_awaited.
+// Completion and continuations run on the PipelineProcess callback thread.
+class PipelineTicket
+{
+public:
+    using Continuation = std::function<void(const PipelineResult&)>;
+
+    class State
+    {
+    private:
+        mutable std::mutex              m_mutex;
+        std::condition_variable         m_cv;
+        bool                            m_ready{false};
+        PipelineResult                  m_result;
+        std::vector<Continuation>       m_continuations;
+
+    public:
+        explicit State(size_t requestId)
+        {
+            m_result.requestId = requestId;
+        }
+
+        size_t requestId() const
+        {
+            return m_result.requestId;
+        }
+
+        // Returns false if the state was already completed
+        bool complete(const PipelineResult& result)
+        {
+            std::vector<Continuation> continuations;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_ready)
+                {
+                    return false;
+                }
+                m_result = result;
+                m_ready = true;
+                continuations.swap(m_continuations);
+            }
+            m_cv.notify_all();
+
+            // Run continuations outside the lock so they may touch the ticket again
+            for (auto& continuation : continuations)
+            {
+                continuation(result);
+            }
+            return true;
+        }
+
+        bool ready() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_ready;
+        }
+
+        std::optional<PipelineResult> tryGet() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_ready)
+            {
+                return std::nullopt;
+            }
+            return m_result;
+        }
+
+        PipelineResult wait()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] { return m_ready; });
+            return m_result;
+        }
+
+        bool waitUntil(std::chrono::steady_clock::time_point deadline)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            return m_cv.wait_until(lock, deadline, [this] { return m_ready; });
+        }
+
+        // Registers a continuation, or runs it inline if the result is already known
+        void addContinuation(Continuation continuation)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (!m_ready)
+            {
+                m_continuations.push_back(std::move(continuation));
+                return;
+            }
+            PipelineResult result = m_result;
+            lock.unlock();
+            continuation(result);
+        }
+
+        // Registers a continuation only if the result is still pending
+        bool tryAddContinuation(Continuation continuation)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_ready)
+            {
+                return false;
+            }
+            m_continuations.push_back(std::move(continuation));
+            return true;
+        }
+    };
+
+    PipelineTicket() = default;
+    explicit PipelineTicket(std::shared_ptr<State> state) : m_state(std::move(state)) {}
+
+    // Ticket already holding its result (e.g. the request was rejected before queuing)
+    static PipelineTicket completed(const PipelineResult& result)
+    {
+        auto state = std::make_shared<State>(result.requestId);
+        state->complete(result);
+        return PipelineTicket(state);
+    }
+
+    bool   valid()     const { return m_state != nullptr; }
+    size_t requestId() const { return m_state ? m_state->requestId() : 0; }
+
+    // Poll handle
+    bool ready() const { return m_state && m_state->ready(); }
+    std::optional<PipelineResult> tryGet() const
+    {
+        return m_state ? m_state->tryGet() : std::nullopt;
+    }
+
+    // Blocking completion
+    PipelineResult get() const
+    {
+        if (!m_state)
+        {
+            PipelineResult invalid;
+            invalid.status = PipelineStatus::Error;
+            invalid.message = "Invalid pipeline ticket";
+            return invalid;
+        }
+        return m_state->wait();
+    }
+
+    void wait() const
+    {
+        if (m_state)
+        {
+            m_state->wait();
+        }
+    }
+
+    template <typename Rep, typename Period>
+    bool waitFor(const std::chrono::duration<Rep, Period>& timeout) const
+    {
+        return m_state && m_state->waitUntil(std::chrono::steady_clock::now() + timeout);
+    }
+
+    // Continuation invoked exactly once with the final result
+    void onComplete(Continuation continuation) const
+    {
+        if (m_state)
+        {
+            m_state->addContinuation(std::move(continuation));
+        }
+    }
+
+    // Joins on a batch of tickets against a single deadline. Returns true if all completed.
+    template <typename Rep, typename Period>
+    static bool waitAll(const std::vector<PipelineTicket>& tickets, const std::chrono::duration<Rep, Period>& timeout)
+    {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        for (const auto& ticket : tickets)
+        {
+            if (ticket.m_state && !ticket.m_state->waitUntil(deadline))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void waitAll(const std::vector<PipelineTicket>& tickets)
+    {
+        for (const auto& ticket : tickets)
+        {
+            ticket.wait();
+        }
+    }
+
+#if defined(__cpp_impl_coroutine)
+    // C++20: `PipelineResult result = co_await ticket;`
+    // The awaiting coroutine is resumed on the PipelineProcess callback thread.
+    struct Awaiter
+    {
+        std::shared_ptr<State> state;
+
+        bool await_ready() const noexcept
+        {
+            return !state || state->ready();
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            return state->tryAddContinuation([handle](const PipelineResult&) { handle.resume(); });
+        }
+
+        PipelineResult await_resume() const
+        {
+            return PipelineTicket(state).get();
+        }
+    };
+
+    Awaiter operator co_await() const noexcept
+    {
+        return Awaiter{m_state};
+    }
+#endif
+
+private:
+    std::shared_ptr<State> m_state;
+};
+
+#endif // PIPELINE_TICKET_H
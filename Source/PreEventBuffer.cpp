@@ -0,0 +1,459 @@
+#include "PreEventBuffer.h"
+#include "mx_logger.h"
+#include <gst/app/gstappsrc.h>
+#include <algorithm>
+#include <ctime>
+#include <filesystem>
+
+#define RECORDING_CLOSE_TIMEOUT_MS  10000   // after EOS, for the muxer to write its index
+#define RECORDING_BUS_POLL_MS       200
+
+PreEventBuffer::~PreEventBuffer()
+{
+    detach();
+}
+
+void PreEventBuffer::setConfig(const PreEventConfig& config)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_config = config;
+        if (!config.bEnabled)
+        {
+            finishRecordingLocked();
+            clearLocked();
+        }
+        trimLocked();
+    }
+    reapRecordings(false);
+}
+
+PreEventConfig PreEventBuffer::getConfig() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_config;
+}
+
+void PreEventBuffer::setFinishedCallback(std::function<void(const SegmentInfo&)> callback)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_finishedCallback = std::move(callback);
+}
+
+///////////////////////////////////////////////    Probe   //////////////////////////////////////////
+
+bool PreEventBuffer::attach(GstElement* parser)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_pad || !parser)
+    {
+        return m_pad != nullptr;
+    }
+
+    m_pad = gst_element_get_static_pad(parser, "src");
+    if (!m_pad)
+    {
+        return false;
+    }
+    m_probeId = gst_pad_add_probe(m_pad, GST_PAD_PROBE_TYPE_BUFFER, &PreEventBuffer::onBuffer, this, nullptr);
+    return true;
+}
+
+void PreEventBuffer::detach()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_pad)
+        {
+            gst_pad_remove_probe(m_pad, m_probeId);
+            gst_object_unref(m_pad);
+            m_pad = nullptr;
+            m_probeId = 0;
+        }
+
+        // Timestamps restart with the next pipeline, so the history cannot be spliced on
+        finishRecordingLocked();
+        clearLocked();
+    }
+    reapRecordings(true);
+}
+
+bool PreEventBuffer::isAttached() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pad != nullptr;
+}
+
+GstPadProbeReturn PreEventBuffer::onBuffer(GstPad* pad, GstPadProbeInfo* info, gpointer data)
+{
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (buffer)
+    {
+        static_cast<PreEventBuffer*>(data)->push(pad, buffer);
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+GstClockTime PreEventBuffer::timestampOf(GstBuffer* buffer)
+{
+    return GST_BUFFER_DTS_IS_VALID(buffer) ? GST_BUFFER_DTS(buffer) : GST_BUFFER_PTS(buffer);
+}
+
+void PreEventBuffer::push(GstPad* pad, GstBuffer* buffer)
+{
+    const bool bKeyframe = !GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+    const GstClockTime ts = timestampOf(buffer);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_config.bEnabled)
+    {
+        return;
+    }
+
+    if (bKeyframe)
+    {
+        // Caps can change at a keyframe (new SPS); keep the ones the recording will need
+        GstCaps* caps = gst_pad_get_current_caps(pad);
+        if (caps)
+        {
+            gst_caps_replace(&m_caps, caps);
+            gst_caps_unref(caps);
+        }
+        Gop gop;
+        gop.start = ts;
+        m_gops.push_back(std::move(gop));
+    }
+    else if (m_gops.empty())
+    {
+        return;     // nothing decodable before the first keyframe
+    }
+
+    Gop& gop = m_gops.back();
+    gop.buffers.push_back(gst_buffer_ref(buffer));
+    const size_t size = gst_buffer_get_size(buffer);
+    gop.bytes += size;
+    m_iBytes += size;
+    if (GST_CLOCK_TIME_IS_VALID(ts))
+    {
+        m_newest = ts;
+    }
+
+    if (m_recording)
+    {
+        if (GST_CLOCK_TIME_IS_VALID(ts) && ts > m_recording->end)
+        {
+            finishRecordingLocked();
+        }
+        else
+        {
+            pushToRecordingLocked(buffer);
+        }
+    }
+
+    trimLocked();
+}
+
+void PreEventBuffer::trimLocked()
+{
+    // Drop the oldest GOP while the next one alone still covers the window
+    const GstClockTime window = static_cast<GstClockTime>(std::max(0, m_config.iPreEventSeconds)) * GST_SECOND;
+    while (m_gops.size() > 1)
+    {
+        const Gop& next = m_gops[1];
+        const bool bTooOld = GST_CLOCK_TIME_IS_VALID(next.start) && GST_CLOCK_TIME_IS_VALID(m_newest) &&
+                             m_newest >= next.start && m_newest - next.start >= window;
+        const bool bTooBig = m_iBytes > m_config.iMaxBytes;
+        if (!bTooOld && !bTooBig)
+        {
+            break;
+        }
+
+        Gop& oldest = m_gops.front();
+        for (GstBuffer* buffer : oldest.buffers)
+        {
+            gst_buffer_unref(buffer);
+        }
+        m_iBytes -= oldest.bytes;
+        m_gops.pop_front();
+        ++m_iEvictedGops;
+    }
+}
+
+void PreEventBuffer::clearLocked()
+{
+    for (Gop& gop : m_gops)
+    {
+        for (GstBuffer* buffer : gop.buffers)
+        {
+            gst_buffer_unref(buffer);
+        }
+    }
+    m_gops.clear();
+    m_iBytes = 0;
+    m_newest = GST_CLOCK_TIME_NONE;
+    if (m_caps)
+    {
+        gst_caps_unref(m_caps);
+        m_caps = nullptr;
+    }
+}
+
+///////////////////////////////////////////////    Recording   //////////////////////////////////////////
+
+bool PreEventBuffer::trigger(size_t pipelineId, const EventRecordingRequest& request, std::string& location, std::string& error)
+{
+    reapRecordings(false);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const GstClockTime post = static_cast<GstClockTime>(std::max(0, request.iPostEventSeconds)) * GST_SECOND;
+
+    // A second alarm while recording just moves the end out
+    if (m_recording)
+    {
+        if (GST_CLOCK_TIME_IS_VALID(m_newest))
+        {
+            m_recording->end = std::max(m_recording->end, m_newest + post);
+        }
+        location = m_recording->location;
+        return true;
+    }
+
+    if (!m_pad || m_gops.empty() || !m_caps)
+    {
+        error = "no buffered keyframe yet";
+        return false;
+    }
+
+    location = request.sLocation;
+    if (location.empty())
+    {
+        char timeText[32] = {0};
+        const time_t now = time(nullptr);
+        tm local{};
+        localtime_r(&now, &local);
+        strftime(timeText, sizeof(timeText), "%Y%m%d-%H%M%S", &local);
+        location = "event_" + std::to_string(pipelineId) + "_" + timeText +
+                   (request.eContainer == eContainerFormat::CONTAINER_FORMAT_MKV ? ".mkv" : ".mp4");
+    }
+
+    std::unique_ptr<Recording> recording = createRecording(request, location, error);
+    if (!recording)
+    {
+        return false;
+    }
+    recording->base = m_gops.front().start;
+    recording->end = GST_CLOCK_TIME_IS_VALID(m_newest) ? m_newest + post : GST_CLOCK_TIME_NONE;
+    m_recording = std::move(recording);
+    ++m_iRecordings;
+
+    // History first, under the same lock the probe takes, so live buffers follow in order
+    for (const Gop& gop : m_gops)
+    {
+        for (GstBuffer* buffer : gop.buffers)
+        {
+            pushToRecordingLocked(buffer);
+        }
+    }
+
+    MX_LOG_INFO("PreEventBuffer", ("event recording started: " + location + ", " + std::to_string(m_gops.size()) +
+                " GOPs of history").c_str());
+    return true;
+}
+
+std::unique_ptr<PreEventBuffer::Recording> PreEventBuffer::createRecording(const EventRecordingRequest& request,
+                                                                          const std::string& location, std::string& error)
+{
+    const std::string codec = gst_structure_get_name(gst_caps_get_structure(m_caps, 0));
+    const char* parserName = codec == "video/x-h264" ? "h264parse" : (codec == "video/x-h265" ? "h265parse" : nullptr);
+    if (!parserName)
+    {
+        error = "no event recording support for " + codec;
+        return nullptr;
+    }
+    const char* muxerName = request.eContainer == eContainerFormat::CONTAINER_FORMAT_MKV ? "matroskamux" : "mp4mux";
+
+    std::error_code ec;
+    const std::filesystem::path parent = std::filesystem::path(location).parent_path();
+    if (!parent.empty())
+    {
+        std::filesystem::create_directories(parent, ec);
+    }
+
+    auto recording = std::make_unique<Recording>();
+    recording->location = location;
+    recording->pipeline = gst_pipeline_new("event-recording");
+    recording->appsrc = gst_element_factory_make("appsrc", "src");
+    GstElement* parser = gst_element_factory_make(parserName, "parser");
+    GstElement* mux = gst_element_factory_make(muxerName, "muxer");
+    GstElement* sink = gst_element_factory_make("filesink", "sink");
+    if (!recording->pipeline || !recording->appsrc || !parser || !mux || !sink)
+    {
+        for (GstElement* element : {recording->appsrc, parser, mux, sink})
+        {
+            if (element)
+            {
+                gst_object_unref(gst_object_ref_sink(element));
+            }
+        }
+        if (recording->pipeline)
+        {
+            gst_object_unref(recording->pipeline);
+        }
+        error = "failed to create event recording elements";
+        return nullptr;
+    }
+
+    // Never blocks the live pipeline's streaming thread; the cap is just a backstop
+    g_object_set(recording->appsrc, "caps", m_caps, "format", GST_FORMAT_TIME, "is-live", FALSE, "block", FALSE,
+                 "max-bytes", static_cast<guint64>(2 * m_config.iMaxBytes), nullptr);
+    g_object_set(sink, "location", location.c_str(), nullptr);
+
+    gst_bin_add_many(GST_BIN(recording->pipeline), recording->appsrc, parser, mux, sink, nullptr);
+    if (!gst_element_link_many(recording->appsrc, parser, mux, sink, nullptr) ||
+        gst_element_set_state(recording->pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+    {
+        gst_element_set_state(recording->pipeline, GST_STATE_NULL);
+        gst_object_unref(recording->pipeline);
+        error = "failed to start event recording to " + location;
+        return nullptr;
+    }
+
+    recording->watcher = std::thread(&PreEventBuffer::watchRecording, this, recording.get());
+    return recording;
+}
+
+void PreEventBuffer::pushToRecordingLocked(GstBuffer* buffer)
+{
+    // Shallow copy: new metadata for the rebased timestamps, the payload memory is shared
+    GstBuffer* copy = gst_buffer_copy(buffer);
+    const GstClockTime base = m_recording->base;
+    if (GST_BUFFER_PTS_IS_VALID(copy))
+    {
+        GST_BUFFER_PTS(copy) = GST_BUFFER_PTS(copy) > base ? GST_BUFFER_PTS(copy) - base : 0;
+        m_recording->last = std::max(m_recording->last, GST_BUFFER_PTS(copy));
+    }
+    if (GST_BUFFER_DTS_IS_VALID(copy))
+    {
+        GST_BUFFER_DTS(copy) = GST_BUFFER_DTS(copy) > base ? GST_BUFFER_DTS(copy) - base : 0;
+    }
+    gst_app_src_push_buffer(GST_APP_SRC(m_recording->appsrc), copy);
+}
+
+void PreEventBuffer::finishRecordingLocked()
+{
+    if (!m_recording)
+    {
+        return;
+    }
+
+    m_recording->eosSentAt = std::chrono::steady_clock::now();
+    m_recording->bEosSent = true;
+    gst_app_src_end_of_stream(GST_APP_SRC(m_recording->appsrc));
+    m_finishing.push_back(std::move(m_recording));
+}
+
+void PreEventBuffer::watchRecording(Recording* recording)
+{
+    GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(recording->pipeline));
+    bool bError = false;
+
+    while (true)
+    {
+        GstMessage* msg = gst_bus_timed_pop_filtered(bus, RECORDING_BUS_POLL_MS * GST_MSECOND,
+                                                     static_cast<GstMessageType>(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+        if (msg)
+        {
+            bError = GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR;
+            gst_message_unref(msg);
+            break;
+        }
+        if (recording->bEosSent &&
+            std::chrono::steady_clock::now() - recording->eosSentAt > std::chrono::milliseconds(RECORDING_CLOSE_TIMEOUT_MS))
+        {
+            bError = true;
+            break;
+        }
+    }
+    gst_object_unref(bus);
+
+    gst_element_set_state(recording->pipeline, GST_STATE_NULL);
+    gst_object_unref(recording->pipeline);
+    recording->pipeline = nullptr;
+
+    if (bError)
+    {
+        MX_LOG_ERROR("PreEventBuffer", ("event recording failed or did not close: " + recording->location).c_str());
+    }
+    else
+    {
+        SegmentInfo segment;
+        segment.sLocation = recording->location;
+        segment.iDurationNs = recording->last;
+        std::error_code ec;
+        const auto bytes = std::filesystem::file_size(segment.sLocation, ec);
+        segment.iBytes = ec ? 0 : bytes;
+
+        std::function<void(const SegmentInfo&)> callback;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            segment.iIndex = static_cast<unsigned>(m_iRecordings);
+            callback = m_finishedCallback;
+        }
+
+        MX_LOG_INFO("PreEventBuffer", ("event recording closed: " + segment.sLocation).c_str());
+        if (callback)
+        {
+            callback(segment);
+        }
+    }
+    recording->bDone = true;
+}
+
+void PreEventBuffer::reapRecordings(bool bWait)
+{
+    std::vector<std::unique_ptr<Recording>> done;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto it = m_finishing.begin(); it != m_finishing.end();)
+        {
+            if (bWait || (*it)->bDone)
+            {
+                done.push_back(std::move(*it));
+                it = m_finishing.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    // The watchers take m_mutex on their way out, so join outside it
+    for (auto& recording : done)
+    {
+        if (recording->watcher.joinable())
+        {
+            recording->watcher.join();
+        }
+    }
+}
+
+PreEventSnapshot PreEventBuffer::snapshot()
+{
+    reapRecordings(false);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    PreEventSnapshot snapshot;
+    snapshot.bAttached    = m_pad != nullptr;
+    snapshot.iGops        = m_gops.size();
+    snapshot.iBytes       = m_iBytes;
+    snapshot.iEvictedGops = m_iEvictedGops;
+    snapshot.bRecording   = m_recording != nullptr;
+    snapshot.iRecordings  = m_iRecordings;
+    if (!m_gops.empty() && GST_CLOCK_TIME_IS_VALID(m_gops.front().start) && GST_CLOCK_TIME_IS_VALID(m_newest) &&
+        m_newest >= m_gops.front().start)
+    {
+        snapshot.fBufferedSeconds = static_cast<double>(m_newest - m_gops.front().start) / GST_SECOND;
+    }
+    return snapshot;
+}
@@ -0,0 +1,122 @@
+#ifndef PRE_EVENT_BUFFER_H
+#define PRE_EVENT_BUFFER_H
+
+#include <gst/gst.h>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Struct.h"
+
+struct PreEventConfig
+{
+    bool   bEnabled{false};
+    int    iPreEventSeconds{30};            // history kept, rounded up to whole GOPs
+    size_t iMaxBytes{64 * 1024 * 1024};     // cap per pipeline; oldest GOPs go first
+};
+
+struct EventRecordingRequest
+{
+    std::string      sLocation;             // output file; "" = event_<pipeline>_<time>.<ext>
+    int              iPostEventSeconds{30}; // live continuation after the trigger
+    eContainerFormat eContainer{eContainerFormat::CONTAINER_FORMAT_MP4};
+};
+
+struct PreEventSnapshot
+{
+    bool     bAttached{false};
+    size_t   iGops{0};
+    size_t   iBytes{0};
+    double   fBufferedSeconds{0.0};
+    uint64_t iEvictedGops{0};
+    bool     bRecording{false};
+    uint64_t iRecordings{0};
+};
+
+// Compressed-domain ring buffer on the parser output. Holds whole GOPs, as
+// references to the pipeline's buffers, for the last iPreEventSeconds. A trigger
+// remuxes the buffered GOPs and the live continuation into a file: no decode,
+// no re-encode, and payloads are only copied by the output parser when it has
+// to repacketise (byte-stream to avc for MP4).
+class PreEventBuffer
+{
+public:
+    PreEventBuffer() = default;
+    ~PreEventBuffer();
+
+    PreEventBuffer(const PreEventBuffer&) = delete;
+    PreEventBuffer& operator=(const PreEventBuffer&) = delete;
+
+    void setConfig(const PreEventConfig& config);
+    PreEventConfig getConfig() const;
+
+    // Buffer probe on parser's src pad. detach() ends a running recording and drops the history.
+    bool attach(GstElement* parser);
+    void detach();
+    bool isAttached() const;
+
+    // Starts a recording from the oldest buffered keyframe, or extends the running one.
+    // location is the file written (or being written).
+    bool trigger(size_t pipelineId, const EventRecordingRequest& request, std::string& location, std::string& error);
+
+    // Called when a recording file is closed, from the recording's own thread
+    void setFinishedCallback(std::function<void(const SegmentInfo&)> callback);
+
+    PreEventSnapshot snapshot();
+
+private:
+    struct Gop
+    {
+        GstClockTime            start{GST_CLOCK_TIME_NONE};
+        std::vector<GstBuffer*> buffers;
+        size_t                  bytes{0};
+    };
+
+    // appsrc ! parser ! muxer ! filesink, fed from the ring then from the probe
+    struct Recording
+    {
+        GstElement*       pipeline{nullptr};
+        GstElement*       appsrc{nullptr};
+        std::string       location;
+        GstClockTime      base{GST_CLOCK_TIME_NONE};  // timestamps are rebased to start at 0
+        GstClockTime      end{GST_CLOCK_TIME_NONE};   // live buffers past this end the recording
+        GstClockTime      last{0};
+        std::thread       watcher;
+        std::atomic<bool> bEosSent{false};
+        std::atomic<bool> bDone{false};
+        std::chrono::steady_clock::time_point eosSentAt{};
+    };
+
+    static GstPadProbeReturn onBuffer(GstPad* pad, GstPadProbeInfo* info, gpointer data);
+    void push(GstPad* pad, GstBuffer* buffer);
+    void trimLocked();
+    void clearLocked();
+    void pushToRecordingLocked(GstBuffer* buffer);
+    void finishRecordingLocked();
+    void reapRecordings(bool bWait);
+    std::unique_ptr<Recording> createRecording(const EventRecordingRequest& request, const std::string& location, std::string& error);
+    void watchRecording(Recording* recording);
+    static GstClockTime timestampOf(GstBuffer* buffer);
+
+    mutable std::mutex  m_mutex;
+    PreEventConfig      m_config;
+    std::deque<Gop>     m_gops;
+    size_t              m_iBytes{0};
+    GstClockTime        m_newest{GST_CLOCK_TIME_NONE};
+    GstCaps*            m_caps{nullptr};
+    GstPad*             m_pad{nullptr};
+    gulong              m_probeId{0};
+    uint64_t            m_iEvictedGops{0};
+    uint64_t            m_iRecordings{0};
+
+    std::unique_ptr<Recording>              m_recording;    // fed by the probe
+    std::vector<std::unique_ptr<Recording>> m_finishing;    // EOS sent, waiting for the file to close
+    std::function<void(const SegmentInfo&)> m_finishedCallback;
+};
+
+#endif // PRE_EVENT_BUFFER_H
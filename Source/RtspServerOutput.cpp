@@ -0,0 +1,358 @@
+#include "RtspServerOutput.h"
+#include "mx_logger.h"
+#include <gst/app/gstappsrc.h>
+
+RtspServerOutput& RtspServerOutput::instance()
+{
+    static RtspServerOutput server;
+    return server;
+}
+
+RtspServerOutput::~RtspServerOutput()
+{
+    stop();
+}
+
+void RtspServerOutput::setConfig(const RtspServerConfig& config)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_config = config;
+}
+
+RtspServerConfig RtspServerOutput::getConfig() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_config;
+}
+
+///////////////////////////////////////////////    Server   //////////////////////////////////////////
+
+bool RtspServerOutput::startLocked()
+{
+    if (m_server)
+    {
+        return true;
+    }
+
+    // Own main context and thread: nothing else in the process runs a GLib main loop
+    m_context = g_main_context_new();
+    m_loop = g_main_loop_new(m_context, FALSE);
+    m_server = gst_rtsp_server_new();
+    gst_rtsp_server_set_address(m_server, m_config.sAddress.c_str());
+    gst_rtsp_server_set_service(m_server, std::to_string(m_config.iPort).c_str());
+    g_signal_connect(m_server, "client-connected", G_CALLBACK(&RtspServerOutput::onClientConnected), this);
+
+    m_sourceId = gst_rtsp_server_attach(m_server, m_context);
+    if (m_sourceId == 0)
+    {
+        MX_LOG_ERROR("RtspServerOutput", ("cannot listen on " + m_config.sAddress + ":" + std::to_string(m_config.iPort)).c_str());
+        g_object_unref(m_server);
+        g_main_loop_unref(m_loop);
+        g_main_context_unref(m_context);
+        m_server = nullptr;
+        m_loop = nullptr;
+        m_context = nullptr;
+        return false;
+    }
+
+    GMainLoop* loop = m_loop;
+    GMainContext* context = m_context;
+    m_thread = std::thread([loop, context]()
+    {
+        g_main_context_push_thread_default(context);
+        g_main_loop_run(loop);
+        g_main_context_pop_thread_default(context);
+    });
+
+    MX_LOG_INFO("RtspServerOutput", ("RTSP server listening on " + m_config.sAddress + ":" + std::to_string(m_config.iPort)).c_str());
+    return true;
+}
+
+void RtspServerOutput::stop()
+{
+    std::vector<std::shared_ptr<Feeder>> feeders;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_server)
+        {
+            return;
+        }
+
+        GstRTSPMountPoints* mountPoints = gst_rtsp_server_get_mount_points(m_server);
+        for (auto& [path, mount] : m_mounts)
+        {
+            gst_rtsp_mount_points_remove_factory(mountPoints, path.c_str());
+            g_object_unref(mount.factory);
+            if (mount.feeder)
+            {
+                feeders.push_back(mount.feeder);
+            }
+        }
+        g_object_unref(mountPoints);
+        m_mounts.clear();
+    }
+
+    for (auto& feeder : feeders)
+    {
+        feeder->tap->close();
+        gst_object_unref(feeder->appsrc);
+        feeder->appsrc = nullptr;
+    }
+
+    g_main_loop_quit(m_loop);
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    GSource* source = g_main_context_find_source_by_id(m_context, m_sourceId);
+    if (source)
+    {
+        g_source_destroy(source);
+    }
+    g_object_unref(m_server);
+    g_main_loop_unref(m_loop);
+    g_main_context_unref(m_context);
+    m_server = nullptr;
+    m_loop = nullptr;
+    m_context = nullptr;
+    m_sourceId = 0;
+}
+
+///////////////////////////////////////////////    Mounts   //////////////////////////////////////////
+
+bool RtspServerOutput::addMount(const std::string& path, size_t pipelineId, eVideoCodec codec, MountSubscriber subscriber)
+{
+    const char* payloader = codec == eVideoCodec::VIDEO_CODEC_H264 ? "rtph264pay" :
+                            (codec == eVideoCodec::VIDEO_CODEC_H265 ? "rtph265pay" : nullptr);
+    if (!payloader)
+    {
+        MX_LOG_WARN("RtspServerOutput", ("codec of pipeline " + std::to_string(pipelineId) + " cannot be served").c_str());
+        return false;
+    }
+
+    removeMount(path);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!startLocked())
+    {
+        return false;
+    }
+
+    // config-interval=-1 repeats SPS/PPS at every IDR, so clients joining the shared media can start
+    const std::string launch = "( appsrc name=src is-live=true format=time ! " + std::string(payloader) +
+                               " name=pay0 pt=" + std::to_string(m_config.iPayloadType) + " config-interval=-1 )";
+
+    GstRTSPMediaFactory* factory = gst_rtsp_media_factory_new();
+    gst_rtsp_media_factory_set_launch(factory, launch.c_str());
+    gst_rtsp_media_factory_set_shared(factory, TRUE);
+    g_signal_connect_data(factory, "media-configure", G_CALLBACK(&RtspServerOutput::onMediaConfigure),
+                          g_strdup(path.c_str()), (GClosureNotify)g_free, (GConnectFlags)0);
+
+    GstRTSPMountPoints* mountPoints = gst_rtsp_server_get_mount_points(m_server);
+    gst_rtsp_mount_points_add_factory(mountPoints, path.c_str(), GST_RTSP_MEDIA_FACTORY(g_object_ref(factory)));
+    g_object_unref(mountPoints);
+
+    Mount& mount = m_mounts[path];
+    mount.pipelineId = pipelineId;
+    mount.subscriber = std::move(subscriber);
+    mount.factory = factory;
+
+    MX_LOG_INFO("RtspServerOutput", ("pipeline " + std::to_string(pipelineId) + " served at rtsp://" + m_config.sAddress + ":" +
+                std::to_string(m_config.iPort) + path).c_str());
+    return true;
+}
+
+void RtspServerOutput::removeMount(const std::string& path)
+{
+    std::shared_ptr<Feeder> feeder;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_mounts.find(path);
+        if (it == m_mounts.end())
+        {
+            return;
+        }
+
+        GstRTSPMountPoints* mountPoints = gst_rtsp_server_get_mount_points(m_server);
+        gst_rtsp_mount_points_remove_factory(mountPoints, path.c_str());
+        g_object_unref(mountPoints);
+        g_object_unref(it->second.factory);
+        feeder = it->second.feeder;
+        m_mounts.erase(it);
+    }
+
+    // Connected clients starve and time out; the subscriber must not be called after this returns
+    if (feeder)
+    {
+        feeder->tap->close();
+        gst_object_unref(feeder->appsrc);
+        feeder->appsrc = nullptr;
+    }
+}
+
+void RtspServerOutput::onMediaConfigure(GstRTSPMediaFactory* factory, GstRTSPMedia* media, gpointer data)
+{
+    RtspServerOutput& server = instance();
+    const std::string path = static_cast<const gchar*>(data);
+
+    auto feeder = std::make_shared<Feeder>();
+    feeder->media = media;
+    GstElement* element = gst_rtsp_media_get_element(media);
+    feeder->appsrc = gst_bin_get_by_name(GST_BIN(element), "src");
+    gst_object_unref(element);
+    if (!feeder->appsrc)
+    {
+        return;
+    }
+
+    // Subscribing under the server lock keeps it ordered with removeMount
+    std::shared_ptr<Feeder> previous;
+    {
+        std::lock_guard<std::mutex> lock(server.m_mutex);
+        auto it = server.m_mounts.find(path);
+        if (it == server.m_mounts.end())
+        {
+            gst_object_unref(feeder->appsrc);
+            return;
+        }
+
+        // The feeder outlives its tap: the tap is closed, joining its thread, before the feeder goes
+        Feeder* raw = feeder.get();
+        feeder->tap = it->second.subscriber([raw](GstSample* sample) { instance().feed(raw, sample); });
+        if (!feeder->tap)
+        {
+            gst_object_unref(feeder->appsrc);
+            return;
+        }
+        previous.swap(it->second.feeder);
+        it->second.feeder = feeder;
+    }
+
+    // A media configured before the old one was unprepared: the old tap would keep feeding a dead appsrc
+    if (previous)
+    {
+        previous->tap->close();
+        gst_object_unref(previous->appsrc);
+        previous->appsrc = nullptr;
+    }
+
+    g_signal_connect_data(media, "unprepared", G_CALLBACK(&RtspServerOutput::onMediaUnprepared),
+                          g_strdup(path.c_str()), (GClosureNotify)g_free, (GConnectFlags)0);
+    MX_LOG_INFO("RtspServerOutput", ("media prepared for " + path).c_str());
+}
+
+void RtspServerOutput::onMediaUnprepared(GstRTSPMedia* media, gpointer data)
+{
+    RtspServerOutput& server = instance();
+    const std::string path = static_cast<const gchar*>(data);
+
+    std::shared_ptr<Feeder> feeder;
+    {
+        std::lock_guard<std::mutex> lock(server.m_mutex);
+        auto it = server.m_mounts.find(path);
+        if (it != server.m_mounts.end() && it->second.feeder && it->second.feeder->media == media)
+        {
+            feeder.swap(it->second.feeder);
+        }
+    }
+
+    // Last client left: stop feeding until the next one prepares a new media
+    if (feeder)
+    {
+        feeder->tap->close();
+        gst_object_unref(feeder->appsrc);
+        feeder->appsrc = nullptr;
+    }
+    MX_LOG_INFO("RtspServerOutput", ("media unprepared for " + path).c_str());
+}
+
+void RtspServerOutput::feed(Feeder* feeder, GstSample* sample)
+{
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    if (!buffer)
+    {
+        return;
+    }
+
+    // Nothing can be timestamped until the media is running
+    GstClock* clock = gst_element_get_clock(feeder->appsrc);
+    if (!clock)
+    {
+        return;
+    }
+    const GstClockTime now = gst_clock_get_time(clock) - gst_element_get_base_time(feeder->appsrc);
+    gst_object_unref(clock);
+
+    // Clients decode from the first buffer they get
+    if (!feeder->bKeyframeSeen)
+    {
+        if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT))
+        {
+            return;
+        }
+        feeder->bKeyframeSeen = true;
+        const GstClockTime ts = GST_BUFFER_DTS_IS_VALID(buffer) ? GST_BUFFER_DTS(buffer) : GST_BUFFER_PTS(buffer);
+        feeder->offset = GST_CLOCK_TIME_IS_VALID(ts) ? GST_CLOCK_DIFF(ts, now) : 0;
+    }
+
+    if (!feeder->bCapsSet)
+    {
+        GstCaps* caps = gst_sample_get_caps(sample);
+        if (caps)
+        {
+            g_object_set(feeder->appsrc, "caps", caps, nullptr);
+        }
+        feeder->bCapsSet = true;
+    }
+
+    // Shallow copy with the ingest timestamps moved onto the media's running time
+    GstBuffer* copy = gst_buffer_copy(buffer);
+    if (GST_BUFFER_PTS_IS_VALID(copy))
+    {
+        const GstClockTimeDiff pts = static_cast<GstClockTimeDiff>(GST_BUFFER_PTS(copy)) + feeder->offset;
+        GST_BUFFER_PTS(copy) = pts > 0 ? static_cast<GstClockTime>(pts) : 0;
+    }
+    if (GST_BUFFER_DTS_IS_VALID(copy))
+    {
+        const GstClockTimeDiff dts = static_cast<GstClockTimeDiff>(GST_BUFFER_DTS(copy)) + feeder->offset;
+        GST_BUFFER_DTS(copy) = dts > 0 ? static_cast<GstClockTime>(dts) : 0;
+    }
+    gst_app_src_push_buffer(GST_APP_SRC(feeder->appsrc), copy);
+    feeder->iFed.fetch_add(1, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////    Clients   //////////////////////////////////////////
+
+void RtspServerOutput::onClientConnected(GstRTSPServer* server, GstRTSPClient* client, gpointer data)
+{
+    RtspServerOutput* self = static_cast<RtspServerOutput*>(data);
+    self->m_iClients.fetch_add(1, std::memory_order_relaxed);
+    g_signal_connect(client, "closed", G_CALLBACK(&RtspServerOutput::onClientClosed), self);
+}
+
+void RtspServerOutput::onClientClosed(GstRTSPClient* client, gpointer data)
+{
+    static_cast<RtspServerOutput*>(data)->m_iClients.fetch_sub(1, std::memory_order_relaxed);
+}
+
+RtspServerSnapshot RtspServerOutput::getSnapshot()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    RtspServerSnapshot snapshot;
+    snapshot.bRunning = m_server != nullptr;
+    snapshot.iPort = m_config.iPort;
+    snapshot.iClients = m_iClients.load(std::memory_order_relaxed);
+    for (const auto& [path, mount] : m_mounts)
+    {
+        RtspMountSnapshot mountSnapshot;
+        mountSnapshot.sPath = path;
+        mountSnapshot.pipelineId = mount.pipelineId;
+        mountSnapshot.bActive = mount.feeder != nullptr;
+        mountSnapshot.iFramesFed = mount.feeder ? mount.feeder->iFed.load(std::memory_order_relaxed) : 0;
+        snapshot.vMounts.push_back(mountSnapshot);
+    }
+    return snapshot;
+}
@@ -0,0 +1,109 @@
+#ifndef RTSP_SERVER_OUTPUT_H
+#define RTSP_SERVER_OUTPUT_H
+
+#include <gst/gst.h>
+#include <gst/rtsp-server/rtsp-server.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Enum.h"
+#include "FrameTap.h"
+
+struct RtspServerConfig
+{
+    std::string sAddress{"0.0.0.0"};
+    int         iPort{8554};        // read when the server starts
+    int         iPayloadType{96};
+};
+
+struct RtspMountSnapshot
+{
+    std::string sPath;
+    size_t      pipelineId{0};
+    bool        bActive{false};     // a client is connected, the media is fed
+    uint64_t    iFramesFed{0};
+};
+
+struct RtspServerSnapshot
+{
+    bool     bRunning{false};
+    int      iPort{0};
+    size_t   iClients{0};
+    std::vector<RtspMountSnapshot> vMounts;
+};
+
+// How a mount gets the ingest pipeline's access units (the handler's encoded frame tap)
+using MountSubscriber = std::function<FrameTapPtr(FrameCallback callback)>;
+
+// Process-wide gst-rtsp-server. Every pipeline served from it gets a mount with a
+// shared media factory: the first client prepares one media (appsrc ! rtph26xpay),
+// later clients join it, and the server fans out the same RTP packets. The media is
+// fed from the pipeline's encoded frame tap, so the ingest pipeline runs once
+// whatever the number of viewers, and nothing is fed while nobody watches.
+class RtspServerOutput
+{
+public:
+    static RtspServerOutput& instance();
+
+    void setConfig(const RtspServerConfig& config);
+    RtspServerConfig getConfig() const;
+
+    // Starts the server on first use. Replaces an existing mount with the same path.
+    bool addMount(const std::string& path, size_t pipelineId, eVideoCodec codec, MountSubscriber subscriber);
+    void removeMount(const std::string& path);
+
+    RtspServerSnapshot getSnapshot();
+
+    // Drops all mounts and clients and stops the server thread
+    void stop();
+
+private:
+    RtspServerOutput() = default;
+    ~RtspServerOutput();
+
+    // Feeds one prepared media from the tap; lives until the media is unprepared
+    struct Feeder
+    {
+        GstRTSPMedia*        media{nullptr};    // identity only, not a reference
+        GstElement*          appsrc{nullptr};
+        FrameTapPtr          tap;
+        bool                 bCapsSet{false};
+        bool                 bKeyframeSeen{false};
+        GstClockTimeDiff     offset{0};         // ingest timestamps to media running time
+        std::atomic<uint64_t> iFed{0};
+    };
+
+    struct Mount
+    {
+        size_t                   pipelineId{0};
+        MountSubscriber          subscriber;
+        GstRTSPMediaFactory*     factory{nullptr};
+        std::shared_ptr<Feeder>  feeder;            // shared media: at most one at a time
+    };
+
+    bool startLocked();
+    void feed(Feeder* feeder, GstSample* sample);
+    static void onMediaConfigure(GstRTSPMediaFactory* factory, GstRTSPMedia* media, gpointer data);
+    static void onMediaUnprepared(GstRTSPMedia* media, gpointer data);
+    static void onClientConnected(GstRTSPServer* server, GstRTSPClient* client, gpointer data);
+    static void onClientClosed(GstRTSPClient* client, gpointer data);
+
+    mutable std::mutex  m_mutex;
+    RtspServerConfig    m_config;
+    std::unordered_map<std::string, Mount> m_mounts;
+
+    GMainContext*       m_context{nullptr};
+    GMainLoop*          m_loop{nullptr};
+    GstRTSPServer*      m_server{nullptr};
+    guint               m_sourceId{0};
+    std::thread         m_thread;
+    std::atomic<size_t> m_iClients{0};
+};
+
+#endif // RTSP_SERVER_OUTPUT_H
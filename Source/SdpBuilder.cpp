@@ -0,0 +1,107 @@
+#include "SdpBuilder.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+    // Payloader caps fields that describe the RTP session rather than the codec
+    const char* const kSessionFields[] = {
+        "media", "payload", "clock-rate", "encoding-name", "encoding-params",
+        "ssrc", "timestamp-offset", "seqnum-offset", "clock-base", "seqnum-base",
+        "a-framerate", "rtcp-fb-nack-pli", "rtcp-fb-ccm-fir"
+    };
+
+    bool isSessionField(const char* name)
+    {
+        for (const char* field : kSessionFields)
+        {
+            if (std::strcmp(field, name) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+bool SdpBuilder::isMulticast(const std::string& address)
+{
+    in_addr v4{};
+    if (inet_pton(AF_INET, address.c_str(), &v4) == 1)
+    {
+        return (ntohl(v4.s_addr) & 0xF0000000u) == 0xE0000000u;    // 224.0.0.0/4
+    }
+    in6_addr v6{};
+    if (inet_pton(AF_INET6, address.c_str(), &v6) == 1)
+    {
+        return v6.s6_addr[0] == 0xFF;                               // ff00::/8
+    }
+    return false;
+}
+
+std::string SdpBuilder::build(const SdpSession& session, const GstCaps* rtpCaps)
+{
+    if (!rtpCaps || gst_caps_is_empty(rtpCaps) || gst_caps_get_size(rtpCaps) == 0)
+    {
+        return "";
+    }
+    const GstStructure* s = gst_caps_get_structure(rtpCaps, 0);
+    if (!gst_structure_has_name(s, "application/x-rtp"))
+    {
+        return "";
+    }
+
+    const gchar* media = gst_structure_get_string(s, "media");
+    const gchar* encoding = gst_structure_get_string(s, "encoding-name");
+    gint payload = 96;
+    gint clockRate = 90000;
+    gst_structure_get_int(s, "payload", &payload);
+    gst_structure_get_int(s, "clock-rate", &clockRate);
+
+    const bool bIpv6 = session.sAddress.find(':') != std::string::npos;
+    const char* addrType = bIpv6 ? "IP6" : "IP4";
+    const char* originType = session.sOrigin.find(':') != std::string::npos ? "IP6" : "IP4";
+
+    // NTP-style session id; the version stays 1, the description never changes for a running stream
+    const auto sessionId = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count() + 2208988800LL;
+
+    std::ostringstream sdp;
+    sdp << "v=0\r\n";
+    sdp << "o=- " << sessionId << " 1 IN " << originType << " " << session.sOrigin << "\r\n";
+    sdp << "s=" << (session.sName.empty() ? "stream" : session.sName) << "\r\n";
+    sdp << "c=IN " << addrType << " " << session.sAddress;
+    if (!bIpv6 && isMulticast(session.sAddress))
+    {
+        sdp << "/" << session.iTtl;
+    }
+    sdp << "\r\n";
+    sdp << "t=0 0\r\n";
+    sdp << "m=" << (media ? media : "video") << " " << session.iPort << " RTP/AVP " << payload << "\r\n";
+    sdp << "a=rtpmap:" << payload << " " << (encoding ? encoding : "H264") << "/" << clockRate << "\r\n";
+
+    std::ostringstream fmtp;
+    const gint fields = gst_structure_n_fields(s);
+    for (gint i = 0; i < fields; ++i)
+    {
+        const gchar* name = gst_structure_nth_field_name(s, i);
+        if (isSessionField(name))
+        {
+            continue;
+        }
+        const gchar* value = gst_structure_get_string(s, name);
+        if (!value)
+        {
+            continue;
+        }
+        fmtp << (fmtp.tellp() > 0 ? ";" : "") << name << "=" << value;
+    }
+    if (fmtp.tellp() > 0)
+    {
+        sdp << "a=fmtp:" << payload << " " << fmtp.str() << "\r\n";
+    }
+    sdp << "a=recvonly\r\n";
+    return sdp.str();
+}
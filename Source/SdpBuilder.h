@@ -0,0 +1,30 @@
+#ifndef SDP_BUILDER_H
+#define SDP_BUILDER_H
+
+#include <gst/gst.h>
+
+#include <string>
+
+struct SdpSession
+{
+    std::string sName;              // s= line
+    std::string sOrigin{"127.0.0.1"};   // o= address of the sender
+    std::string sAddress;           // destination, usually a multicast group
+    int         iPort{0};
+    int         iTtl{16};           // IPv4 multicast scope, ignored for IPv6 and unicast
+};
+
+// Session descriptions for the RTP outputs, so receivers (VLC, ffplay,
+// gst sdpdemux) can join a stream that has no RTSP signalling.
+class SdpBuilder
+{
+public:
+    // rtpCaps are the negotiated caps on the payloader's src pad; their
+    // sprop-* and profile fields end up in a=fmtp. Empty string if the caps
+    // are not application/x-rtp.
+    static std::string build(const SdpSession& session, const GstCaps* rtpCaps);
+
+    static bool isMulticast(const std::string& address);
+};
+
+#endif // SDP_BUILDER_H
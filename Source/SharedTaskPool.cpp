@@ -0,0 +1,283 @@
+#include "SharedTaskPool.h"
+#include "mx_logger.h"
+#include <Poco/Environment.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <thread>
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+///////////////////////////////////////////////    GstTaskPool subclass   //////////////////////////////////////////
+
+struct MxTaskPool
+{
+    GstTaskPool parent;
+};
+
+struct MxTaskPoolClass
+{
+    GstTaskPoolClass parent_class;
+};
+
+G_DEFINE_TYPE(MxTaskPool, mx_task_pool, GST_TYPE_TASK_POOL)
+
+static void mx_task_pool_prepare(GstTaskPool* pool, GError** error)
+{
+    // Threads are owned by SharedTaskPool, nothing to set up per GstTaskPool
+}
+
+static void mx_task_pool_cleanup(GstTaskPool* pool)
+{
+}
+
+static gpointer mx_task_pool_push(GstTaskPool* pool, GstTaskPoolFunction func, gpointer userData, GError** error)
+{
+    return SharedTaskPool::instance().push(func, userData);
+}
+
+static void mx_task_pool_join(GstTaskPool* pool, gpointer id)
+{
+    SharedTaskPool::instance().join(id);
+}
+
+static void mx_task_pool_class_init(MxTaskPoolClass* klass)
+{
+    GstTaskPoolClass* poolClass = GST_TASK_POOL_CLASS(klass);
+    poolClass->prepare = mx_task_pool_prepare;
+    poolClass->cleanup = mx_task_pool_cleanup;
+    poolClass->push    = mx_task_pool_push;
+    poolClass->join    = mx_task_pool_join;
+}
+
+static void mx_task_pool_init(MxTaskPool* pool)
+{
+}
+
+///////////////////////////////////////////////    SharedTaskPool   //////////////////////////////////////////
+
+SharedTaskPool& SharedTaskPool::instance()
+{
+    // Never destroyed: parked workers may still be waiting at process exit
+    static SharedTaskPool* pool = new SharedTaskPool();
+    return *pool;
+}
+
+SharedTaskPool::SharedTaskPool()
+{
+    m_iCores = std::max(1u, static_cast<unsigned>(Poco::Environment::processorCount()));
+
+#ifdef __linux__
+    // The first caller may already be a pinned streaming thread, so read the main thread's mask
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    if (sched_getaffinity(getpid(), sizeof(cpus), &cpus) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &cpus))
+            {
+                m_processCpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+}
+
+void SharedTaskPool::setConfig(const TaskPoolConfig& config)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_config = config;
+    m_cv.notify_all();  // let idle workers re-check the timeout
+}
+
+TaskPoolConfig SharedTaskPool::getConfig() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_config;
+}
+
+GstTaskPool* SharedTaskPool::acquireGstPool()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_config.bEnabled)
+    {
+        return nullptr;
+    }
+    if (!m_gstPool)
+    {
+        m_gstPool = GST_TASK_POOL(g_object_new(mx_task_pool_get_type(), nullptr));
+        gst_object_ref_sink(m_gstPool);
+    }
+    return GST_TASK_POOL(gst_object_ref(m_gstPool));
+}
+
+gpointer SharedTaskPool::push(GstTaskPoolFunction func, gpointer userData)
+{
+    Job* job = new Job();
+    job->func = func;
+    job->userData = userData;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.push_back(job);
+    ++m_iTasksRun;
+
+    // Every queued job needs its own idle worker, tasks never yield their thread
+    if (m_jobs.size() > m_iIdle)
+    {
+        ++m_iThreads;
+        ++m_iIdle;
+        ++m_iThreadsCreated;
+        std::thread(&SharedTaskPool::workerLoop, this).detach();
+    }
+    m_cv.notify_one();
+    return job;
+}
+
+void SharedTaskPool::join(gpointer id)
+{
+    Job* job = static_cast<Job*>(id);
+    {
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->cv.wait(lock, [job] { return job->bDone; });
+    }
+    delete job;
+}
+
+void SharedTaskPool::workerLoop()
+{
+    // Threads inherit the creator's mask, and the creator may be a pinned streaming thread
+    restoreAffinity();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        const unsigned minIdle = m_config.iMinIdleThreads > 0 ? m_config.iMinIdleThreads : m_iCores;
+        const auto timeout = std::chrono::milliseconds(m_config.iIdleTimeoutMs);
+
+        if (!m_cv.wait_for(lock, timeout, [this] { return !m_jobs.empty(); }) && m_iIdle > minIdle)
+        {
+            --m_iIdle;
+            --m_iThreads;
+            return;
+        }
+        if (m_jobs.empty())
+        {
+            continue;
+        }
+
+        Job* job = m_jobs.front();
+        m_jobs.pop_front();
+        --m_iIdle;
+        ++m_iActive;
+        lock.unlock();
+
+        job->func(job->userData);
+
+        // The task may have pinned this thread to its pipeline's cores
+        restoreAffinity();
+        {
+            std::lock_guard<std::mutex> jobLock(job->mutex);
+            job->bDone = true;
+        }
+        job->cv.notify_all();
+
+        lock.lock();
+        --m_iActive;
+        ++m_iIdle;
+    }
+}
+
+void SharedTaskPool::restoreAffinity()
+{
+#ifdef __linux__
+    if (m_processCpus.empty())
+    {
+        return;
+    }
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int cpu : m_processCpus)
+    {
+        CPU_SET(cpu, &cpus);
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#endif
+}
+
+///////////////////////////////////////////////    Reporting   //////////////////////////////////////////
+
+bool SharedTaskPool::readContextSwitches(uint64_t& switches, size_t& threads)
+{
+#ifdef __linux__
+    DIR* dir = opendir("/proc/self/task");
+    if (!dir)
+    {
+        return false;
+    }
+
+    switches = 0;
+    threads = 0;
+    while (dirent* entry = readdir(dir))
+    {
+        if (entry->d_name[0] == '.')
+        {
+            continue;
+        }
+        ++threads;
+
+        std::ifstream status(std::string("/proc/self/task/") + entry->d_name + "/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            unsigned long long value = 0;
+            if (sscanf(line.c_str(), "voluntary_ctxt_switches: %llu", &value) == 1 ||
+                sscanf(line.c_str(), "nonvoluntary_ctxt_switches: %llu", &value) == 1)
+            {
+                switches += value;
+            }
+        }
+    }
+    closedir(dir);
+    return true;
+#else
+    return false;
+#endif
+}
+
+TaskPoolSnapshot SharedTaskPool::getSnapshot()
+{
+    TaskPoolSnapshot snapshot;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        snapshot.iPoolThreads    = m_iThreads;
+        snapshot.iActiveTasks    = m_iActive;
+        snapshot.iIdleThreads    = m_iIdle;
+        snapshot.iTasksRun       = m_iTasksRun;
+        snapshot.iThreadsCreated = m_iThreadsCreated;
+    }
+
+    uint64_t switches = 0;
+    size_t threads = 0;
+    if (readContextSwitches(switches, threads))
+    {
+        std::lock_guard<std::mutex> lock(m_sampleMutex);
+        const auto now = std::chrono::steady_clock::now();
+        snapshot.iProcessThreads = threads;
+
+        // Exited threads take their counts with them, so the sum can go down
+        const double seconds = std::chrono::duration<double>(now - m_lastSample).count();
+        if (m_lastSample.time_since_epoch().count() != 0 && seconds > 0.0 && switches >= m_lastSwitches)
+        {
+            snapshot.fContextSwitchesPerSec = (switches - m_lastSwitches) / seconds;
+        }
+        m_lastSwitches = switches;
+        m_lastSample = now;
+    }
+    return snapshot;
+}
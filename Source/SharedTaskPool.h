@@ -0,0 +1,90 @@
+#ifndef SHARED_TASK_POOL_H
+#define SHARED_TASK_POOL_H
+
+#include <gst/gst.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+struct TaskPoolConfig
+{
+    bool     bEnabled{true};        // install on pipelines built after the call
+    unsigned iMinIdleThreads{0};    // 0 = one per core
+    int      iIdleTimeoutMs{30000}; // idle threads above the minimum exit after this
+};
+
+struct TaskPoolSnapshot
+{
+    size_t   iPoolThreads{0};
+    size_t   iActiveTasks{0};
+    size_t   iIdleThreads{0};
+    uint64_t iTasksRun{0};
+    uint64_t iThreadsCreated{0};    // iTasksRun - iThreadsCreated tasks reused a thread
+    size_t   iProcessThreads{0};
+    double   fContextSwitchesPerSec{0.0};   // whole process, since the previous snapshot
+};
+
+// Process-wide GstTaskPool for pipeline streaming tasks.
+//
+// GstTaskPool::push hands over a task's whole loop, which only returns when the
+// task stops, so one running task always holds one thread. The pool cannot run
+// more tasks than threads. It keeps finished threads parked and reuses them for
+// new tasks, so pipeline start/stop and reconnects do not create and destroy
+// threads. A reused thread gets back the process CPU mask before its next task.
+class SharedTaskPool
+{
+public:
+    static SharedTaskPool& instance();
+
+    void setConfig(const TaskPoolConfig& config);
+    TaskPoolConfig getConfig() const;
+
+    // Ref'd GstTaskPool to hand to gst_task_set_pool, or nullptr when disabled
+    GstTaskPool* acquireGstPool();
+
+    TaskPoolSnapshot getSnapshot();
+
+    // GstTaskPool vfuncs
+    gpointer push(GstTaskPoolFunction func, gpointer userData);
+    void     join(gpointer id);
+
+private:
+    SharedTaskPool();
+
+    struct Job
+    {
+        GstTaskPoolFunction func{nullptr};
+        gpointer            userData{nullptr};
+        std::mutex              mutex;
+        std::condition_variable cv;
+        bool                    bDone{false};
+    };
+
+    void workerLoop();
+    void restoreAffinity();
+    static bool readContextSwitches(uint64_t& switches, size_t& threads);
+
+    mutable std::mutex      m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Job*>        m_jobs;
+    TaskPoolConfig          m_config;
+    unsigned                m_iCores{1};
+    std::vector<int>        m_processCpus;      // unpinned mask, from the main thread
+    size_t                  m_iThreads{0};
+    size_t                  m_iIdle{0};
+    size_t                  m_iActive{0};
+    uint64_t                m_iTasksRun{0};
+    uint64_t                m_iThreadsCreated{0};
+    GstTaskPool*            m_gstPool{nullptr};
+
+    // Context switch rate baseline
+    std::mutex              m_sampleMutex;
+    uint64_t                m_lastSwitches{0};
+    std::chrono::steady_clock::time_point m_lastSample{};
+};
+
+#endif // SHARED_TASK_POOL_H
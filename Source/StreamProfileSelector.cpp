@@ -0,0 +1,101 @@
+#include "StreamProfileSelector.h"
+#include <limits>
+
+// A smaller stream is only taken once the tile fits inside it with this margin
+#define PROFILE_DEMOTE_MARGIN 1.25f
+
+static long long pixelArea(const Resolution& resolution)
+{
+    // Unknown resolution ranks above everything, it is most likely the main stream
+    if (resolution.width <= 0 || resolution.height <= 0)
+    {
+        return std::numeric_limits<long long>::max();
+    }
+    return static_cast<long long>(resolution.width) * resolution.height;
+}
+
+int StreamProfileSelector::mainProfile(const MediaStreamDevice& device)
+{
+    int best = 0;
+    for (size_t i = 1; i < device.vStreamProfiles.size(); ++i)
+    {
+        if (pixelArea(device.vStreamProfiles[i].stResolution) > pixelArea(device.vStreamProfiles[best].stResolution))
+        {
+            best = static_cast<int>(i);
+        }
+    }
+    return best;
+}
+
+bool StreamProfileSelector::covers(const Resolution& stream, const Resolution& tile, float margin)
+{
+    if (stream.width <= 0 || stream.height <= 0)
+    {
+        return true;
+    }
+    return stream.width >= tile.width * margin && stream.height >= tile.height * margin;
+}
+
+int StreamProfileSelector::select(const MediaStreamDevice& device, int current)
+{
+    const std::vector<StreamProfile>& profiles = device.vStreamProfiles;
+    if (profiles.empty())
+    {
+        return -1;
+    }
+
+    const int main = mainProfile(device);
+    const Resolution& tile = device.stTileSize;
+    if (device.stoutputMediaData.esourceType != eSourceType::SOURCE_TYPE_DISPLAY || tile.width <= 0 || tile.height <= 0)
+    {
+        return main;
+    }
+
+    // Smallest stream that covers the tile outright
+    int desired = main;
+    for (size_t i = 0; i < profiles.size(); ++i)
+    {
+        if (covers(profiles[i].stResolution, tile, 1.0f) &&
+            pixelArea(profiles[i].stResolution) < pixelArea(profiles[desired].stResolution))
+        {
+            desired = static_cast<int>(i);
+        }
+    }
+
+    if (current < 0 || current >= static_cast<int>(profiles.size()) || current == desired)
+    {
+        return desired;
+    }
+
+    // Promote as soon as the current stream is too small; demote only with margin to spare
+    const bool bDemote = pixelArea(profiles[desired].stResolution) < pixelArea(profiles[current].stResolution);
+    if (bDemote && !covers(profiles[desired].stResolution, tile, PROFILE_DEMOTE_MARGIN))
+    {
+        return current;
+    }
+    return desired;
+}
+
+MediaStreamDevice StreamProfileSelector::resolve(const MediaStreamDevice& device, int index)
+{
+    MediaStreamDevice resolved = device;
+    if (index < 0 || index >= static_cast<int>(device.vStreamProfiles.size()))
+    {
+        return resolved;
+    }
+
+    const StreamProfile& profile = device.vStreamProfiles[index];
+    if (!profile.sUrl.empty())
+    {
+        resolved.sDeviceName = profile.sUrl;
+    }
+    if (profile.stResolution.width > 0 && profile.stResolution.height > 0)
+    {
+        resolved.stinputMediaData.stResolution = profile.stResolution;
+    }
+    if (!profile.stMediaCodec.codecname.empty())
+    {
+        resolved.stinputMediaData.stMediaCodec = profile.stMediaCodec;
+    }
+    return resolved;
+}
@@ -0,0 +1,24 @@
+#ifndef STREAM_PROFILE_SELECTOR_H
+#define STREAM_PROFILE_SELECTOR_H
+
+#include "Struct.h"
+
+// Picks which of a device's stream profiles a pipeline should pull.
+// Recording and re-streaming take the main (largest) stream. Display takes the
+// smallest stream that covers the tile, with hysteresis so a tile resized around
+// a substream's resolution does not flap between streams.
+class StreamProfileSelector
+{
+public:
+    // -1 = no profiles, use sDeviceName; current is the profile in use (or -1)
+    static int select(const MediaStreamDevice& device, int current = -1);
+
+    // Device with sDeviceName, input codec and resolution taken from the profile
+    static MediaStreamDevice resolve(const MediaStreamDevice& device, int index);
+
+private:
+    static int mainProfile(const MediaStreamDevice& device);
+    static bool covers(const Resolution& stream, const Resolution& tile, float margin);
+};
+
+#endif // STREAM_PROFILE_SELECTOR_H
@@ -2,6 +2,8 @@
 
 #include "Enum.h"
 #include <iostream>
+#include <cstdint>
+#include <functional>
 #include <vector>
 #include <string>
 
@@ -34,10 +36,93 @@ enum class PipelineOperation
 };
 
 
+struct BackpressureConfig
+{
+	eBackpressurePolicy ePolicy{eBackpressurePolicy::BACKPRESSURE_REJECT};
+	size_t iCapacity{500};
+	int iBlockTimeoutMs{1000};
+	float fHighWaterRatio{0.8f};	// Information callback when occupancy crosses this ratio
+};
+
+// Snapshot of submission (PipelineProcess) and work (PipelineManager) queue occupancy
+struct QueueOccupancy
+{
+	size_t iSubmitDepth{0};
+	size_t iSubmitCapacity{0};
+	size_t iSubmitHighWater{0};
+	size_t iWorkDepth{0};
+	size_t iWorkCapacity{0};
+	size_t iWorkHighWater{0};
+	size_t iRejected{0};
+	size_t iShed{0};
+	size_t iBlockTimeouts{0};
+};
+
+// One optional queue between two pipeline stages. 0 disables a size limit.
+struct QueueStageConfig
+{
+	bool		bEnabled{false};
+	bool		bQueue2{false};				// queue2 instead of queue; queue2 has no leaky mode
+	unsigned	iMaxBuffers{0};
+	unsigned	iMaxBytes{0};
+	uint64_t	iMaxTimeMs{0};
+	eQueueLeaky	eLeaky{eQueueLeaky::QUEUE_LEAKY_NONE};
+};
+
+// Queue layout for one output type, indexed by eQueueStage
+struct QueueProfile
+{
+	QueueStageConfig stages[static_cast<size_t>(eQueueStage::QUEUE_STAGE_COUNT)];
+
+	QueueStageConfig& stage(eQueueStage s) { return stages[static_cast<size_t>(s)]; }
+	const QueueStageConfig& stage(eQueueStage s) const { return stages[static_cast<size_t>(s)]; }
+};
+
+// Build-time decisions taken by PipelineManager rather than carried in the device configuration
+struct PipelineBuildOptions
+{
+	bool bReducedDecode{false};		// decoder skips non-reference frames (admission downgrade)
+	int  iDecodeThreads{0};			// decoder max-threads from the global budget, 0 = decoder default
+	int  iNumaNode{-1};				// placement node, -1 = not pinned
+	std::vector<int> vCpuSet;		// cores for every streaming thread, empty = not pinned
+	QueueProfile stQueues;			// inter-stage queues for the output type
+};
+
 struct Resolution {
 	int width{0};
 	int height{0};
 	float frameRate{0.0f};
+
+	bool operator==(const Resolution& other) const
+	{
+		return (width == other.width && height == other.height && frameRate == other.frameRate);
+	}
+
+	bool operator!=(const Resolution& other) const
+	{
+		return(!(*this == other));
+	}
+};
+
+// One step of a rendition ladder: the stream is decoded once and re-encoded per rendition
+struct Rendition
+{
+	std::string sName;			// endpoint suffix, e.g. "720p"
+	int iWidth{0};				// 0 = source size
+	int iHeight{0};
+	float fFrameRate{0.0f};		// 0 = source rate; only lower rates apply
+	int iBitrate{0};			// kbit/s, 0 = output MediaCodec bitrate
+
+	bool operator==(const Rendition& other) const
+	{
+		return (sName == other.sName && iWidth == other.iWidth && iHeight == other.iHeight &&
+			fFrameRate == other.fFrameRate && iBitrate == other.iBitrate);
+	}
+
+	bool operator!=(const Rendition& other) const
+	{
+		return(!(*this == other));
+	}
 };
 
 struct NetworkConfig {
@@ -56,9 +141,9 @@ struct MediaCodec
 	
 	// New members
 	CodecType type;
-	int bitrate ;
-	std::string profile;
-	std::string preset;
+	int bitrate ;				// kbit/s
+	std::string profile;		// encoder profile for transcoded outputs ("baseline", "main", "high")
+	std::string preset;			// encoder speed preset ("ultrafast" ... "medium")
 	std::string codecname;
 
 	MediaCodec() : evideocodec(eVideoCodec::VIDEO_CODEC_NONE), eaudiocodec(eAudioCodec::AUDIO_CODEC_NONE), eaudioSampleRate(eAudioSampleRate::AUDIO_SAMPLE_RATE_NONE), type(CodecType::H264), bitrate(0), codecname("") {}
@@ -110,6 +195,17 @@ struct NetworkStreaming
 	eStreamingProtocol estreamingProtocol;
 	std::string sIpAddress;
 	int iPort;
+	bool bServe{false};			// serve from the embedded RTSP server instead of pushing to sourceOuputURL
+	std::string sMountPath;		// server mount, "" = /camera/<pipeline id>
+	// STREAMING_PROTOCOL_RTP output: sIpAddress is the (multicast) group, iPort the RTP port
+	int iTtl{16};				// multicast TTL, scopes how far the group is routed
+	int iMtu{1400};				// RTP packet size, keep under the path MTU
+	std::string sMulticastIface;	// sending interface, "" = routing table
+	std::string sSdpPath;		// where the session description is written, "" = not written
+	// STREAMING_PROTOCOL_HTTP output: fMP4 HLS served from memory under /hls/<pipeline id>/
+	int iHlsSegmentMs{2000};	// segments are cut at the first keyframe past this
+	int iHlsPlaylistSegments{6};	// live window in the playlist
+	size_t iHlsStoreMaxBytes{32 * 1024 * 1024};	// segment memory cap per pipeline
 
 	NetworkStreaming()
 		: estreamingProtocol(eStreamingProtocol::STREAMING_PROTOCOL_NONE), sIpAddress(""), iPort(0) {}
@@ -118,7 +214,10 @@ struct NetworkStreaming
 		: estreamingProtocol(protocol), sIpAddress(ipAddress), iPort(port) {}
 
 	NetworkStreaming(const NetworkStreaming& other)
-		: estreamingProtocol(other.estreamingProtocol), sIpAddress(other.sIpAddress), iPort(other.iPort) {}
+		: estreamingProtocol(other.estreamingProtocol), sIpAddress(other.sIpAddress), iPort(other.iPort),
+		bServe(other.bServe), sMountPath(other.sMountPath), iTtl(other.iTtl), iMtu(other.iMtu),
+		sMulticastIface(other.sMulticastIface), sSdpPath(other.sSdpPath), iHlsSegmentMs(other.iHlsSegmentMs),
+		iHlsPlaylistSegments(other.iHlsPlaylistSegments), iHlsStoreMaxBytes(other.iHlsStoreMaxBytes) {}
 
 	NetworkStreaming& operator=(const NetworkStreaming& other)
 	{
@@ -126,6 +225,15 @@ struct NetworkStreaming
 			estreamingProtocol = other.estreamingProtocol;
 			sIpAddress = other.sIpAddress;
 			iPort = other.iPort;
+			bServe = other.bServe;
+			sMountPath = other.sMountPath;
+			iTtl = other.iTtl;
+			iMtu = other.iMtu;
+			sMulticastIface = other.sMulticastIface;
+			sSdpPath = other.sSdpPath;
+			iHlsSegmentMs = other.iHlsSegmentMs;
+			iHlsPlaylistSegments = other.iHlsPlaylistSegments;
+			iHlsStoreMaxBytes = other.iHlsStoreMaxBytes;
 		}
 		return *this;
 	}
@@ -134,7 +242,16 @@ struct NetworkStreaming
 	{
 		return (estreamingProtocol == other.estreamingProtocol &&
 			sIpAddress == other.sIpAddress &&
-			iPort == other.iPort);
+			iPort == other.iPort &&
+			bServe == other.bServe &&
+			sMountPath == other.sMountPath &&
+			iTtl == other.iTtl &&
+			iMtu == other.iMtu &&
+			sMulticastIface == other.sMulticastIface &&
+			sSdpPath == other.sSdpPath &&
+			iHlsSegmentMs == other.iHlsSegmentMs &&
+			iHlsPlaylistSegments == other.iHlsPlaylistSegments &&
+			iHlsStoreMaxBytes == other.iHlsStoreMaxBytes);
 	}
 
 	bool operator!=(const NetworkStreaming& other) const
@@ -146,6 +263,11 @@ struct NetworkStreaming
 struct MediaFileSource
 {
 	eContainerFormat econtainerFormat;
+	bool bSegmented{false};			// rolling recording through splitmuxsink
+	std::string sPathTemplate;		// {id} pipeline, {index} segment number, {time} local start time
+	int iSegmentSeconds{300};		// split at the first keyframe after this, 0 = no time limit
+	uint64_t iSegmentMaxBytes{0};	// split at the first keyframe after this size, 0 = no size limit
+	unsigned iMaxFiles{0};			// keep only the newest N segments, 0 = keep all
 
 	MediaFileSource()
 		: econtainerFormat(eContainerFormat::CONTAINER_FORMAT_NONE){}
@@ -154,18 +276,30 @@ struct MediaFileSource
 		: econtainerFormat(format){}
 
 	MediaFileSource(const MediaFileSource& other)
-		: econtainerFormat(other.econtainerFormat){}
+		: econtainerFormat(other.econtainerFormat), bSegmented(other.bSegmented),
+		sPathTemplate(other.sPathTemplate), iSegmentSeconds(other.iSegmentSeconds),
+		iSegmentMaxBytes(other.iSegmentMaxBytes), iMaxFiles(other.iMaxFiles){}
 
 	MediaFileSource& operator=(const MediaFileSource& other) {
 		if (this != &other) { 
 			econtainerFormat = other.econtainerFormat;
+			bSegmented = other.bSegmented;
+			sPathTemplate = other.sPathTemplate;
+			iSegmentSeconds = other.iSegmentSeconds;
+			iSegmentMaxBytes = other.iSegmentMaxBytes;
+			iMaxFiles = other.iMaxFiles;
 		}
 		return *this;
 	}
 
 	bool operator==(const MediaFileSource& other) const
 	{
-		return (econtainerFormat == other.econtainerFormat);
+		return (econtainerFormat == other.econtainerFormat &&
+			bSegmented == other.bSegmented &&
+			sPathTemplate == other.sPathTemplate &&
+			iSegmentSeconds == other.iSegmentSeconds &&
+			iSegmentMaxBytes == other.iSegmentMaxBytes &&
+			iMaxFiles == other.iMaxFiles);
 	}
 
 	bool operator!=(const MediaFileSource& other) const
@@ -181,6 +315,8 @@ struct MediaData
 	MediaFileSource stFileSource;
 	NetworkStreaming stNetworkStreaming;
 	eStreamingType estreamingType;
+	Resolution stResolution;	// optional hint, 0 when unknown
+	std::vector<Rendition> vRenditions;	// output only: ladder served from one decode, empty = single output
 
 	MediaData()
 		: esourceType(eSourceType::SOURCE_TYPE_NONE),estreamingType(eStreamingType::STREAMING_TYPE_NONE){}
@@ -193,7 +329,7 @@ struct MediaData
 	MediaData(const MediaData& other)
 		: esourceType(other.esourceType), stMediaCodec(other.stMediaCodec),
 		stFileSource(other.stFileSource), stNetworkStreaming(other.stNetworkStreaming),
-		estreamingType(other.estreamingType){}
+		estreamingType(other.estreamingType), stResolution(other.stResolution), vRenditions(other.vRenditions){}
 
 	MediaData& operator=(const MediaData& other) {
 		if (this != &other) {
@@ -202,6 +338,8 @@ struct MediaData
 			stFileSource = other.stFileSource;
 			stNetworkStreaming = other.stNetworkStreaming;
 			estreamingType = other.estreamingType;
+			stResolution = other.stResolution;
+			vRenditions = other.vRenditions;
 		}
 		return *this;
 	}
@@ -212,7 +350,9 @@ struct MediaData
 			stMediaCodec == other.stMediaCodec &&
 			stFileSource == other.stFileSource &&
 			stNetworkStreaming == other.stNetworkStreaming &&
-			estreamingType == other.estreamingType);
+			estreamingType == other.estreamingType &&
+			stResolution == other.stResolution &&
+			vRenditions == other.vRenditions);
 	}
 	// Overload != operator (Inequality Check)
 	bool operator!=(const MediaData& other) const
@@ -221,12 +361,53 @@ struct MediaData
 	}
 };
 
+// A recording segment that has been closed and finalized, playable as is
+struct SegmentInfo
+{
+	std::string sLocation;
+	unsigned iIndex{0};			// segments closed by this pipeline so far, from 1
+	uint64_t iStartNs{0};		// running time of the segment's first frame
+	uint64_t iDurationNs{0};
+	uint64_t iBytes{0};
+};
+
+using SegmentCallback = std::function<void(size_t pipelineId, const SegmentInfo& segment)>;
+
+// One stream a camera offers, e.g. a 4K main stream and a D1/720p substream
+struct StreamProfile
+{
+	std::string sName;			// "main", "sub", ...
+	std::string sUrl;
+	Resolution stResolution;	// 0 when unknown, treated as the largest
+	MediaCodec stMediaCodec;	// empty codecname = same as the device input
+
+	bool operator==(const StreamProfile& other) const
+	{
+		return (sName == other.sName &&
+			sUrl == other.sUrl &&
+			stResolution == other.stResolution &&
+			stMediaCodec == other.stMediaCodec);
+	}
+
+	bool operator!=(const StreamProfile& other) const
+	{
+		return(!(*this == other));
+	}
+};
+
 struct MediaStreamDevice
 {
 	std::string sDeviceName;
 	MediaData stinputMediaData;
 	MediaData stoutputMediaData;
 	std::string sourceOuputURL;
+	eLatencyProfile elatencyProfile{eLatencyProfile::LATENCY_PROFILE_STANDARD};
+	int iLatencyMs{0};			// rtspsrc jitterbuffer latency, 0 = profile default
+	bool bKeyframeOnly{false};	// display decodes only keyframes; switchable at runtime
+	std::vector<StreamProfile> vStreamProfiles;	// alternatives to sDeviceName, chosen per output
+	Resolution stTileSize;		// display tile size in pixels, 0 = full resolution wanted
+	std::string sMosaic;		// display wall to render into instead of an own window, empty = none
+	int iMosaicTile{-1};		// tile of sMosaic
 
 public:
 	// Getters and setters
@@ -259,7 +440,14 @@ public:
 		: sDeviceName(other.sDeviceName)
 		, stinputMediaData(other.stinputMediaData)
 		, stoutputMediaData(other.stoutputMediaData)
-	    , sourceOuputURL(other.sourceOuputURL) {}
+	    , sourceOuputURL(other.sourceOuputURL)
+		, elatencyProfile(other.elatencyProfile)
+		, iLatencyMs(other.iLatencyMs)
+		, bKeyframeOnly(other.bKeyframeOnly)
+		, vStreamProfiles(other.vStreamProfiles)
+		, stTileSize(other.stTileSize)
+		, sMosaic(other.sMosaic)
+		, iMosaicTile(other.iMosaicTile) {}
 
 	// Assignment operator
 	MediaStreamDevice& operator=(const MediaStreamDevice& other) {
@@ -268,6 +456,13 @@ public:
 			stinputMediaData = other.stinputMediaData;
 			stoutputMediaData = other.stoutputMediaData;
 			sourceOuputURL = other.sourceOuputURL;
+			elatencyProfile = other.elatencyProfile;
+			iLatencyMs = other.iLatencyMs;
+			bKeyframeOnly = other.bKeyframeOnly;
+			vStreamProfiles = other.vStreamProfiles;
+			stTileSize = other.stTileSize;
+			sMosaic = other.sMosaic;
+			iMosaicTile = other.iMosaicTile;
 		}
 		return *this;
 	}
@@ -277,7 +472,14 @@ public:
 		return (sDeviceName == other.sDeviceName &&
 			stinputMediaData == other.stinputMediaData &&
 			stoutputMediaData == other.stoutputMediaData && 
-			sourceOuputURL == other.sourceOuputURL);
+			sourceOuputURL == other.sourceOuputURL &&
+			elatencyProfile == other.elatencyProfile &&
+			iLatencyMs == other.iLatencyMs &&
+			bKeyframeOnly == other.bKeyframeOnly &&
+			vStreamProfiles == other.vStreamProfiles &&
+			stTileSize == other.stTileSize &&
+			sMosaic == other.sMosaic &&
+			iMosaicTile == other.iMosaicTile);
 	}
 
 	bool operator!=(const MediaStreamDevice& other) const 
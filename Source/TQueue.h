@@ -7,6 +7,9 @@
 #include <type_traits> 
 #include <shared_mutex>  
 #include <mutex>    
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
 
 #define DEFAULTQUEUESIZE 500
 
@@ -15,8 +18,10 @@ template <typename T, size_t iMaxSize = DEFAULTQUEUESIZE>
 class TQueue {
 private:
     size_t m_iMaxSize = iMaxSize;
+    size_t m_iHighWaterMark = 0;
     std::queue<T> queue;        
     mutable std::shared_mutex mtx;     
+    std::condition_variable_any m_cvNotFull;
 
     // Helper function to clean up memory if T is a pointer type
     void cleanup() {
@@ -140,9 +145,49 @@ public:
 
         // Push the item to the queue
         queue.emplace(item);
+        m_iHighWaterMark = std::max(m_iHighWaterMark, queue.size());
         
     }
 
+    // Enqueue without throwing on a full queue. Returns false if the item was not added.
+    bool tryEnqueue(const T& item) {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+
+        if (queue.size() >= m_iMaxSize) {
+            return false;
+        }
+
+        if constexpr (std::is_pointer_v<T>) {
+            if (item == nullptr) {
+                return false;
+            }
+        }
+
+        queue.emplace(item);
+        m_iHighWaterMark = std::max(m_iHighWaterMark, queue.size());
+        return true;
+    }
+
+    // Enqueue, waiting up to timeout for a consumer to make room. Returns false on timeout.
+    template <typename Rep, typename Period>
+    bool enqueueFor(const T& item, const std::chrono::duration<Rep, Period>& timeout) {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+
+        if (!m_cvNotFull.wait_for(lock, timeout, [this] { return queue.size() < m_iMaxSize; })) {
+            return false;
+        }
+
+        if constexpr (std::is_pointer_v<T>) {
+            if (item == nullptr) {
+                return false;
+            }
+        }
+
+        queue.emplace(item);
+        m_iHighWaterMark = std::max(m_iHighWaterMark, queue.size());
+        return true;
+    }
+
     // Dequeue an element
     T dequeue() {
         std::unique_lock <std::shared_mutex> lock(mtx); 
@@ -155,6 +200,9 @@ public:
         
         queue.pop(); 
 
+        lock.unlock();
+        m_cvNotFull.notify_one();
+
         return item;
     }
 
@@ -168,6 +216,8 @@ public:
     void clear() {
         std::unique_lock <std::shared_mutex> lock(mtx); 
         cleanup();
+        lock.unlock();
+        m_cvNotFull.notify_all();
     }
 
     // Get the size of the queue
@@ -176,6 +226,22 @@ public:
         return queue.size();
     }
 
+    // Maximum number of elements the queue accepts
+    size_t capacity() const {
+        return m_iMaxSize;
+    }
+
+    // Largest size observed since construction or the last resetHighWaterMark()
+    size_t highWaterMark() const {
+        std::shared_lock <std::shared_mutex> lock(mtx); 
+        return m_iHighWaterMark;
+    }
+
+    void resetHighWaterMark() {
+        std::unique_lock <std::shared_mutex> lock(mtx); 
+        m_iHighWaterMark = queue.size();
+    }
+
     // Peek at the front element of the queue
     T front() const {
         std::shared_lock <std::shared_mutex> lock(mtx); 
@@ -195,6 +261,8 @@ public:
             throw std::runtime_error("Queue is empty");
         }
         queue.pop(); // Remove the front item
+        lock.unlock();
+        m_cvNotFull.notify_one();
     }
 
     // Peek at the back element of the queue
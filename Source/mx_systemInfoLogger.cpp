@@ -1,4 +1,5 @@
 #include "mx_systemInfoLogger.h"
+#include "HostStats.h"
 #include <Poco/Environment.h>
 #include <Poco/File.h>
 #include <Poco/DateTime.h>
@@ -301,32 +302,17 @@ std::string SystemInfoLogger::getSystemInfo()
                 info << "(Available: " << std::fixed << std::setprecision(2) << availableRAM << " GB)" << std::endl;
             }
         #else
-            // For Linux, parse /proc/meminfo
-            std::ifstream meminfo("/proc/meminfo");
-            if (meminfo.is_open()) {
-                std::string line;
-                unsigned long totalRAM = 0, availableRAM = 0;
-                
-                while (std::getline(meminfo, line)) {
-                    if (line.find("MemTotal:") == 0) {
-                        sscanf(line.c_str(), "MemTotal: %lu", &totalRAM);
-                    } else if (line.find("MemAvailable:") == 0) {
-                        sscanf(line.c_str(), "MemAvailable: %lu", &availableRAM);
-                    }
-                }
+            // For Linux, /proc/meminfo (the same reader admission control uses)
+            unsigned long totalRAM = 0, availableRAM = 0;
+            if (HostStats::readMemInfo(totalRAM, availableRAM)) {
+                double totalRAM_GB = totalRAM / (1024.0 * 1024.0);
+                double availableRAM_GB = availableRAM / (1024.0 * 1024.0);
                 
-                meminfo.close();
-                
-                if (totalRAM > 0) {
-                    double totalRAM_GB = totalRAM / (1024.0 * 1024.0);
-                    double availableRAM_GB = availableRAM / (1024.0 * 1024.0);
-                    
-                    info << "RAM             : " << std::fixed << std::setprecision(2) << totalRAM_GB << " GB ";
-                    if (availableRAM > 0) {
-                        info << "(Available: " << std::fixed << std::setprecision(2) << availableRAM_GB << " GB)";
-                    }
-                    info << std::endl;
+                info << "RAM             : " << std::fixed << std::setprecision(2) << totalRAM_GB << " GB ";
+                if (availableRAM > 0) {
+                    info << "(Available: " << std::fixed << std::setprecision(2) << availableRAM_GB << " GB)";
                 }
+                info << std::endl;
             }
         #endif
         